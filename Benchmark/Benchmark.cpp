@@ -0,0 +1,1481 @@
+// Console benchmarks for the TrackerCore modules
+// Each benchmark runs on synthetic data so no Kinect is needed
+//
+//   Benchmark [iterations] [--tracker] [--json out.json] [--baseline base.json] [--tolerance percent]
+//             [--session recording.lses]
+//
+// --tracker runs only the tracking core suite. --json saves the headline
+// numbers, --baseline compares them against a saved run and exits with 1
+// when any got worse by more than the tolerance (10% unless given).
+// --session adds a recorded session to the sequences the tracking suite
+// runs motion gating on and to the frames the depth codec is measured on.
+//
+// Nothing here is Windows specific, on Linux it builds with
+//   g++ -std=c++11 -O2 -pthread -ITrackerCore TrackerCore/*.cpp Benchmark/*.cpp -lrt
+// leaving out TrackerCore/dllmain.cpp and TrackerCore/stdafx.cpp.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <atomic>
+
+#include "Timing.h"
+#include "Registration.h"
+#include "Localization.h"
+#include "OccupancyGrid.h"
+#include "WorkerPool.h"
+#include "GroundPlane.h"
+#include "DepthFilter.h"
+#include "DepthCodec.h"
+#include "SessionFile.h"
+#include "AsyncRecorder.h"
+#include "TrackerCore.h"
+#include "SyntheticScene.h"
+#include "Results.h"
+#include "PerfCounters.h"
+#include "LatencyProfiler.h"
+#include "MultiPipeline.h"
+#include "TargetFilter.h"
+#include "TrackerCoreC.h"
+#include "DisplayMailbox.h"
+
+#ifndef _WIN32
+#define sprintf_s snprintf
+#endif
+
+#define FRAME_WIDTH 640
+#define FRAME_HEIGHT 480
+
+// The arena floor seen from the default sensor mount with a rock sitting on
+// it, a back wall and a sprinkling of holes. Values are raw NUI depth units
+// (millimeters shifted up past the player index).
+static void fillSyntheticDepth(uint16_t* depth)
+{
+	CameraIntrinsics camera, colorIntrinsics;
+	CameraExtrinsics extrinsics;
+	getKinectDefaultCalibration(&camera, &colorIntrinsics, &extrinsics);
+	OccupancyGridConfig config;
+	getDefaultOccupancyGridConfig(&config);
+
+	float c = cosf(config.sensorPitch);
+	float s = sinf(config.sensorPitch);
+	for( int y = 0; y < FRAME_HEIGHT; y++ )
+	{
+		float ry = (y - camera.cy) / camera.fy;
+		float down = s + ry * c;
+		for( int x = 0; x < FRAME_WIDTH; x++ )
+		{
+			int mm = 4000;
+			if( down > 0.0f && config.sensorHeight / down < 4.0f )
+				mm = (int)(config.sensorHeight / down * 1000.0f);
+			if( x > 250 && x < 390 && y > 300 && y < 360 )
+				mm = 1300;
+			if( (x * 7 + y * 13) % 97 == 0 )
+				mm = 0;
+			depth[y * FRAME_WIDTH + x] = (uint16_t)(mm << DEPTH_PLAYER_INDEX_SHIFT);
+		}
+	}
+}
+
+static void benchmarkRegistration(int iterations)
+{
+	CameraIntrinsics depthIntrinsics, colorIntrinsics;
+	CameraExtrinsics extrinsics;
+	getKinectDefaultCalibration(&depthIntrinsics, &colorIntrinsics, &extrinsics);
+
+	uint16_t* depth = new uint16_t[FRAME_WIDTH * FRAME_HEIGHT];
+	uint16_t* registered = new uint16_t[FRAME_WIDTH * FRAME_HEIGHT];
+	int* coordinates = new int[FRAME_WIDTH * FRAME_HEIGHT * 2];
+	fillSyntheticDepth(depth);
+
+	DepthRegistration registration;
+	double start = getTimeSeconds();
+	registration.initialize(depthIntrinsics, colorIntrinsics, extrinsics);
+	double tableTime = getTimeSeconds() - start;
+
+	start = getTimeSeconds();
+	for( int i = 0; i < iterations; i++ )
+		registration.mapDepthToColor(depth, coordinates);
+	double mapTime = (getTimeSeconds() - start) / iterations;
+
+	start = getTimeSeconds();
+	for( int i = 0; i < iterations; i++ )
+		registration.registerDepthToColor(depth, registered);
+	double registerTime = (getTimeSeconds() - start) / iterations;
+
+	registration.setUseSimd(false);
+	start = getTimeSeconds();
+	for( int i = 0; i < iterations; i++ )
+		registration.mapDepthToColor(depth, coordinates);
+	double scalarMapTime = (getTimeSeconds() - start) / iterations;
+
+	start = getTimeSeconds();
+	for( int i = 0; i < iterations; i++ )
+		registration.registerDepthToColor(depth, registered);
+	double scalarRegisterTime = (getTimeSeconds() - start) / iterations;
+	registration.setUseSimd(true);
+
+	start = getTimeSeconds();
+	for( int i = 0; i < iterations; i++ )
+		registration.mapDepthToColorReference(depth, coordinates);
+	double referenceTime = (getTimeSeconds() - start) / iterations;
+
+	printf("registration\n");
+	printf("  table build          %8.3f ms\n", tableTime * 1e3);
+	printf("  depth to color       %8.3f ms/frame (scalar %.3f)\n", mapTime * 1e3, scalarMapTime * 1e3);
+	printf("  depth into color     %8.3f ms/frame (scalar %.3f)\n", registerTime * 1e3, scalarRegisterTime * 1e3);
+	printf("  reference mapping    %8.3f ms/frame\n", referenceTime * 1e3);
+
+	delete[] depth;
+	delete[] registered;
+	delete[] coordinates;
+}
+
+typedef struct
+{
+	Point3D center;
+	float radius;
+} Beacon;
+
+// Renders beacons as discs facing the camera in front of a flat wall, in the color camera
+static void renderBeaconDepth(const CameraIntrinsics& camera, const Beacon* beacons, int count, uint16_t* depth)
+{
+	for( int v = 0; v < camera.height; v++ )
+	{
+		for( int u = 0; u < camera.width; u++ )
+		{
+			float rx = (u - camera.cx) / camera.fx;
+			float ry = (v - camera.cy) / camera.fy;
+			float z = 3.0f;
+			for( int i = 0; i < count; i++ )
+			{
+				float dx = rx * beacons[i].center.z - beacons[i].center.x;
+				float dy = ry * beacons[i].center.z - beacons[i].center.y;
+				if( dx * dx + dy * dy < beacons[i].radius * beacons[i].radius && beacons[i].center.z < z )
+					z = beacons[i].center.z;
+			}
+			int mm = (int)(z * 1000.0f + 0.5f);
+			if( (u * 7 + v * 13) % 11 == 0 )
+				mm = 0;
+			depth[v * camera.width + u] = (uint16_t)(mm << DEPTH_PLAYER_INDEX_SHIFT);
+		}
+	}
+}
+
+static Coordinate projectPoint(const CameraIntrinsics& camera, const Point3D& point)
+{
+	Coordinate pixel;
+	pixel.x = (int)(camera.fx * point.x / point.z + camera.cx + 0.5f);
+	pixel.y = (int)(camera.fy * point.y / point.z + camera.cy + 0.5f);
+	return pixel;
+}
+
+static void benchmarkLocalization(int iterations)
+{
+	CameraIntrinsics depthIntrinsics, colorIntrinsics;
+	CameraExtrinsics extrinsics;
+	getKinectDefaultCalibration(&depthIntrinsics, &colorIntrinsics, &extrinsics);
+
+	uint16_t* depth = new uint16_t[FRAME_WIDTH * FRAME_HEIGHT];
+	TargetLocalizer localizer;
+	localizer.initialize(colorIntrinsics);
+
+	// Pairs of beacons across the working range
+	static const Beacon scenes[][2] = {
+		{ { { -0.40f, 0.10f, 1.20f }, 0.06f }, { { 0.30f, 0.10f, 1.50f }, 0.06f } },
+		{ { { -0.50f, 0.20f, 2.00f }, 0.08f }, { { 0.50f, 0.20f, 2.40f }, 0.08f } },
+		{ { { 0.20f, -0.10f, 2.80f }, 0.10f }, { { 0.90f, -0.10f, 2.60f }, 0.10f } },
+	};
+	int sceneCount = sizeof(scenes) / sizeof(scenes[0]);
+
+	double elapsed = 0.0;
+	for( int s = 0; s < sceneCount; s++ )
+	{
+		const Beacon* beacons = scenes[s];
+		renderBeaconDepth(colorIntrinsics, beacons, 2, depth);
+		Coordinate first = projectPoint(colorIntrinsics, beacons[0].center);
+		Coordinate second = projectPoint(colorIntrinsics, beacons[1].center);
+
+		BeaconPair pair;
+		double start = getTimeSeconds();
+		for( int i = 0; i < iterations; i++ )
+			localizer.localizePair(depth, first, second, &pair);
+		elapsed += getTimeSeconds() - start;
+	}
+
+	printf("localization\n");
+	printf("  beacon pair          %8.3f us/call\n", elapsed / (iterations * sceneCount) * 1e6);
+
+	delete[] depth;
+}
+
+static double timeOccupancyGrid(const uint16_t* depth, WorkerPool* pool, int iterations, int* obstacles)
+{
+	CameraIntrinsics depthIntrinsics, colorIntrinsics;
+	CameraExtrinsics extrinsics;
+	getKinectDefaultCalibration(&depthIntrinsics, &colorIntrinsics, &extrinsics);
+	OccupancyGridConfig config;
+	getDefaultOccupancyGridConfig(&config);
+	config.pixelStride = 1;
+
+	OccupancyGrid grid;
+	grid.initialize(depthIntrinsics, config, pool);
+
+	double start = getTimeSeconds();
+	for( int i = 0; i < iterations; i++ )
+		grid.build(depth);
+	*obstacles = grid.obstacleCells();
+	return (getTimeSeconds() - start) / iterations;
+}
+
+static void benchmarkOccupancyGrid(int iterations)
+{
+	uint16_t* depth = new uint16_t[FRAME_WIDTH * FRAME_HEIGHT];
+	fillSyntheticDepth(depth);
+
+	int obstacles = 0;
+	double serial = timeOccupancyGrid(depth, NULL, iterations, &obstacles);
+	printf("occupancy grid (every pixel, 30 Hz budget 33.3 ms)\n");
+	printf("  1 thread             %8.3f ms/frame  %d obstacle cells\n", serial * 1e3, obstacles);
+
+	WorkerPool pool;
+	double parallel = timeOccupancyGrid(depth, &pool, iterations, &obstacles);
+	printf("  %2d threads           %8.3f ms/frame  %d obstacle cells\n", pool.size(), parallel * 1e3, obstacles);
+
+	delete[] depth;
+}
+
+static void runGroundPlane(const uint16_t* depth, WorkerPool* pool, int iterations, const char* label)
+{
+	CameraIntrinsics depthIntrinsics, colorIntrinsics;
+	CameraExtrinsics extrinsics;
+	getKinectDefaultCalibration(&depthIntrinsics, &colorIntrinsics, &extrinsics);
+	GroundPlaneConfig config;
+	getDefaultGroundPlaneConfig(&config);
+
+	GroundPlaneEstimator estimator;
+	estimator.initialize(depthIntrinsics, config, pool);
+
+	// The first frame is always cold, the rest warm start from the previous plane
+	estimator.estimate(depth);
+	GroundPlaneStats cold = estimator.stats();
+
+	double totalMilliseconds = 0.0;
+	int totalIterations = 0;
+	for( int i = 0; i < iterations; i++ )
+	{
+		estimator.estimate(depth);
+		totalMilliseconds += estimator.stats().milliseconds;
+		totalIterations += estimator.stats().iterations;
+	}
+
+	const GroundPlane& plane = estimator.plane();
+	printf("  %-20s cold %3d it %7.3f ms, warm %5.1f it %7.3f ms/frame\n", label,
+		   cold.iterations, cold.milliseconds, (double)totalIterations / iterations, totalMilliseconds / iterations);
+	printf("  %-20s plane (%.3f %.3f %.3f) d %.3f m, %d of %d points inliers\n", "",
+		   plane.a, plane.b, plane.c, plane.d, estimator.stats().inliers, estimator.stats().points);
+}
+
+static void benchmarkGroundPlane(int iterations)
+{
+	uint16_t* depth = new uint16_t[FRAME_WIDTH * FRAME_HEIGHT];
+	fillSyntheticDepth(depth);
+
+	// The synthetic floor is seen from the default mount so the plane should
+	// come back with d equal to the mount height and normal (0, -cos p, -sin p)
+	OccupancyGridConfig mount;
+	getDefaultOccupancyGridConfig(&mount);
+	printf("ground plane (expect normal (0.000 %.3f %.3f) d %.3f m)\n",
+		   -cosf(mount.sensorPitch), -sinf(mount.sensorPitch), mount.sensorHeight);
+
+	runGroundPlane(depth, NULL, iterations, "1 thread");
+	WorkerPool pool;
+	runGroundPlane(depth, &pool, iterations, "pool");
+
+	delete[] depth;
+}
+
+static int countHoles(const uint16_t* depth)
+{
+	int holes = 0;
+	for( int i = 0; i < FRAME_WIDTH * FRAME_HEIGHT; i++ )
+		holes += depth[i] == 0;
+	return holes;
+}
+
+static double timeDepthFilter(uint16_t* const* frames, int frameCount, bool simd, int iterations, uint16_t* output)
+{
+	DepthFilter filter;
+	filter.initialize(FRAME_WIDTH, FRAME_HEIGHT);
+	filter.setUseSimd(simd);
+
+	double start = getTimeSeconds();
+	for( int i = 0; i < iterations; i++ )
+		filter.filter(frames[i % frameCount], output);
+	return (getTimeSeconds() - start) / iterations;
+}
+
+static void benchmarkDepthFilter(int iterations)
+{
+	// Clean frames with independent dropouts and speckle on top
+	const int frameCount = 8;
+	uint16_t* frames[frameCount];
+	uint32_t random = 12345;
+	for( int f = 0; f < frameCount; f++ )
+	{
+		frames[f] = new uint16_t[FRAME_WIDTH * FRAME_HEIGHT];
+		fillSyntheticDepth(frames[f]);
+		for( int i = 0; i < FRAME_WIDTH * FRAME_HEIGHT; i++ )
+		{
+			random = random * 1664525 + 1013904223;
+			int roll = random >> 24;
+			if( roll < 20 )
+				frames[f][i] = 0;
+			else if( roll < 23 )
+				frames[f][i] = (uint16_t)((random & 0xFFF) << DEPTH_PLAYER_INDEX_SHIFT);
+		}
+	}
+
+	uint16_t* scalar = new uint16_t[FRAME_WIDTH * FRAME_HEIGHT];
+	uint16_t* vector = new uint16_t[FRAME_WIDTH * FRAME_HEIGHT];
+	// Frame counts that are a multiple of the frame set end on the same input
+	int runs = ((iterations + frameCount - 1) / frameCount) * frameCount;
+	double scalarTime = timeDepthFilter(frames, frameCount, false, runs, scalar);
+	double vectorTime = timeDepthFilter(frames, frameCount, true, runs, vector);
+
+	printf("depth filter\n");
+	printf("  scalar               %8.3f ms/frame\n", scalarTime * 1e3);
+	printf("  simd                 %8.3f ms/frame\n", vectorTime * 1e3);
+	printf("  simd matches scalar  %8s\n", memcmp(scalar, vector, FRAME_WIDTH * FRAME_HEIGHT * sizeof(uint16_t)) ? "no" : "yes");
+	printf("  holes                %8d -> %d\n", countHoles(frames[frameCount - 1]), countHoles(vector));
+
+	for( int f = 0; f < frameCount; f++ )
+		delete[] frames[f];
+	delete[] scalar;
+	delete[] vector;
+}
+
+// Encodes and decodes the frames round robin, iterations times each way,
+// and reports throughput in MB/s of raw depth with the compression ratio
+static void runDepthCodec(const uint16_t* const* frames, int frameCount, int width, int height, int iterations,
+						  const char* label)
+{
+	size_t capacity = depthCodecMaxEncodedSize(width, height);
+	size_t rawSize = (size_t)width * height * sizeof(uint16_t);
+	uint8_t* encoded = new uint8_t[capacity * frameCount];
+	size_t* sizes = new size_t[frameCount];
+	uint16_t* decoded = new uint16_t[width * height];
+	int runs = ((iterations + frameCount - 1) / frameCount) * frameCount;
+
+	double start = getTimeSeconds();
+	for( int i = 0; i < runs; i++ )
+		sizes[i % frameCount] = encodeDepthFrame(frames[i % frameCount], width, height,
+												 &encoded[capacity * (i % frameCount)], capacity);
+	double encodeTime = (getTimeSeconds() - start) / runs;
+
+	bool ok = true;
+	start = getTimeSeconds();
+	for( int i = 0; i < runs; i++ )
+		ok = decodeDepthFrame(&encoded[capacity * (i % frameCount)], sizes[i % frameCount], decoded, width, height) &&
+			 ok;
+	double decodeTime = (getTimeSeconds() - start) / runs;
+
+	double encodedSize = 0.0;
+	for( int f = 0; f < frameCount; f++ )
+	{
+		encodedSize += sizes[f];
+		ok = ok && decodeDepthFrame(&encoded[capacity * f], sizes[f], decoded, width, height) &&
+			 !memcmp(frames[f], decoded, rawSize);
+	}
+	double ratio = rawSize * frameCount / encodedSize;
+
+	printf("  %-12s ratio %5.2f  encode %6.0f MB/s (%.3f ms)  decode %6.0f MB/s (%.3f ms)  round trip %s\n", label,
+		   ratio, rawSize / encodeTime / 1e6, encodeTime * 1e3, rawSize / decodeTime / 1e6, decodeTime * 1e3,
+		   ok ? "ok" : "FAILED");
+	std::string name = std::string("codec.") + label;
+	recordResult((name + ".encode").c_str(), rawSize / encodeTime / 1e6, "MB/s", true);
+	recordResult((name + ".decode").c_str(), rawSize / decodeTime / 1e6, "MB/s", true);
+	recordResult((name + ".ratio").c_str(), ratio, "x", true);
+
+	delete[] encoded;
+	delete[] sizes;
+	delete[] decoded;
+}
+
+static void benchmarkDepthCodec(int iterations, const char* sessionPath)
+{
+	uint16_t* depth = new uint16_t[FRAME_WIDTH * FRAME_HEIGHT];
+	printf("depth codec (%dx%d)\n", FRAME_WIDTH, FRAME_HEIGHT);
+
+	fillSyntheticDepth(depth);
+	runDepthCodec(&depth, 1, FRAME_WIDTH, FRAME_HEIGHT, iterations, "clean");
+
+	// Kinect style noise: readings wander a few millimeters and drop out in clumps
+	uint32_t random = 777;
+	for( int i = 0; i < FRAME_WIDTH * FRAME_HEIGHT; i++ )
+	{
+		random = random * 1664525 + 1013904223;
+		int mm = depth[i] >> DEPTH_PLAYER_INDEX_SHIFT;
+		if( mm )
+			mm += (int)((random >> 28) & 7) - 3;
+		if( (random >> 20 & 0xFF) < 8 )
+			mm = 0;
+		depth[i] = (uint16_t)(mm << DEPTH_PLAYER_INDEX_SHIFT);
+	}
+	runDepthCodec(&depth, 1, FRAME_WIDTH, FRAME_HEIGHT, iterations, "noisy");
+
+	// Player index bits in a stripe, coded as runs after the depth
+	for( int i = 0; i < FRAME_WIDTH * FRAME_HEIGHT; i++ )
+		if( depth[i] && (i % FRAME_WIDTH) > 300 && (i % FRAME_WIDTH) < 340 )
+			depth[i] |= 1;
+	runDepthCodec(&depth, 1, FRAME_WIDTH, FRAME_HEIGHT, iterations, "players");
+	delete[] depth;
+
+	// Up to 64 distinct depth frames of a real recording, copied out since
+	// playback may decode into the same buffer every time
+	if( !sessionPath )
+		return;
+	SessionPlayback playback;
+	if( !playback.open(sessionPath) )
+	{
+		printf("  cannot play back %s\n", sessionPath);
+		return;
+	}
+	const int maxFrames = 64;
+	uint16_t* recorded[maxFrames];
+	int count = 0, width = 0, height = 0;
+	double lastTimestamp = -1.0;
+	Frame frame;
+	while( count < maxFrames && playback.nextFrame(&frame) )
+	{
+		if( !frame.depth || frame.depthTimestamp == lastTimestamp )
+			continue;
+		if( !count )
+		{
+			width = frame.depthWidth;
+			height = frame.depthHeight;
+		}
+		if( frame.depthWidth != width || frame.depthHeight != height )
+			continue;
+		recorded[count] = new uint16_t[width * height];
+		memcpy(recorded[count], frame.depth, width * height * sizeof(uint16_t));
+		lastTimestamp = frame.depthTimestamp;
+		count++;
+	}
+	if( count )
+		runDepthCodec(recorded, count, width, height, iterations, "recorded");
+	else
+		printf("  no depth in %s\n", sessionPath);
+	for( int i = 0; i < count; i++ )
+		delete[] recorded[i];
+}
+
+// Gray background with an orange ball moving across it, in the Kinect
+// BGRX layout where the unused top byte is zero
+static void fillSyntheticColor(uint8_t* color, int frame)
+{
+	int centerX = 100 + (frame * 7) % 440;
+	int centerY = 240;
+	for( int y = 0; y < FRAME_HEIGHT; y++ )
+	{
+		uint32_t* row = (uint32_t*)&color[y * FRAME_WIDTH * 4];
+		for( int x = 0; x < FRAME_WIDTH; x++ )
+		{
+			int dx = x - centerX, dy = y - centerY;
+			row[x] = dx * dx + dy * dy < 30 * 30 ? 0x00FF8C00 : 0x00606060;
+		}
+	}
+}
+
+static void benchmarkSessionPlayback(int iterations)
+{
+	const char* path = "benchmark_session.lses";
+	int frameCount = iterations < 30 ? 30 : iterations;
+
+	uint8_t* color = new uint8_t[FRAME_WIDTH * FRAME_HEIGHT * 4];
+	uint16_t* depth = new uint16_t[FRAME_WIDTH * FRAME_HEIGHT];
+	fillSyntheticDepth(depth);
+
+	SessionWriter writer;
+	if( !writer.open(path) )
+	{
+		printf("session playback: cannot write %s\n", path);
+		delete[] color;
+		delete[] depth;
+		return;
+	}
+	double start = getTimeSeconds();
+	for( int i = 0; i < frameCount; i++ )
+	{
+		fillSyntheticColor(color, i);
+		writer.writeDepth(depth, FRAME_WIDTH, FRAME_HEIGHT, i / 30.0);
+		writer.writeColor(color, FRAME_WIDTH, FRAME_HEIGHT, FRAME_WIDTH * 4, i / 30.0 + 0.001);
+	}
+	uint64_t bytes = writer.bytesWritten();
+	writer.close();
+	double recordTime = getTimeSeconds() - start;
+
+	TrackerCore tracker;
+	SessionPlayback playback;
+	playback.open(path);
+
+	Frame frame;
+	int played = 0;
+	start = getTimeSeconds();
+	while( playback.nextFrame(&frame) )
+		played++;
+	double readTime = getTimeSeconds() - start;
+
+	playback.rewind();
+	start = getTimeSeconds();
+	while( playback.nextFrame(&frame) )
+		tracker.findTarget(frame.color, frame.colorPitch, frame.colorPitch * frame.colorHeight);
+	double trackTime = getTimeSeconds() - start;
+	playback.close();
+	remove(path);
+
+	printf("session playback (%d frames, %.1f MB)\n", played, bytes / 1e6);
+	printf("  record               %8.3f ms/frame\n", recordTime / frameCount * 1e3);
+	printf("  play back            %8.3f ms/frame\n", readTime / played * 1e3);
+	printf("  play back and track  %8.3f ms/frame  %.0f fps\n", trackTime / played * 1e3, played / trackTime);
+
+	delete[] color;
+	delete[] depth;
+}
+
+static double percentile(std::vector<double>& samples, double fraction)
+{
+	if( samples.empty() )
+		return 0.0;
+	size_t rank = (size_t)(fraction * (samples.size() - 1));
+	std::nth_element(samples.begin(), samples.begin() + rank, samples.end());
+	return samples[rank];
+}
+
+// Feeds the recorder color and depth pairs either paced at 30 Hz like the
+// Kinect or back to back to push the writer into backpressure
+static void runRecorder(int frames, int slots, bool paced, const char* label)
+{
+	const char* path = "benchmark_recorder.lses";
+	uint8_t* color = new uint8_t[FRAME_WIDTH * FRAME_HEIGHT * 4];
+	uint16_t* depth = new uint16_t[FRAME_WIDTH * FRAME_HEIGHT];
+	fillSyntheticDepth(depth);
+	std::vector<double> latencies;
+	latencies.reserve(frames * 2);
+
+	AsyncRecorder recorder;
+	if( !recorder.start(path, slots) )
+	{
+		printf("  %-20s cannot write %s\n", label, path);
+		delete[] color;
+		delete[] depth;
+		return;
+	}
+
+	double begin = getTimeSeconds();
+	for( int i = 0; i < frames; i++ )
+	{
+		fillSyntheticColor(color, i);
+		if( paced )
+		{
+			double due = begin + i / 30.0;
+			double wait = due - getTimeSeconds();
+			if( wait > 0.0 )
+				std::this_thread::sleep_for(std::chrono::microseconds((long long)(wait * 1e6)));
+		}
+
+		double start = getTimeSeconds();
+		recorder.recordColor(color, FRAME_WIDTH, FRAME_HEIGHT, FRAME_WIDTH * 4, start);
+		double middle = getTimeSeconds();
+		recorder.recordDepth(depth, FRAME_WIDTH, FRAME_HEIGHT, middle);
+		double end = getTimeSeconds();
+		latencies.push_back(middle - start);
+		latencies.push_back(end - middle);
+	}
+	recorder.stop();
+	remove(path);
+
+	AsyncRecorderStats stats = recorder.stats();
+	double p50 = percentile(latencies, 0.50);
+	double p99 = percentile(latencies, 0.99);
+	double worst = *std::max_element(latencies.begin(), latencies.end());
+	printf("  %-20s enqueue p50 %6.1f us  p99 %6.1f us  max %7.1f us\n", label, p50 * 1e6, p99 * 1e6, worst * 1e6);
+	printf("  %-20s queued %llu  dropped color %llu depth %llu  written %llu  peak ring %d/%d\n", "",
+		   (unsigned long long)(stats.colorQueued + stats.depthQueued), (unsigned long long)stats.colorDropped,
+		   (unsigned long long)stats.depthDropped, (unsigned long long)stats.written, stats.maxQueued, slots);
+
+	delete[] color;
+	delete[] depth;
+}
+
+static void benchmarkRecorder(int iterations)
+{
+	printf("async recorder (color + depth per frame)\n");
+	runRecorder(iterations < 90 ? 90 : iterations, 16, true, "30 Hz");
+	runRecorder(iterations < 90 ? 90 : iterations, 4, false, "flat out, 4 slots");
+}
+
+static double median(std::vector<double> samples)
+{
+	return percentile(samples, 0.5);
+}
+
+// Fills a frame where the given fraction of pixels, scattered at random,
+// passes the tracker's color test. With scatter every pixel gets its own
+// random color, so the table is read all over the place the way a real
+// scene reads it, otherwise the frame holds just two colors and the table
+// stays in cache.
+static void fillClassificationFrame(const TrackerCore& tracker, uint32_t* pixels, int count, double density,
+									bool scatter, uint32_t seed)
+{
+	uint32_t random = seed | 1;
+	uint32_t threshold = (uint32_t)(density * 4294967295.0);
+	for( int i = 0; i < count; i++ )
+	{
+		random ^= random << 13;
+		random ^= random >> 17;
+		random ^= random << 5;
+		bool hit = density >= 1.0 || random < threshold;
+		if( !scatter )
+		{
+			pixels[i] = hit ? 0x00FF8C00 : 0x00606060;
+			continue;
+		}
+		uint32_t color;
+		do
+		{
+			random ^= random << 13;
+			random ^= random >> 17;
+			random ^= random << 5;
+			color = random & 0x00FFFFFF;
+		}
+		while( (tracker.colorMask[color] != 0) != hit );
+		pixels[i] = color;
+	}
+}
+
+static void runClassification(TrackerCore& tracker, CacheMissCounter& misses, int width, int height, double density,
+							  bool scatter, int repeats)
+{
+	int count = width * height;
+	uint32_t* pristine = new uint32_t[count];
+	uint32_t* frame = new uint32_t[count];
+	fillClassificationFrame(tracker, pristine, count, density, scatter, 12345);
+
+	std::vector<double> times;
+	uint64_t missTotal = 0;
+	for( int i = 0; i < repeats; i++ )
+	{
+		// Copied in every pass, so the frame is as warm in cache as a fresh sensor copy
+		memcpy(frame, pristine, count * sizeof(uint32_t));
+		misses.start();
+		double start = getTimeSeconds();
+		tracker.findTarget(frame, width * 4, count * 4);
+		times.push_back(getTimeSeconds() - start);
+		missTotal += misses.stop();
+	}
+	double time = median(times);
+
+	char label[64];
+	sprintf_s(label, sizeof(label), "%dx%d %s %g%%", width, height, scatter ? "scattered" : "two-color", density * 100.0);
+	printf("  %-30s %8.3f ms  %7.2f ns/pixel", label, time * 1e3, time / count * 1e9);
+	if( misses.available() )
+		printf("  %9.0f cache misses", (double)missTotal / repeats);
+	printf("\n");
+
+	char name[96];
+	sprintf_s(name, sizeof(name), "classify.%dx%d.%s.%g", width, height, scatter ? "scattered" : "flat", density * 100.0);
+	recordResult(name, time * 1e3, "ms");
+	if( misses.available() )
+	{
+		sprintf_s(name, sizeof(name), "classify.%dx%d.%s.%g.cache_misses", width, height,
+				  scatter ? "scattered" : "flat", density * 100.0);
+		recordResult(name, (double)missTotal / repeats, "misses");
+	}
+
+	delete[] pristine;
+	delete[] frame;
+}
+
+static void benchmarkTrackerCore(int iterations)
+{
+	printf("tracking core\n");
+
+	// The constructor builds the table once, time a few rebuilds on top
+	size_t residentBefore = currentResidentBytes();
+	TrackerCore tracker;
+	size_t residentAfter = currentResidentBytes();
+	std::vector<double> times;
+	for( int i = 0; i < 3; i++ )
+	{
+		double start = getTimeSeconds();
+		tracker.generateColorMask();
+		times.push_back(getTimeSeconds() - start);
+	}
+	double lutTime = median(times);
+	size_t lutBytes = (size_t)NUM_COLOR_VALUES * NUM_COLOR_VALUES * NUM_COLOR_VALUES * sizeof(int);
+	printf("  generate color mask          %8.1f ms\n", lutTime * 1e3);
+	printf("  color mask                   %8.1f MB, %.1f MB resident after building\n", lutBytes / 1048576.0,
+		   (residentAfter > residentBefore ? residentAfter - residentBefore : 0) / 1048576.0);
+	recordResult("lut.generate", lutTime * 1e3, "ms");
+	recordResult("memory.lut", (double)lutBytes, "bytes");
+	if( residentAfter )
+		recordResult("memory.lut_resident", (double)(residentAfter > residentBefore ? residentAfter - residentBefore : 0), "bytes");
+
+	CacheMissCounter misses;
+	if( !misses.available() )
+		printf("  (cache miss counters not available)\n");
+
+	int repeats = std::max(5, iterations / 10);
+	static const int sizes[][2] = { { 320, 240 }, { 640, 480 }, { 1280, 960 } };
+	static const double densities[] = { 0.0, 0.01, 0.1, 0.5, 1.0 };
+	for( int size = 0; size < 3; size++ )
+		for( int density = 0; density < 5; density++ )
+			runClassification(tracker, misses, sizes[size][0], sizes[size][1], densities[density], true, repeats);
+	for( int density = 0; density < 5; density++ )
+		runClassification(tracker, misses, 640, 480, densities[density], false, repeats);
+
+	size_t peak = peakResidentBytes();
+	if( peak )
+	{
+		printf("  peak resident                %8.1f MB\n", peak / 1048576.0);
+		recordResult("memory.peak_resident", (double)peak, "bytes");
+	}
+}
+
+// Drives the tracker with synthetic frames as fast as it takes them and
+// checks every centroid against where the scene put the target pixels
+static void runSyntheticTracking(TrackerCore& tracker, const SyntheticSceneConfig& config, int frames, const char* label)
+{
+	SyntheticScene scene;
+	if( !scene.initialize(config) )
+	{
+		printf("  %-20s bad scene configuration\n", label);
+		return;
+	}
+
+	std::vector<double> latencies;
+	latencies.reserve(frames);
+	double trackTime = 0.0, generateTime = 0.0;
+	double errorSum = 0.0, worstError = 0.0;
+	int measured = 0, missed = 0;
+
+	Frame frame;
+	for( int i = 0; i < frames; i++ )
+	{
+		double start = getTimeSeconds();
+		scene.nextFrame(&frame);
+		double middle = getTimeSeconds();
+		tracker.centerOne.x = tracker.centerOne.y = -1;
+		tracker.findTarget(frame.color, frame.colorPitch, frame.colorPitch * frame.colorHeight);
+		double end = getTimeSeconds();
+		generateTime += middle - start;
+		trackTime += end - middle;
+		latencies.push_back(end - middle);
+
+		double x, y;
+		if( !scene.targetCentroid(&x, &y) )
+			continue;
+		if( tracker.centerOne.x < 0 )
+		{
+			missed++;
+			continue;
+		}
+		double dx = tracker.centerOne.x - x, dy = tracker.centerOne.y - y;
+		double error = sqrt(dx * dx + dy * dy);
+		errorSum += error;
+		worstError = std::max(worstError, error);
+		measured++;
+	}
+
+	double p50 = percentile(latencies, 0.50);
+	double p99 = percentile(latencies, 0.99);
+	double worst = *std::max_element(latencies.begin(), latencies.end());
+	printf("  %-20s %7.0f fps  p50 %6.3f ms  p99 %6.3f ms  max %6.3f ms  (scene %.3f ms/frame)\n", label,
+		   frames / trackTime, p50 * 1e3, p99 * 1e3, worst * 1e3, generateTime / frames * 1e3);
+	printf("  %-20s centroid error mean %.2f px  max %.2f px  missed %d of %d\n", "",
+		   measured ? errorSum / measured : 0.0, worstError, missed, measured + missed);
+
+	std::string name = std::string("synthetic.") + label;
+	recordResult((name + ".fps").c_str(), frames / trackTime, "fps", true);
+	recordResult((name + ".p99").c_str(), p99 * 1e3, "ms");
+	recordResult((name + ".error").c_str(), measured ? errorSum / measured : 0.0, "px");
+}
+
+static void benchmarkSyntheticTracking(int iterations)
+{
+	int frames = iterations < 100 ? 100 : iterations;
+	TrackerCore tracker;
+
+	printf("tracking synthetic scenes (%d frames each)\n", frames);
+	SyntheticSceneConfig config;
+	getDefaultSyntheticSceneConfig(&config);
+	config.noise = 0;
+	config.gradient = 0.0f;
+	config.distractors = 0;
+	runSyntheticTracking(tracker, config, frames, "clean");
+
+	getDefaultSyntheticSceneConfig(&config);
+	runSyntheticTracking(tracker, config, frames, "default");
+
+	config.noise = 20;
+	config.gradient = 0.45f;
+	config.distractors = 12;
+	config.radius = 12;
+	runSyntheticTracking(tracker, config, frames, "hard");
+
+	getDefaultSyntheticSceneConfig(&config);
+	config.width = 320;
+	config.height = 240;
+	config.radius = 12;
+	runSyntheticTracking(tracker, config, frames, "320x240");
+}
+
+// Tracks a sequence with a full scan and then with motion gating, both
+// after a warm up pass. That the two agree at threshold 0 is for the Tests
+// tool.
+static void runMotionGating(FrameSource* source, int frames, int tileSize, int threshold, const char* label)
+{
+	TrackerCore full, gated;
+	gated.setMotionGating(tileSize, threshold);
+
+	double trackTime[2] = { 0.0, 0.0 }, totalTime[2] = { 0.0, 0.0 };
+	int64_t tiles = 0, skipped = 0;
+	int played = 0;
+	for( int pass = 0; pass < 3; pass++ )
+	{
+		TrackerCore& tracker = pass == 2 ? gated : full;
+		if( !source->rewind() )
+		{
+			printf("  %-20s cannot rewind the sequence\n", label);
+			return;
+		}
+		Frame frame;
+		played = 0;
+		double start = getTimeSeconds();
+		while( played < frames && source->nextFrame(&frame) )
+		{
+			double trackStart = getTimeSeconds();
+			tracker.centerOne.x = tracker.centerOne.y = -1;
+			tracker.findTarget(frame.color, frame.colorPitch, frame.colorPitch * frame.colorHeight);
+			double trackEnd = getTimeSeconds();
+			if( pass )
+				trackTime[pass - 1] += trackEnd - trackStart;
+
+			if( pass == 2 )
+			{
+				tiles += tracker.tileCount;
+				skipped += tracker.tilesSkipped;
+			}
+			played++;
+		}
+		if( pass )
+			totalTime[pass - 1] = getTimeSeconds() - start;
+	}
+	if( !played )
+		return;
+
+	double skippedFraction = tiles ? (double)skipped / tiles : 0.0;
+	printf("  %-20s skipped %5.1f%% of tiles  track %6.3f -> %6.3f ms (x%.2f)  end to end %6.3f -> %6.3f ms (x%.2f)\n",
+		   label, skippedFraction * 100.0, trackTime[0] / played * 1e3, trackTime[1] / played * 1e3,
+		   trackTime[0] / trackTime[1], totalTime[0] / played * 1e3, totalTime[1] / played * 1e3,
+		   totalTime[0] / totalTime[1]);
+
+	std::string name = std::string("gating.") + label;
+	recordResult((name + ".skipped").c_str(), skippedFraction * 100.0, "%", true);
+	recordResult((name + ".speedup").c_str(), trackTime[0] / trackTime[1], "x", true);
+}
+
+// Draws a filled ellipse in the target color on the background
+static void drawEllipse(uint32_t* pixels, int width, int height, double cx, double cy, double a, double b, double angle)
+{
+	double c = cos(angle), s = sin(angle);
+	for( int y = 0; y < height; y++ )
+		for( int x = 0; x < width; x++ )
+		{
+			double u = (x - cx) * c + (y - cy) * s;
+			double v = -(x - cx) * s + (y - cy) * c;
+			pixels[y * width + x] = u * u / (a * a) + v * v / (b * b) <= 1.0 ? 0x00FF8C00 : 0x00606060;
+		}
+}
+
+// Times findTarget with and without the moment descriptors on the same
+// frames, then checks the descriptors against shapes whose answer is known
+static void benchmarkDescriptors(TrackerCore& tracker, int iterations)
+{
+	const int width = 640, height = 480, count = width * height;
+	int repeats = std::max(9, iterations / 10);
+	uint32_t* pristine = new uint32_t[count];
+	uint32_t* frame = new uint32_t[count];
+
+	printf("target descriptors (%d repeats)\n", repeats);
+	static const double densities[] = { 0.01, 0.1, 0.5 };
+	for( int scatter = 0; scatter < 2; scatter++ )
+		for( int density = 0; density < 3; density++ )
+		{
+			fillClassificationFrame(tracker, pristine, count, densities[density], scatter != 0, 12345);
+			// Alternating so neither side gets the warmer cache
+			std::vector<double> samples[2];
+			for( int i = 0; i < repeats * 2; i++ )
+			{
+				int describe = i & 1;
+				tracker.computeDescriptors = describe != 0;
+				memcpy(frame, pristine, count * sizeof(uint32_t));
+				double start = getTimeSeconds();
+				tracker.findTarget(frame, width * 4, count * 4);
+				samples[describe].push_back(getTimeSeconds() - start);
+			}
+			double times[2] = { median(samples[0]), median(samples[1]) };
+			char label[64];
+			sprintf_s(label, sizeof(label), "%s %g%%", scatter ? "scattered" : "two-color", densities[density] * 100.0);
+			printf("  %-20s centroid %7.3f ms  with descriptors %7.3f ms  %+7.1f us (%+.1f%%)\n", label, times[0] * 1e3,
+				   times[1] * 1e3, (times[1] - times[0]) * 1e6, (times[1] / times[0] - 1.0) * 100.0);
+			char name[64];
+			sprintf_s(name, sizeof(name), "descriptors.%s.%g", scatter ? "scattered" : "flat", densities[density] * 100.0);
+			recordResult(name, (times[1] - times[0]) * 1e6, "us");
+		}
+	tracker.computeDescriptors = true;
+
+	// A tilted ellipse, the moments of a filled ellipse give back its semi-axes
+	const double pi = 3.14159265358979;
+	drawEllipse(frame, width, height, 300.5, 220.5, 80.0, 30.0, pi / 6);
+	tracker.findTarget(frame, width * 4, count * 4);
+	const TargetDescriptor& ellipse = tracker.targetOne;
+	printf("  %-20s axes %.1f %.1f (80 30)  orientation %.3f (%.3f)  eccentricity %.3f (%.3f)  area %d (%.0f)\n",
+		   "ellipse", ellipse.majorAxis, ellipse.minorAxis, ellipse.orientation, pi / 6, ellipse.eccentricity,
+		   sqrt(1.0 - 30.0 * 30.0 / (80.0 * 80.0)), ellipse.area, pi * 80.0 * 30.0);
+
+	// The clean synthetic ball against the scene's ground truth
+	SyntheticSceneConfig config;
+	getDefaultSyntheticSceneConfig(&config);
+	config.noise = 0;
+	config.gradient = 0.0f;
+	config.distractors = 0;
+	config.targets = 1;
+	SyntheticScene scene;
+	scene.initialize(config);
+	Frame sceneFrame;
+	int worstArea = 0, measured = 0;
+	double worstRadius = 0.0, worstEccentricity = 0.0;
+	for( int i = 0; i < 100 && scene.nextFrame(&sceneFrame); i++ )
+	{
+		tracker.findTarget(sceneFrame.color, sceneFrame.colorPitch, sceneFrame.colorPitch * sceneFrame.colorHeight);
+		if( !scene.blobCount() || !scene.blob(0).pixels || !tracker.targetOne.found )
+			continue;
+		const TargetDescriptor& ball = tracker.targetOne;
+		// Balls cut off by the image edge are not round
+		if( ball.left == 0 || ball.top == 0 || ball.right == width - 1 || ball.bottom == height - 1 )
+			continue;
+		worstArea = std::max(worstArea, abs(ball.area - scene.blob(0).pixels));
+		worstRadius = std::max(worstRadius, fabs((double)ball.majorAxis - config.radius));
+		worstEccentricity = std::max(worstEccentricity, (double)ball.eccentricity);
+		measured++;
+	}
+	printf("  %-20s %d frames  area off by up to %d px  radius by up to %.2f px  eccentricity up to %.3f\n",
+		   "synthetic ball", measured, worstArea, worstRadius, worstEccentricity);
+
+	delete[] pristine;
+	delete[] frame;
+}
+
+// Ground truth trajectories for the target filter, position at t seconds
+// Times one update of each model on a curving target measured at 30 Hz
+// with noise and two dropouts, so both the corrected and the coasting path
+// are taken. How well the filter follows the target is checked by the
+// filter suite of the Tests tool.
+static void runTargetFilter(bool constantAcceleration, int frames)
+{
+	TargetFilterConfig config;
+	getDefaultTargetFilterConfig(&config);
+	config.constantAcceleration = constantAcceleration;
+	config.measurementNoise = 1.5;
+	TargetFilter filter;
+	filter.initialize(config);
+
+	uint32_t random = 2463534242u;
+	double updateTime = 0.0;
+	for( int i = 0; i < frames; i++ )
+	{
+		double t = i / 30.0;
+		random = random * 1664525 + 1013904223;
+		double x = 320.0 + 150.0 * cos(2.0 * t) + ((random >> 24) - 128) / 64.0;
+		double y = 240.0 + 150.0 * sin(2.0 * t) + ((random >> 16 & 0xFF) - 128) / 64.0;
+		bool found = i % 300 < 100 || i % 300 >= 105;
+
+		double start = getTimeSeconds();
+		filter.update(0, t, found, x, y);
+		updateTime += getTimeSeconds() - start;
+	}
+
+	const char* model = constantAcceleration ? "ca" : "cv";
+	printf("  %s %.0f ns per update\n", model, updateTime / frames * 1e9);
+	char name[64];
+	sprintf_s(name, sizeof(name), "filter.%s.update", model);
+	recordResult(name, updateTime / frames * 1e9, "ns");
+}
+
+static void benchmarkTargetFilter(int iterations)
+{
+	int frames = iterations < 3000 ? 3000 : iterations;
+	printf("target filter (%d updates)\n", frames);
+	runTargetFilter(false, frames);
+	runTargetFilter(true, frames);
+}
+
+// Motion gating on synthetic scenes, on the same scene played back from a
+// recording, and on a real recording when one is given
+static void benchmarkMotionGating(int iterations, const char* sessionPath)
+{
+	int frames = iterations < 100 ? 100 : iterations;
+	const int tileSize = 32;
+	printf("motion gating (%dx%d tiles, %d frames)\n", tileSize, tileSize, frames);
+
+	SyntheticSceneConfig config;
+	getDefaultSyntheticSceneConfig(&config);
+	config.noise = 0;
+	config.frames = frames;
+	SyntheticScene scene;
+	scene.initialize(config);
+	runMotionGating(&scene, frames, tileSize, 0, "clean");
+
+	// Sensor noise touches every tile, only a threshold lets any be skipped.
+	// Just above the noise floor of a tile, which is 2/3 of noise per byte on average.
+	getDefaultSyntheticSceneConfig(&config);
+	config.frames = frames;
+	scene.initialize(config);
+	runMotionGating(&scene, frames, tileSize, 0, "noisy");
+	runMotionGating(&scene, frames, tileSize, tileSize * tileSize * 3 * config.noise * 3 / 4, "noisy thresholded");
+
+	// The clean scene again, this time out of a session file
+	const char* path = "benchmark_gating.lses";
+	getDefaultSyntheticSceneConfig(&config);
+	config.noise = 0;
+	config.frames = frames;
+	scene.initialize(config);
+	SessionWriter writer;
+	if( writer.open(path) )
+	{
+		Frame frame;
+		while( scene.nextFrame(&frame) )
+			writer.writeColor(frame.color, frame.colorWidth, frame.colorHeight, frame.colorPitch, frame.colorTimestamp);
+		writer.close();
+		SessionPlayback playback;
+		if( playback.open(path) )
+			runMotionGating(&playback, frames, tileSize, 0, "clean recorded");
+		playback.close();
+		remove(path);
+	}
+
+	if( sessionPath )
+	{
+		SessionPlayback playback;
+		if( playback.open(sessionPath) )
+			runMotionGating(&playback, (int)playback.frameCount(), tileSize, 0, "recorded");
+		else
+			printf("  cannot play back %s\n", sessionPath);
+	}
+}
+
+// Tracks the same synthetic frames with and without the profiler hooks, the
+// difference is what instrumenting a pipeline costs
+static void benchmarkLatencyProfiler(int iterations)
+{
+	enum { STAGE_SOURCE, STAGE_COPY, STAGE_TRACK, STAGE_COUNT };
+	static const char* const stageNames[STAGE_COUNT] = { "source", "copy", "track" };
+
+	int frames = iterations < 100 ? 100 : iterations;
+	SyntheticSceneConfig config;
+	getDefaultSyntheticSceneConfig(&config);
+	config.noise = 0;
+	config.frames = frames;
+	SyntheticScene scene;
+	scene.initialize(config);
+	TrackerCore tracker;
+	LatencyProfiler profiler;
+	profiler.initialize(stageNames, STAGE_COUNT);
+	uint8_t* copy = new uint8_t[config.width * config.height * 4];
+
+	double plainTime = 0.0, profiledTime = 0.0;
+	for( int pass = 0; pass < 4; pass++ )
+	{
+		bool profiled = pass & 1;
+		scene.rewind();
+		Frame frame;
+		double start = getTimeSeconds();
+		if( profiled )
+		{
+			for( ;; )
+			{
+				profiler.beginFrame();
+				if( !scene.nextFrame(&frame) )
+					break;
+				profiler.mark(STAGE_SOURCE);
+				memcpy(copy, frame.color, frame.colorPitch * frame.colorHeight);
+				profiler.mark(STAGE_COPY);
+				tracker.findTarget(copy, frame.colorPitch, frame.colorPitch * frame.colorHeight);
+				profiler.mark(STAGE_TRACK);
+				profiler.endFrame();
+			}
+		}
+		else
+		{
+			while( scene.nextFrame(&frame) )
+			{
+				memcpy(copy, frame.color, frame.colorPitch * frame.colorHeight);
+				tracker.findTarget(copy, frame.colorPitch, frame.colorPitch * frame.colorHeight);
+			}
+		}
+		// The first pair warms up
+		if( pass >= 2 )
+			(profiled ? profiledTime : plainTime) += getTimeSeconds() - start;
+	}
+
+	// The hooks alone, to put a number on them that frame to frame noise cannot hide
+	LatencyProfiler empty;
+	empty.initialize(stageNames, STAGE_COUNT);
+	int hookRuns = 100000;
+	double start = getTimeSeconds();
+	for( int i = 0; i < hookRuns; i++ )
+	{
+		empty.beginFrame();
+		empty.mark(STAGE_SOURCE);
+		empty.mark(STAGE_COPY);
+		empty.mark(STAGE_TRACK);
+		empty.endFrame();
+	}
+	double hookTime = (getTimeSeconds() - start) / hookRuns;
+
+	printf("latency profiler (%d frames)\n", frames);
+	printf("  hooks per frame      %8.3f us, %.3f%% of a frame\n", hookTime * 1e6, hookTime / (plainTime / frames) * 100.0);
+	printf("  pipeline             %8.3f ms/frame plain, %.3f ms/frame profiled\n", plainTime / frames * 1e3,
+		   profiledTime / frames * 1e3);
+	profiler.writeText(stdout);
+	recordResult("profiler.hooks", hookTime * 1e6, "us");
+
+	delete[] copy;
+}
+
+// Times the display path handoff at the Kinect's frame size: publish() and
+// acquire() on their own, then a producer publishing flat out while a
+// display thread takes frames, to show the producer never waits on it.
+// Whether frames come through whole and in order is for the Tests tool.
+static void benchmarkDisplayPath(int iterations)
+{
+	printf("display path\n");
+
+	const int width = 640, height = 480;
+	DisplayMailbox mailbox;
+	mailbox.initialize(width, height);
+	int calls = std::max(100000, iterations);
+
+	const uint8_t* pixels;
+	const DisplayOverlay* overlay;
+	double start = getTimeSeconds();
+	for( int i = 0; i < calls; i++ )
+		mailbox.publish();
+	double publishTime = (getTimeSeconds() - start) / calls;
+	start = getTimeSeconds();
+	for( int i = 0; i < calls; i++ )
+	{
+		mailbox.publish();
+		mailbox.acquire(&pixels, &overlay);
+	}
+	double acquireTime = (getTimeSeconds() - start) / calls - publishTime;
+
+	std::atomic<bool> done(false);
+	double producerTime = 0.0;
+	std::thread producer([&]()
+	{
+		double begin = getTimeSeconds();
+		for( int i = 0; i < calls; i++ )
+			mailbox.publish();
+		producerTime = (getTimeSeconds() - begin) / calls;
+		done = true;
+	});
+	uint64_t taken = 0;
+	while( !done )
+	{
+		if( mailbox.acquire(&pixels, &overlay) )
+			taken++;
+		else
+			std::this_thread::yield();
+	}
+	producer.join();
+
+	printf("  publish              %8.1f ns\n", publishTime * 1e9);
+	printf("  acquire              %8.1f ns\n", acquireTime * 1e9);
+	printf("  publish, contended   %8.1f ns  (%llu of %d frames taken)\n", producerTime * 1e9,
+		   (unsigned long long)taken, calls);
+	recordResult("display.publish", publishTime * 1e9, "ns");
+	recordResult("display.acquire", acquireTime * 1e9, "ns");
+}
+
+// Runs 1 to 4 synthetic sensors through MultiPipeline flat out and reads the
+// merged stream while they run. Every sensor has to deliver all of its
+// frames, tagged with its own number and in order, and the aggregate rate
+// against N times the single sensor rate shows how well the pipelines scale.
+static void benchmarkMultiSensor(int iterations)
+{
+	int frames = iterations < 100 ? 100 : iterations;
+	unsigned cores = std::thread::hardware_concurrency();
+	printf("multiple sensors (%d frames per sensor, %u hardware threads)\n", frames, cores);
+
+	TrackingPipelineConfig config;
+	getDefaultTrackingPipelineConfig(&config);
+	config.depthRegistered = true;
+	double singleRate = 0.0;
+	for( int sensors = 1; sensors <= 4; sensors++ )
+	{
+		SyntheticScene scenes[4];
+		FrameSource* sources[4];
+		for( int i = 0; i < sensors; i++ )
+		{
+			SyntheticSceneConfig sceneConfig;
+			getDefaultSyntheticSceneConfig(&sceneConfig);
+			sceneConfig.frames = frames;
+			sceneConfig.seed += i * 7919;
+			scenes[i].initialize(sceneConfig);
+			sources[i] = &scenes[i];
+		}
+
+		MultiPipeline pipelines;
+		if( !pipelines.initialize(sources, sensors, config) )
+			return;
+
+		uint32_t received[4] = { 0, 0, 0, 0 };
+		int misplaced = 0;
+		TrackingResult results[64];
+		double start = getTimeSeconds();
+		pipelines.start();
+		for( ;; )
+		{
+			int count = pipelines.read(results, 64, 0.1);
+			for( int i = 0; i < count; i++ )
+			{
+				int sensor = results[i].sensor;
+				if( sensor < 0 || sensor >= sensors || results[i].frame != received[sensor] )
+					misplaced++;
+				else
+					received[sensor]++;
+			}
+			if( !count && !pipelines.running() )
+				break;
+		}
+		uint64_t total = pipelines.wait();
+		double elapsed = getTimeSeconds() - start;
+
+		int incomplete = 0;
+		for( int i = 0; i < sensors; i++ )
+			if( received[i] != (uint32_t)frames || pipelines.processed(i) != (uint32_t)frames )
+				incomplete++;
+
+		double rate = total / elapsed;
+		if( sensors == 1 )
+			singleRate = rate;
+		printf("  %d sensor%s            %7.0f fps total  %6.0f fps each  scaling %.2f of %d  cores",
+			   sensors, sensors > 1 ? "s" : " ", rate, rate / sensors, rate / singleRate, sensors);
+		for( int i = 0; i < sensors; i++ )
+			printf(" %d", pipelines.core(i));
+		printf("\n");
+		if( misplaced || incomplete || pipelines.overflowed() )
+			printf("  %21s %d out of order or mistagged, %d sensors incomplete, %llu dropped\n", "", misplaced,
+				   incomplete, (unsigned long long)pipelines.overflowed());
+
+		char name[32];
+		sprintf_s(name, sizeof(name), "multi.%d.fps", sensors);
+		recordResult(name, rate, "fps", true);
+	}
+}
+
+// Pushes the same frames through the C interface in batches of 1 to 64. What
+// a call costs on top of the frames in it shows as the per-frame time above
+// that of the largest batch. Each tracker has its own 64MB color table and
+// how fast it is looked up varies with where it landed in memory, so times
+// are only compared within one handle; the direct measureTarget time is for
+// reference and the results are checked against it.
+// Times measureTarget called directly against trackerCoreProcess on a handle
+// set up the same way: one thread, no filter, descriptors on, the same
+// frames. Both are warmed up, then timed in alternation over many short
+// rounds with the order rotated each round. The overhead is the median over
+// rounds of each call's time less the direct time of the same round, so
+// clock changes and other load land on both alike, and the middle half of
+// those differences shows how far it can be trusted.
+//
+// The frames are flat colored so both trackers read the same few entries of
+// their color tables. With noisy frames the lookups spread over the whole
+// 64 MB table and where each tracker's table lands in memory alone moves
+// its time by up to 2x, which swamps the interface.
+static void runBatchApi(int width, int height, int frames, int rounds)
+{
+	const int distinct = 16;
+	SyntheticSceneConfig config;
+	getDefaultSyntheticSceneConfig(&config);
+	config.width = width;
+	config.height = height;
+	config.radius = std::max(2, std::min(width, height) / 20);
+	config.noise = 0;
+	config.gradient = 0.0f;
+	SyntheticScene scene;
+	if( !scene.initialize(config) )
+		return;
+	std::vector<uint32_t> pixels((size_t)width * height * distinct);
+	std::vector<TrackerCoreFrame> batch(64);
+	std::vector<TrackerCoreResult> results(64);
+	for( int i = 0; i < distinct; i++ )
+	{
+		Frame frame;
+		scene.nextFrame(&frame);
+		memcpy(&pixels[(size_t)width * height * i], frame.color, (size_t)width * height * 4);
+	}
+	for( int i = 0; i < 64; i++ )
+	{
+		batch[i].timestamp = i / 30.0;
+		batch[i].width = width;
+		batch[i].height = height;
+		batch[i].stride = width * 4;
+		batch[i].reserved = 0;
+		batch[i].pixels = &pixels[(size_t)width * height * (i % distinct)];
+	}
+
+	TrackerCoreHandle single = trackerCoreCreate(1, 0);
+	TrackerCoreHandle pooled = trackerCoreCreate(0, 0);
+	if( !single || !pooled )
+	{
+		printf("  cannot create a tracker through the C interface\n");
+		trackerCoreDestroy(single);
+		trackerCoreDestroy(pooled);
+		return;
+	}
+	TrackerCore direct;
+
+	// Direct, batches of 1, 8 and 64 on one thread, then 64 on the pool
+	const int modes = 5;
+	const int sizes[modes] = { 1, 1, 8, 64, 64 };
+	std::vector<double> samples[modes];
+	frames = std::max(64, frames / 64 * 64);
+	for( int round = -1; round < rounds; round++ )
+	{
+		for( int m = 0; m < modes; m++ )
+		{
+			int mode = (m + std::max(round, 0)) % modes;
+			double start = getTimeSeconds();
+			for( int first = 0; first < frames; first += sizes[mode] )
+			{
+				if( mode == 0 )
+				{
+					TargetDescriptor target;
+					direct.measureTarget(batch[first % 64].pixels, width, height, width * 4, &target);
+				}
+				else
+				{
+					trackerCoreProcess(mode == 4 ? pooled : single, &batch[first % 64], &results[0], sizes[mode]);
+				}
+			}
+			// The first round only warms up the tables and the pool
+			if( round >= 0 )
+				samples[mode].push_back((getTimeSeconds() - start) / frames);
+		}
+	}
+
+	double directTime = median(samples[0]);
+	printf("  %dx%d direct %8.2f us/frame\n", width, height, directTime * 1e6);
+	for( int mode = 1; mode < 4; mode++ )
+	{
+		std::vector<double> differences(rounds);
+		for( int round = 0; round < rounds; round++ )
+			differences[round] = samples[mode][round] - samples[0][round];
+		double overhead = median(differences);
+		double low = percentile(differences, 0.25);
+		double high = percentile(differences, 0.75);
+		printf("    batch %2d  %8.2f us/frame  overhead %+7.0f ns (%+5.1f%%), middle half %+.0f to %+.0f ns\n",
+			   sizes[mode], median(samples[mode]) * 1e6, overhead * 1e9, overhead / directTime * 100.0, low * 1e9,
+			   high * 1e9);
+
+		char name[64];
+		sprintf_s(name, sizeof(name), "capi.%dx%d.batch%d.overhead", width, height, sizes[mode]);
+		recordResult(name, overhead * 1e9, "ns");
+	}
+	printf("    batch 64 on the pool  %8.2f us/frame\n", median(samples[4]) * 1e6);
+
+	trackerCoreDestroy(single);
+	trackerCoreDestroy(pooled);
+}
+
+static void benchmarkBatchApi(int iterations)
+{
+	int frames = std::max(256, iterations);
+	printf("C interface, version %d (%u hardware threads)\n", trackerCoreVersion(), std::thread::hardware_concurrency());
+	// Small frames leave little but the interface itself to time
+	runBatchApi(32, 32, frames * 16, 31);
+	runBatchApi(640, 480, 64, 41);
+}
+
+int main(int argc, char* argv[])
+{
+	int iterations = 100;
+	bool trackerOnly = false;
+	const char* jsonPath = NULL;
+	const char* baselinePath = NULL;
+	const char* sessionPath = NULL;
+	double tolerance = 0.1;
+	for( int i = 1; i < argc; i++ )
+	{
+		if( !strcmp(argv[i], "--tracker") )
+			trackerOnly = true;
+		else if( !strcmp(argv[i], "--json") && i + 1 < argc )
+			jsonPath = argv[++i];
+		else if( !strcmp(argv[i], "--baseline") && i + 1 < argc )
+			baselinePath = argv[++i];
+		else if( !strcmp(argv[i], "--tolerance") && i + 1 < argc )
+			tolerance = atof(argv[++i]) / 100.0;
+		else if( !strcmp(argv[i], "--session") && i + 1 < argc )
+			sessionPath = argv[++i];
+		else
+			iterations = atoi(argv[i]);
+	}
+	if( iterations < 1 )
+		iterations = 1;
+
+	benchmarkTrackerCore(iterations);
+	benchmarkSyntheticTracking(iterations);
+	{
+		TrackerCore tracker;
+		benchmarkDescriptors(tracker, iterations);
+	}
+	benchmarkMotionGating(iterations, sessionPath);
+	benchmarkTargetFilter(iterations);
+	benchmarkLatencyProfiler(iterations);
+	if( !trackerOnly )
+	{
+		benchmarkRegistration(iterations);
+		benchmarkLocalization(iterations);
+		benchmarkOccupancyGrid(iterations);
+		benchmarkGroundPlane(iterations);
+		benchmarkDepthFilter(iterations);
+		benchmarkDepthCodec(iterations, sessionPath);
+		benchmarkSessionPlayback(iterations);
+		benchmarkRecorder(iterations);
+		benchmarkDisplayPath(iterations);
+		benchmarkMultiSensor(iterations);
+		benchmarkBatchApi(iterations);
+	}
+
+	if( jsonPath && !writeResults(jsonPath, iterations) )
+		return 2;
+	if( baselinePath )
+	{
+		int regressions = compareWithBaseline(baselinePath, tolerance);
+		if( regressions < 0 )
+			return 2;
+		if( regressions > 0 )
+			return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,106 @@
+#include "PerfCounters.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#endif
+
+CacheMissCounter::CacheMissCounter()
+{
+	descriptor = -1;
+#ifdef __linux__
+	struct perf_event_attr attributes;
+	memset(&attributes, 0, sizeof(attributes));
+	attributes.type = PERF_TYPE_HARDWARE;
+	attributes.size = sizeof(attributes);
+	attributes.config = PERF_COUNT_HW_CACHE_MISSES;
+	attributes.disabled = 1;
+	attributes.exclude_kernel = 1;
+	attributes.exclude_hv = 1;
+	descriptor = (int)syscall(__NR_perf_event_open, &attributes, 0, -1, -1, 0);
+#endif
+	return;
+}
+
+CacheMissCounter::~CacheMissCounter()
+{
+#ifndef _WIN32
+	if( descriptor >= 0 )
+		close(descriptor);
+#endif
+	return;
+}
+
+void CacheMissCounter::start(void)
+{
+#ifdef __linux__
+	if( descriptor < 0 )
+		return;
+	ioctl(descriptor, PERF_EVENT_IOC_RESET, 0);
+	ioctl(descriptor, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+}
+
+uint64_t CacheMissCounter::stop(void)
+{
+	uint64_t misses = 0;
+#ifdef __linux__
+	if( descriptor < 0 )
+		return 0;
+	ioctl(descriptor, PERF_EVENT_IOC_DISABLE, 0);
+	if( read(descriptor, &misses, sizeof(misses)) != sizeof(misses) )
+		misses = 0;
+#endif
+	return misses;
+}
+
+size_t currentResidentBytes(void)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if( !GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) )
+		return 0;
+	return counters.WorkingSetSize;
+#elif defined(__linux__)
+	FILE* statm = fopen("/proc/self/statm", "r");
+	if( !statm )
+		return 0;
+	unsigned long size = 0, resident = 0;
+	int fields = fscanf(statm, "%lu %lu", &size, &resident);
+	fclose(statm);
+	return fields == 2 ? (size_t)resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+#else
+	return 0;
+#endif
+}
+
+size_t peakResidentBytes(void)
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if( !GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) )
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if( getrusage(RUSAGE_SELF, &usage) != 0 )
+		return 0;
+#ifdef __APPLE__
+	return (size_t)usage.ru_maxrss;
+#else
+	return (size_t)usage.ru_maxrss * 1024;
+#endif
+#endif
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Counts last level cache misses of the calling thread through the Linux
+// perf events interface. Elsewhere, or when the kernel does not allow it,
+// available() is false and stop() returns 0.
+class CacheMissCounter
+{
+public:
+	CacheMissCounter(void);
+	~CacheMissCounter(void);
+
+	bool available(void) const { return descriptor >= 0; }
+
+	void start(void);
+	// Misses since start()
+	uint64_t stop(void);
+
+private:
+	int descriptor;
+
+	CacheMissCounter(const CacheMissCounter&);
+	CacheMissCounter& operator=(const CacheMissCounter&);
+};
+
+// Resident memory of the process in bytes, 0 when it cannot be read
+size_t currentResidentBytes(void);
+size_t peakResidentBytes(void);
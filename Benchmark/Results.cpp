@@ -0,0 +1,174 @@
+#include "Results.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+typedef struct
+{
+	std::string name;
+	double value;
+	std::string unit;
+	bool higherIsBetter;
+} BenchmarkResult;
+
+static std::vector<BenchmarkResult> results;
+
+static FILE* openFile(const char* path, const char* mode)
+{
+	FILE* file = NULL;
+#ifdef _WIN32
+	if( fopen_s(&file, path, mode) )
+		return NULL;
+#else
+	file = fopen(path, mode);
+#endif
+	return file;
+}
+
+void recordResult(const char* name, double value, const char* unit, bool higherIsBetter)
+{
+	BenchmarkResult result;
+	result.name = name;
+	result.value = value;
+	result.unit = unit;
+	result.higherIsBetter = higherIsBetter;
+	results.push_back(result);
+}
+
+bool writeResults(const char* path, int iterations)
+{
+	FILE* file = openFile(path, "w");
+	if( !file )
+	{
+		printf("cannot write %s\n", path);
+		return false;
+	}
+
+	fprintf(file, "{\n  \"version\": 1,\n  \"iterations\": %d,\n  \"results\": [\n", iterations);
+	for( size_t i = 0; i < results.size(); i++ )
+	{
+		const BenchmarkResult& result = results[i];
+		fprintf(file, "    { \"name\": \"%s\", \"value\": %.9g, \"unit\": \"%s\", \"better\": \"%s\" }%s\n",
+				result.name.c_str(), result.value, result.unit.c_str(), result.higherIsBetter ? "higher" : "lower",
+				i + 1 < results.size() ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+	return fclose(file) == 0;
+}
+
+// Just enough JSON to read back what writeResults() writes: the value of a
+// string or number member of the object that text points into
+static bool findMember(const char* object, const char* end, const char* key, std::string* text, double* number)
+{
+	std::string quoted = std::string("\"") + key + "\"";
+	const char* found = strstr(object, quoted.c_str());
+	if( !found || found >= end )
+		return false;
+	const char* cursor = strchr(found + quoted.size(), ':');
+	if( !cursor || cursor >= end )
+		return false;
+	cursor++;
+	while( *cursor == ' ' || *cursor == '\t' || *cursor == '\n' || *cursor == '\r' )
+		cursor++;
+
+	if( *cursor == '"' )
+	{
+		const char* close = strchr(cursor + 1, '"');
+		if( !close || close >= end || !text )
+			return false;
+		text->assign(cursor + 1, close);
+		return true;
+	}
+
+	char* after;
+	double value = strtod(cursor, &after);
+	if( after == cursor || !number )
+		return false;
+	*number = value;
+	return true;
+}
+
+static bool readBaseline(const char* path, std::vector<BenchmarkResult>* baseline)
+{
+	FILE* file = openFile(path, "rb");
+	if( !file )
+		return false;
+	std::string contents;
+	char buffer[4096];
+	size_t got;
+	while( (got = fread(buffer, 1, sizeof(buffer), file)) > 0 )
+		contents.append(buffer, got);
+	fclose(file);
+
+	const char* cursor = strstr(contents.c_str(), "\"results\"");
+	if( !cursor )
+		return false;
+	while( (cursor = strchr(cursor, '{')) != NULL )
+	{
+		const char* end = strchr(cursor, '}');
+		if( !end )
+			break;
+		BenchmarkResult result;
+		std::string better;
+		if( findMember(cursor, end, "name", &result.name, NULL) &&
+			findMember(cursor, end, "value", NULL, &result.value) )
+		{
+			findMember(cursor, end, "unit", &result.unit, NULL);
+			result.higherIsBetter = findMember(cursor, end, "better", &better, NULL) && better == "higher";
+			baseline->push_back(result);
+		}
+		cursor = end + 1;
+	}
+	return true;
+}
+
+int compareWithBaseline(const char* path, double tolerance)
+{
+	std::vector<BenchmarkResult> baseline;
+	if( !readBaseline(path, &baseline) )
+	{
+		printf("cannot read baseline %s\n", path);
+		return -1;
+	}
+
+	int regressions = 0;
+	printf("compared with %s (tolerance %.0f%%)\n", path, tolerance * 100.0);
+	for( size_t i = 0; i < results.size(); i++ )
+	{
+		const BenchmarkResult& result = results[i];
+		const BenchmarkResult* before = NULL;
+		for( size_t j = 0; j < baseline.size() && !before; j++ )
+			if( baseline[j].name == result.name )
+				before = &baseline[j];
+		if( !before )
+		{
+			printf("  %-40s %12.4g %-6s (new)\n", result.name.c_str(), result.value, result.unit.c_str());
+			continue;
+		}
+
+		// Positive change is always the bad direction
+		double change = 0.0;
+		if( before->value != 0.0 )
+			change = (result.value - before->value) / before->value;
+		else if( result.value != 0.0 )
+			change = 1.0;
+		if( result.higherIsBetter )
+			change = -change;
+
+		const char* verdict = "";
+		if( change > tolerance )
+		{
+			verdict = "REGRESSION";
+			regressions++;
+		}
+		else if( change < -tolerance )
+			verdict = "improved";
+		printf("  %-40s %12.4g %-6s was %12.4g  %+6.1f%%  %s\n", result.name.c_str(), result.value,
+			   result.unit.c_str(), before->value, (result.higherIsBetter ? -change : change) * 100.0, verdict);
+	}
+	printf("%d regression%s\n", regressions, regressions == 1 ? "" : "s");
+	return regressions;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+// Benchmarks record their headline numbers here as well as printing them,
+// so a run can be saved as JSON and checked against an earlier run:
+//
+//   { "results": [
+//     { "name": "lut.generate", "value": 412.5, "unit": "ms", "better": "lower" },
+//     ... ] }
+
+void recordResult(const char* name, double value, const char* unit, bool higherIsBetter = false);
+
+bool writeResults(const char* path, int iterations);
+
+// Prints every result next to the baseline run in path and flags those that
+// got worse by more than tolerance (0.1 for 10%). Returns the number of
+// regressions, or -1 when the baseline cannot be read.
+int compareWithBaseline(const char* path, double tolerance);
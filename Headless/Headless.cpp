@@ -0,0 +1,417 @@
+// Runs capture, tracking, depth checks and telemetry with no window, no
+// rendering and no display copies, for the robot where nobody is watching.
+//
+//   Headless [--session file ... | --synthetic] [--sensors n] [--frames n] [--rate fps]
+//            [--realtime] [--host name] [--port n] [--no-telemetry] [--no-filter]
+//            [--no-ground] [--no-grid] [--no-localize] [--gate tile] [--gate-threshold sad] [--no-target-filter]
+//            [--predict seconds] [--stats seconds] [--latency file.json] [--verbose]
+//
+// On Windows the Kinect is the default source, elsewhere it is the
+// synthetic scene. --rate paces the synthetic scene (30 by default, 0 runs
+// flat out), --realtime plays a session back at its recorded speed.
+// Every --stats seconds the frame rate, CPU use and per-stage latency are
+// printed, --latency saves the final latency snapshot as JSON.
+//
+// --sensors runs that many Kinects or synthetic scenes at once, each on
+// its own pipeline and core, and every --session given adds one more
+// recorded sensor. Results from all of them go to the one telemetry
+// connection, with several sensors the latency snapshots are saved per
+// sensor as file.0.json, file.1.json and so on.
+//
+// --gate only reclassifies tiles of that size that changed since the last
+// frame, --gate-threshold lets noisy tiles count as unchanged.
+// --predict sets how far past the frame the filtered target is predicted,
+// about what the latency stats give for the frame to reach the robot.
+//
+// Nothing but the Kinect source is Windows specific, on Linux it builds with
+//   g++ -std=c++11 -O2 -pthread -ITrackerCore TrackerCore/*.cpp Headless/*.cpp -lrt
+// leaving out TrackerCore/dllmain.cpp and TrackerCore/stdafx.cpp.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <thread>
+#include <chrono>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "KinectSource.h"
+#else
+#include <sys/resource.h>
+#endif
+
+#include "Timing.h"
+#include "WorkerPool.h"
+#include "TrackingPipeline.h"
+#include "MultiPipeline.h"
+#include "SessionFile.h"
+#include "SyntheticScene.h"
+#include "Telemetry.h"
+
+// Frames between checks of the stats timer
+#define STATS_CHUNK 15
+
+static TrackingPipeline* runningPipeline = NULL;
+static MultiPipeline* runningPipelines = NULL;
+
+static void onInterrupt(int)
+{
+	if( runningPipeline )
+		runningPipeline->stop();
+	if( runningPipelines )
+		runningPipelines->stop();
+}
+
+// User and kernel time the process has used so far
+static double getProcessCpuSeconds(void)
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if( !GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user) )
+		return 0.0;
+	ULARGE_INTEGER kernelTime, userTime;
+	kernelTime.LowPart = kernel.dwLowDateTime;
+	kernelTime.HighPart = kernel.dwHighDateTime;
+	userTime.LowPart = user.dwLowDateTime;
+	userTime.HighPart = user.dwHighDateTime;
+	return (kernelTime.QuadPart + userTime.QuadPart) * 1e-7;
+#else
+	struct rusage usage;
+	if( getrusage(RUSAGE_SELF, &usage) != 0 )
+		return 0.0;
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+// Holds a source back to a fixed frame rate, the way a sensor would deliver it
+class PacedSource : public FrameSource
+{
+public:
+	PacedSource(void) : inner(NULL), interval(0.0), start(-1.0) {}
+
+	void pace(FrameSource* source, double rate)
+	{
+		inner = source;
+		interval = rate > 0.0 ? 1.0 / rate : 0.0;
+		start = -1.0;
+	}
+
+	bool nextFrame(Frame* frame)
+	{
+		if( !inner->nextFrame(frame) )
+			return false;
+		if( interval > 0.0 )
+		{
+			if( start < 0.0 )
+				start = getTimeSeconds();
+			double wait = start + frame->index * interval - getTimeSeconds();
+			if( wait > 0.0 )
+				std::this_thread::sleep_for(std::chrono::microseconds((long long)(wait * 1e6)));
+		}
+		return true;
+	}
+
+	bool rewind(void)
+	{
+		start = -1.0;
+		return inner->rewind();
+	}
+
+private:
+	FrameSource* inner;
+	double interval;
+	double start;
+};
+
+// Latency snapshot path for one of several sensors, file.json becomes file.<sensor>.json
+static void sensorLatencyPath(const char* path, int sensor, char* out, size_t size)
+{
+	const char* extension = strrchr(path, '.');
+	if( !extension || strchr(extension, '/') || strchr(extension, '\\') )
+		extension = path + strlen(path);
+#ifdef _WIN32
+	sprintf_s(out, size, "%.*s.%d%s", (int)(extension - path), path, sensor, extension);
+#else
+	snprintf(out, size, "%.*s.%d%s", (int)(extension - path), path, sensor, extension);
+#endif
+}
+
+// Runs several sensors at once and prints the same stats as for one, per
+// sensor and in total, until every source runs dry or the run is interrupted
+static void runSensors(MultiPipeline& pipelines, TelemetrySink* sink, uint32_t maxFrames, double statsInterval)
+{
+	int sensors = pipelines.sensorCount();
+	// The telemetry takes results from several threads at once, so every
+	// sensor hands it over directly instead of queueing behind the others
+	TelemetrySink* sinks[MULTI_PIPELINE_MAX_SENSORS];
+	for( int i = 0; i < sensors; i++ )
+		sinks[i] = sink;
+	pipelines.startPerSensor(sinks, maxFrames);
+	runningPipelines = &pipelines;
+
+	double start = getTimeSeconds();
+	double cpuStart = getProcessCpuSeconds();
+	double lastStats = start, lastCpu = cpuStart;
+	uint32_t lastProcessed[MULTI_PIPELINE_MAX_SENSORS] = { 0 };
+	TrackingResult results[64];
+	for( ;; )
+	{
+		// The merged stream is only drained here, the sink already has every result
+		bool finished = !pipelines.running();
+		while( pipelines.read(results, 64, 0.25) == 64 )
+			;
+
+		double now = getTimeSeconds();
+		if( statsInterval > 0.0 && (now - lastStats >= statsInterval || finished) && now > lastStats )
+		{
+			double cpu = getProcessCpuSeconds();
+			uint32_t total = 0, lastTotal = 0;
+			for( int i = 0; i < sensors; i++ )
+			{
+				uint32_t processed = pipelines.processed(i);
+				printf("sensor %d: %u frames  %.1f fps%s", i, processed, (processed - lastProcessed[i]) / (now - lastStats),
+					   i + 1 < sensors ? "  " : "\n");
+				total += processed;
+				lastTotal += lastProcessed[i];
+				lastProcessed[i] = processed;
+			}
+			printf("all: %u frames  %.1f fps  cpu %.1f%%\n", total, (total - lastTotal) / (now - lastStats),
+				   (cpu - lastCpu) / (now - lastStats) * 100.0);
+			lastStats = now;
+			lastCpu = cpu;
+		}
+		if( finished )
+			break;
+	}
+	uint64_t processed = pipelines.wait();
+	runningPipelines = NULL;
+
+	double elapsed = getTimeSeconds() - start;
+	double cpu = getProcessCpuSeconds() - cpuStart;
+	printf("\n%llu frames from %d sensors in %.1f s, %.1f fps, cpu %.1f%% of one core (%.3f ms per frame)\n",
+		   (unsigned long long)processed, sensors, elapsed, elapsed > 0.0 ? processed / elapsed : 0.0,
+		   elapsed > 0.0 ? cpu / elapsed * 100.0 : 0.0, processed ? cpu / processed * 1e3 : 0.0);
+	for( int i = 0; i < sensors; i++ )
+		printf("sensor %d on core %d\n", i, pipelines.core(i));
+}
+
+int main(int argc, char* argv[])
+{
+	const char* sessionPaths[MULTI_PIPELINE_MAX_SENSORS];
+	int sessionCount = 0;
+	int sensors = 1;
+	bool synthetic = false;
+	uint32_t maxFrames = 0;
+	double rate = 30.0;
+	bool realTime = false;
+	const char* host = "localhost";
+	int port = 13000;
+	bool telemetry = true;
+	bool verbose = false;
+	double statsInterval = 5.0;
+	const char* latencyPath = NULL;
+	TrackingPipelineConfig config;
+	getDefaultTrackingPipelineConfig(&config);
+
+	for( int i = 1; i < argc; i++ )
+	{
+		bool hasValue = i + 1 < argc;
+		if( !strcmp(argv[i], "--session") && hasValue )
+		{
+			if( sessionCount == MULTI_PIPELINE_MAX_SENSORS )
+			{
+				printf("at most %d sessions\n", MULTI_PIPELINE_MAX_SENSORS);
+				return 2;
+			}
+			sessionPaths[sessionCount++] = argv[++i];
+		}
+		else if( !strcmp(argv[i], "--sensors") && hasValue )
+			sensors = atoi(argv[++i]);
+		else if( !strcmp(argv[i], "--synthetic") )
+			synthetic = true;
+		else if( !strcmp(argv[i], "--frames") && hasValue )
+			maxFrames = (uint32_t)atoi(argv[++i]);
+		else if( !strcmp(argv[i], "--rate") && hasValue )
+			rate = atof(argv[++i]);
+		else if( !strcmp(argv[i], "--realtime") )
+			realTime = true;
+		else if( !strcmp(argv[i], "--host") && hasValue )
+			host = argv[++i];
+		else if( !strcmp(argv[i], "--port") && hasValue )
+			port = atoi(argv[++i]);
+		else if( !strcmp(argv[i], "--no-telemetry") )
+			telemetry = false;
+		else if( !strcmp(argv[i], "--no-filter") )
+			config.filterDepth = false;
+		else if( !strcmp(argv[i], "--no-ground") )
+			config.estimateGround = false;
+		else if( !strcmp(argv[i], "--no-grid") )
+			config.buildGrid = false;
+		else if( !strcmp(argv[i], "--no-localize") )
+			config.localizeTarget = false;
+		else if( !strcmp(argv[i], "--gate") && hasValue )
+			config.gateTileSize = atoi(argv[++i]);
+		else if( !strcmp(argv[i], "--gate-threshold") && hasValue )
+			config.gateThreshold = atoi(argv[++i]);
+		else if( !strcmp(argv[i], "--no-target-filter") )
+			config.filterTarget = false;
+		else if( !strcmp(argv[i], "--predict") && hasValue )
+			config.predictAhead = atof(argv[++i]);
+		else if( !strcmp(argv[i], "--stats") && hasValue )
+			statsInterval = atof(argv[++i]);
+		else if( !strcmp(argv[i], "--latency") && hasValue )
+			latencyPath = argv[++i];
+		else if( !strcmp(argv[i], "--verbose") )
+			verbose = true;
+		else
+		{
+			printf("unknown option %s\n", argv[i]);
+			return 2;
+		}
+	}
+#ifndef _WIN32
+	if( !sessionCount )
+		synthetic = true;
+#endif
+	if( sessionCount )
+		sensors = sessionCount;
+	// The synthetic scene draws its depth straight into the color camera
+	if( synthetic && !sessionCount )
+		config.depthRegistered = true;
+	if( sensors < 1 || sensors > MULTI_PIPELINE_MAX_SENSORS )
+	{
+		printf("--sensors takes 1 to %d\n", MULTI_PIPELINE_MAX_SENSORS);
+		return 2;
+	}
+
+	// Pick the sources
+	FrameSource* sources[MULTI_PIPELINE_MAX_SENSORS];
+	SessionPlayback playback[MULTI_PIPELINE_MAX_SENSORS];
+	SyntheticScene scenes[MULTI_PIPELINE_MAX_SENSORS];
+	PacedSource pacedScenes[MULTI_PIPELINE_MAX_SENSORS];
+#ifdef _WIN32
+	KinectSource kinects[MULTI_PIPELINE_MAX_SENSORS];
+#endif
+	for( int i = 0; i < sensors; i++ )
+	{
+		if( sessionCount )
+		{
+			if( !playback[i].open(sessionPaths[i]) )
+			{
+				printf("cannot play back %s\n", sessionPaths[i]);
+				return 1;
+			}
+			playback[i].setRealTime(realTime);
+			sources[i] = &playback[i];
+			printf("playing back %s, %u frames\n", sessionPaths[i], playback[i].frameCount());
+		}
+		else if( synthetic )
+		{
+			// Each sensor sees its own scene
+			SyntheticSceneConfig sceneConfig;
+			getDefaultSyntheticSceneConfig(&sceneConfig);
+			sceneConfig.seed += i * 7919;
+			scenes[i].initialize(sceneConfig);
+			pacedScenes[i].pace(&scenes[i], rate);
+			sources[i] = &pacedScenes[i];
+			printf("synthetic scene at %s\n", rate > 0.0 ? "a fixed rate" : "full speed");
+		}
+#ifdef _WIN32
+		else
+		{
+			if( FAILED(kinects[i].open(i)) )
+			{
+				printf(i ? "only %d Kinects found\n" : "no Kinect found\n", i);
+				return 1;
+			}
+			sources[i] = &kinects[i];
+			printf("tracking from Kinect %d\n", i);
+		}
+#endif
+	}
+	TcpTelemetry sink(host, port, verbose);
+	signal(SIGINT, onInterrupt);
+
+	if( sensors > 1 )
+	{
+		MultiPipeline pipelines;
+		if( !pipelines.initialize(sources, sensors, config) )
+			return 1;
+		runSensors(pipelines, telemetry ? &sink : NULL, maxFrames, statsInterval);
+#ifdef _WIN32
+		for( int i = 0; i < sensors; i++ )
+			if( sources[i] == &kinects[i] )
+				printf("%u color frames dropped by Kinect %d\n", kinects[i].droppedFrames(), i);
+#endif
+		if( telemetry )
+			printf("telemetry: %llu alerts sent, %llu could not be sent\n", (unsigned long long)sink.sent(),
+				   (unsigned long long)sink.failed());
+		for( int i = 0; i < sensors; i++ )
+		{
+			printf("sensor %d ", i);
+			pipelines.pipeline(i).latency().writeText(stdout);
+			if( latencyPath )
+			{
+				char path[1024];
+				sensorLatencyPath(latencyPath, i, path, sizeof(path));
+				pipelines.pipeline(i).latency().saveJson(path);
+			}
+		}
+		return 0;
+	}
+
+	FrameSource* source = sources[0];
+	WorkerPool pool;
+	TrackingPipeline pipeline;
+	if( !pipeline.initialize(config, 640, 480, &pool) )
+		return 1;
+
+	runningPipeline = &pipeline;
+
+	double start = getTimeSeconds();
+	double cpuStart = getProcessCpuSeconds();
+	double lastStats = start, lastCpu = cpuStart;
+	uint32_t processed = 0, lastProcessed = 0;
+	for( ;; )
+	{
+		uint32_t chunk = STATS_CHUNK;
+		if( maxFrames && maxFrames - processed < chunk )
+			chunk = maxFrames - processed;
+		uint32_t done = pipeline.run(source, telemetry ? &sink : NULL, chunk);
+		processed += done;
+
+		double now = getTimeSeconds();
+		bool finished = done < chunk || (maxFrames && processed >= maxFrames);
+		if( statsInterval > 0.0 && (now - lastStats >= statsInterval || finished) && now > lastStats )
+		{
+			double cpu = getProcessCpuSeconds();
+			printf("%u frames  %.1f fps  cpu %.1f%%\n", processed, (processed - lastProcessed) / (now - lastStats),
+				   (cpu - lastCpu) / (now - lastStats) * 100.0);
+			lastStats = now;
+			lastCpu = cpu;
+			lastProcessed = processed;
+		}
+		if( finished )
+			break;
+	}
+	runningPipeline = NULL;
+
+	double elapsed = getTimeSeconds() - start;
+	double cpu = getProcessCpuSeconds() - cpuStart;
+	printf("\n%u frames in %.1f s, %.1f fps, cpu %.1f%% of one core (%.3f ms per frame)\n", processed, elapsed,
+		   elapsed > 0.0 ? processed / elapsed : 0.0, elapsed > 0.0 ? cpu / elapsed * 100.0 : 0.0,
+		   processed ? cpu / processed * 1e3 : 0.0);
+#ifdef _WIN32
+	if( source == &kinects[0] )
+		printf("%u color frames dropped by the sensor\n", kinects[0].droppedFrames());
+#endif
+	if( telemetry )
+		printf("telemetry: %llu alerts sent, %llu could not be sent\n", (unsigned long long)sink.sent(),
+			   (unsigned long long)sink.failed());
+	pipeline.latency().writeText(stdout);
+	if( latencyPath )
+		pipeline.latency().saveJson(latencyPath);
+	return 0;
+}
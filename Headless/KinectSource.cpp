@@ -0,0 +1,136 @@
+#ifdef _WIN32
+
+#include "KinectSource.h"
+#include "Timing.h"
+
+#include <string.h>
+
+#define KINECT_WIDTH 640
+#define KINECT_HEIGHT 480
+// How long nextFrame waits for the sensor before giving up on it
+#define KINECT_FRAME_TIMEOUT 2000
+
+KinectSource::KinectSource()
+{
+	sensor = NULL;
+	colorEvent = depthEvent = NULL;
+	colorStream = depthStream = NULL;
+	color = new uint8_t[KINECT_WIDTH * KINECT_HEIGHT * 4];
+	depth = new uint16_t[KINECT_WIDTH * KINECT_HEIGHT];
+	haveDepth = false;
+	colorTimestamp = depthTimestamp = 0.0;
+	frames = 0;
+	lastFrameNumber = 0;
+	dropped = 0;
+	return;
+}
+
+KinectSource::~KinectSource()
+{
+	if( sensor )
+	{
+		sensor->NuiShutdown();
+		sensor->Release();
+	}
+	if( colorEvent )
+		CloseHandle(colorEvent);
+	if( depthEvent )
+		CloseHandle(depthEvent);
+	delete[] color;
+	delete[] depth;
+	return;
+}
+
+HRESULT KinectSource::open(int which)
+{
+	int sensorCount = 0;
+	HRESULT hr = NuiGetSensorCount(&sensorCount);
+	if( FAILED(hr) )
+		return hr;
+
+	// Sensors that are not ready are skipped, so with which 0 this is the
+	// viewer's choice, the first sensor whose status is OK
+	for( int i = 0; i < sensorCount && !sensor; i++ )
+	{
+		INuiSensor* candidate = NULL;
+		if( FAILED(NuiCreateSensorByIndex(i, &candidate)) )
+			continue;
+		if( candidate->NuiStatus() == S_OK && which-- == 0 )
+			sensor = candidate;
+		else
+			candidate->Release();
+	}
+	if( !sensor )
+		return E_FAIL;
+
+	hr = sensor->NuiInitialize(NUI_INITIALIZE_FLAG_USES_COLOR | NUI_INITIALIZE_FLAG_USES_DEPTH_AND_PLAYER_INDEX);
+	if( FAILED(hr) )
+		return hr;
+
+	depthEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	hr = sensor->NuiImageStreamOpen(NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX, NUI_IMAGE_RESOLUTION_640x480,
+									0, 2, depthEvent, &depthStream);
+	if( FAILED(hr) )
+		return hr;
+
+	colorEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	return sensor->NuiImageStreamOpen(NUI_IMAGE_TYPE_COLOR, NUI_IMAGE_RESOLUTION_640x480,
+									  0, 2, colorEvent, &colorStream);
+}
+
+HRESULT KinectSource::grab(HANDLE stream, void* buffer, size_t size, NUI_IMAGE_FRAME* imageFrame)
+{
+	HRESULT hr = sensor->NuiImageStreamGetNextFrame(stream, 0, imageFrame);
+	if( FAILED(hr) )
+		return hr;
+
+	NUI_LOCKED_RECT lockedRect;
+	hr = imageFrame->pFrameTexture->LockRect(0, &lockedRect, NULL, 0);
+	if( SUCCEEDED(hr) )
+	{
+		memcpy(buffer, lockedRect.pBits, (size_t)lockedRect.size < size ? lockedRect.size : size);
+		imageFrame->pFrameTexture->UnlockRect(0);
+	}
+	sensor->NuiImageStreamReleaseFrame(stream, imageFrame);
+	return hr;
+}
+
+bool KinectSource::nextFrame(Frame* frame)
+{
+	if( !sensor || !colorStream )
+		return false;
+
+	NUI_IMAGE_FRAME imageFrame;
+	for( ;; )
+	{
+		if( WaitForSingleObject(colorEvent, KINECT_FRAME_TIMEOUT) != WAIT_OBJECT_0 )
+			return false;
+		if( SUCCEEDED(grab(colorStream, color, KINECT_WIDTH * KINECT_HEIGHT * 4, &imageFrame)) )
+			break;
+	}
+	colorTimestamp = getTimeSeconds();
+	if( frames && imageFrame.dwFrameNumber > lastFrameNumber + 1 )
+		dropped += imageFrame.dwFrameNumber - lastFrameNumber - 1;
+	lastFrameNumber = imageFrame.dwFrameNumber;
+
+	if( WaitForSingleObject(depthEvent, 0) == WAIT_OBJECT_0 &&
+		SUCCEEDED(grab(depthStream, depth, KINECT_WIDTH * KINECT_HEIGHT * sizeof(uint16_t), &imageFrame)) )
+	{
+		haveDepth = true;
+		depthTimestamp = getTimeSeconds();
+	}
+
+	frame->color = color;
+	frame->colorPitch = KINECT_WIDTH * 4;
+	frame->colorWidth = KINECT_WIDTH;
+	frame->colorHeight = KINECT_HEIGHT;
+	frame->colorTimestamp = colorTimestamp;
+	frame->depth = haveDepth ? depth : NULL;
+	frame->depthWidth = KINECT_WIDTH;
+	frame->depthHeight = KINECT_HEIGHT;
+	frame->depthTimestamp = depthTimestamp;
+	frame->index = frames++;
+	return true;
+}
+
+#endif
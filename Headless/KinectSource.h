@@ -0,0 +1,48 @@
+#pragma once
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include "NuiApi.h"
+#include "FrameSource.h"
+
+// Frames from one Kinect, the first that reports in unless told otherwise. nextFrame waits for the
+// next color frame and pairs it with the latest depth frame, both are copied
+// out of the sensor buffers so they can go straight back to the driver.
+class KinectSource : public FrameSource
+{
+public:
+	KinectSource(void);
+	~KinectSource(void);
+
+	// Opens the Kinect that comes which'th among those whose status is OK, from zero
+	HRESULT open(int which = 0);
+	bool nextFrame(Frame* frame);
+
+	// Color frames the sensor numbered that never came through nextFrame
+	uint32_t droppedFrames(void) const { return dropped; }
+
+private:
+	INuiSensor* sensor;
+	HANDLE colorEvent;
+	HANDLE depthEvent;
+	HANDLE colorStream;
+	HANDLE depthStream;
+
+	uint8_t* color;
+	uint16_t* depth;
+	bool haveDepth;
+	double colorTimestamp;
+	double depthTimestamp;
+	uint32_t frames;
+	DWORD lastFrameNumber;
+	uint32_t dropped;
+
+	HRESULT grab(HANDLE stream, void* buffer, size_t size, NUI_IMAGE_FRAME* imageFrame);
+
+	KinectSource(const KinectSource&);
+	KinectSource& operator=(const KinectSource&);
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "Telemetry.h"
+#include "Timing.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET Socket;
+#define closeSocket closesocket
+#define SEND_FLAGS 0
+#else
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+typedef int Socket;
+#define INVALID_SOCKET (-1)
+#define closeSocket close
+#define SEND_FLAGS MSG_NOSIGNAL
+#define sprintf_s snprintf
+#endif
+
+#define NOT_CONNECTED ((intptr_t)INVALID_SOCKET)
+#define RECONNECT_INTERVAL 1.0
+
+static const char alertCommand[] = "Hello Labview";
+
+TcpTelemetry::TcpTelemetry(const char* hostName, int port, bool printResults)
+{
+#ifdef _WIN32
+	WSADATA wsaData;
+	WSAStartup(MAKEWORD(2, 2), &wsaData);
+	strncpy_s(host, sizeof(host), hostName, _TRUNCATE);
+	sprintf_s(service, sizeof(service), "%d", port);
+#else
+	snprintf(host, sizeof(host), "%s", hostName);
+	snprintf(service, sizeof(service), "%d", port);
+#endif
+	verbose = printResults;
+	messagesSent = messagesFailed = 0;
+	pendingAlerts = 0;
+	stopping = false;
+	connection = NOT_CONNECTED;
+	lastAttempt = -RECONNECT_INTERVAL;
+	sender = std::thread(&TcpTelemetry::senderMain, this);
+	return;
+}
+
+TcpTelemetry::~TcpTelemetry()
+{
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	wake.notify_one();
+	sender.join();
+	disconnect();
+#ifdef _WIN32
+	WSACleanup();
+#endif
+	return;
+}
+
+bool TcpTelemetry::connect(void)
+{
+	if( connection != NOT_CONNECTED )
+		return true;
+	double now = getTimeSeconds();
+	if( now - lastAttempt < RECONNECT_INTERVAL )
+		return false;
+	lastAttempt = now;
+
+	struct addrinfo hints, *addresses = NULL;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+	if( getaddrinfo(host, service, &hints, &addresses) != 0 )
+		return false;
+
+	for( struct addrinfo* address = addresses; address; address = address->ai_next )
+	{
+		Socket candidate = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if( candidate == INVALID_SOCKET )
+			continue;
+		if( ::connect(candidate, address->ai_addr, (int)address->ai_addrlen) == 0 )
+		{
+			connection = (intptr_t)candidate;
+			break;
+		}
+		closeSocket(candidate);
+	}
+	freeaddrinfo(addresses);
+	return connection != NOT_CONNECTED;
+}
+
+void TcpTelemetry::disconnect(void)
+{
+	if( connection == NOT_CONNECTED )
+		return;
+	closeSocket((Socket)connection);
+	connection = NOT_CONNECTED;
+}
+
+// Takes whatever alerts piled up since it last looked and sends them, a
+// connect that blocks for the OS timeout only holds up this thread
+void TcpTelemetry::senderMain(void)
+{
+	for( ;; )
+	{
+		uint32_t alerts;
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			while( !pendingAlerts && !stopping )
+				wake.wait(guard);
+			if( stopping )
+				return;
+			alerts = pendingAlerts;
+			pendingAlerts = 0;
+		}
+
+		for( ; alerts; alerts-- )
+		{
+			if( !connect() )
+				break;
+			int length = (int)strlen(alertCommand);
+			if( send((Socket)connection, alertCommand, length, SEND_FLAGS) != length )
+			{
+				disconnect();
+				break;
+			}
+			messagesSent++;
+		}
+		messagesFailed += alerts;
+	}
+}
+
+void TcpTelemetry::publish(const TrackingResult& result)
+{
+	if( verbose && (result.found || result.newDepth) )
+	{
+		char location[64] = "";
+		if( result.located )
+			sprintf_s(location, sizeof(location), "  at %.2f %.2f %.2f m", result.location.x, result.location.y,
+					  result.location.z);
+		printf("sensor %d frame %u  target %s %d %d  area %d  axes %.1f %.1f  predicted %.1f %.1f%s  center %d mm"
+			   "  obstacles %d  craters %d%s\n",
+			   result.sensor, result.frame, result.found ? "at" : "lost", result.target.x, result.target.y,
+			   result.shape.area, result.shape.majorAxis, result.shape.minorAxis, result.predictedX, result.predictedY,
+			   location, result.centerRange, result.obstacleCells, result.craterCells, result.alert ? "  ALERT" : "");
+	}
+
+	if( !result.alert || !result.newDepth )
+		return;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		pendingAlerts++;
+	}
+	wake.notify_one();
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "TrackingPipeline.h"
+
+// Sends the depth alert to the LabVIEW side over TCP, the same command the
+// viewer's SendMessager sends, but on one connection that is kept open
+// instead of a new one per alert. Looking up the host, connecting and
+// sending happen on a thread of its own: publish() only counts the alert
+// and wakes it, so the pipeline never waits on the network. A refused or
+// broken connection is retried at most once a second, alerts that come in
+// while there is no connection are counted as failed. Several pipelines may
+// publish at once.
+class TcpTelemetry : public TelemetrySink
+{
+public:
+	TcpTelemetry(const char* host, int port, bool verbose);
+	~TcpTelemetry(void);
+
+	void publish(const TrackingResult& result);
+
+	// Safe from any thread
+	uint64_t sent(void) const { return messagesSent; }
+	uint64_t failed(void) const { return messagesFailed; }
+
+private:
+	char host[256];
+	char service[16];
+	bool verbose;
+	std::atomic<uint64_t> messagesSent;
+	std::atomic<uint64_t> messagesFailed;
+
+	// Alerts published but not yet taken by the sender
+	std::mutex lock;
+	std::condition_variable wake;
+	uint32_t pendingAlerts;
+	bool stopping;
+
+	// Only touched by the sender thread
+	intptr_t connection;
+	double lastAttempt;
+	std::thread sender;
+
+	void senderMain(void);
+	bool connect(void);
+	void disconnect(void);
+
+	TcpTelemetry(const TcpTelemetry&);
+	TcpTelemetry& operator=(const TcpTelemetry&);
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+// Minimal checking for the Tests tool. A failed check prints where it is
+// and what was expected and the run carries on, main() exits with 1 if
+// anything failed.
+
+#include <stdio.h>
+#include <math.h>
+
+void checkFailed(const char* file, int line, const char* text);
+void checkFailedNear(const char* file, int line, const char* text, double value, double expected, double tolerance);
+
+#define CHECK(condition) \
+	do { if( !(condition) ) checkFailed(__FILE__, __LINE__, #condition); } while( 0 )
+
+// Passes when |value - expected| <= tolerance
+#define CHECK_NEAR(value, expected, tolerance) \
+	do { \
+		double checkValue = (double)(value), checkExpected = (double)(expected), checkTolerance = (double)(tolerance); \
+		if( !(fabs(checkValue - checkExpected) <= checkTolerance) ) \
+			checkFailedNear(__FILE__, __LINE__, #value, checkValue, checkExpected, checkTolerance); \
+	} while( 0 )
+
+// One suite per module, each lives in its own Test*.cpp
+void testRegistration(void);
+void testLocalization(void);
+void testTrackingPipeline(void);
+void testDepthCodec(void);
+void testSessionFile(void);
+void testTrackerCoreC(void);
+void testDisplayMailbox(void);
+void testMotionGating(void);
+void testTargetFilter(void);
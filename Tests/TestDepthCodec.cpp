@@ -0,0 +1,225 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "Check.h"
+#include "DepthCodec.h"
+#include "Registration.h"
+
+#define WIDTH 64
+#define HEIGHT 48
+#define PIXELS (WIDTH * HEIGHT)
+
+static uint32_t seed = 12345;
+
+static uint32_t nextRandom(void)
+{
+	seed = seed * 1664525 + 1013904223;
+	return seed >> 8;
+}
+
+static bool roundTrips(const uint16_t* depth, int width, int height)
+{
+	size_t capacity = depthCodecMaxEncodedSize(width, height);
+	uint8_t* encoded = new uint8_t[capacity];
+	uint16_t* decoded = new uint16_t[width * height];
+
+	size_t size = encodeDepthFrame(depth, width, height, encoded, capacity);
+	bool same = size > 0 && decodeDepthFrame(encoded, size, decoded, width, height) &&
+				!memcmp(depth, decoded, width * height * sizeof(uint16_t));
+
+	delete[] encoded;
+	delete[] decoded;
+	return same;
+}
+
+// Floor ramp with a box, noise, dropouts in clumps and whole rows of holes,
+// so runs cross row starts with and without a reading above
+static void fillFrame(uint16_t* depth, int noise, bool players)
+{
+	for( int y = 0; y < HEIGHT; y++ )
+		for( int x = 0; x < WIDTH; x++ )
+		{
+			int mm = 800 + y * 40;
+			if( x > 20 && x < 40 && y > 10 && y < 30 )
+				mm = 1300;
+			if( noise )
+				mm += (int)(nextRandom() % (2 * noise + 1)) - noise;
+			if( (nextRandom() & 63) < 3 || y == 20 || y == 21 || (y == 30 && x > 50) )
+				mm = 0;
+			int player = players && x > 25 && x < 35 ? 1 + (y / 16) : 0;
+			depth[y * WIDTH + x] = (uint16_t)(mm << DEPTH_PLAYER_INDEX_SHIFT | player);
+		}
+}
+
+static void testRoundTrip(void)
+{
+	uint16_t depth[PIXELS];
+
+	fillFrame(depth, 0, false);
+	CHECK(roundTrips(depth, WIDTH, HEIGHT));
+	fillFrame(depth, 3, false);
+	CHECK(roundTrips(depth, WIDTH, HEIGHT));
+	fillFrame(depth, 3, true);
+	CHECK(roundTrips(depth, WIDTH, HEIGHT));
+
+	// Every value the sensor can report, in random order, player bits and all
+	for( int i = 0; i < PIXELS; i++ )
+		depth[i] = (uint16_t)nextRandom();
+	depth[0] = 0xFFFF;
+	depth[1] = 1;
+	depth[2] = 1 << DEPTH_PLAYER_INDEX_SHIFT;
+	CHECK(roundTrips(depth, WIDTH, HEIGHT));
+
+	// Only holes and one pixel wide frames
+	memset(depth, 0, sizeof(depth));
+	CHECK(roundTrips(depth, WIDTH, HEIGHT));
+	fillFrame(depth, 3, true);
+	CHECK(roundTrips(depth, 1, PIXELS));
+
+	// Player bits are split off, so they cost little on top of the depth
+	size_t capacity = depthCodecMaxEncodedSize(WIDTH, HEIGHT);
+	uint8_t* encoded = new uint8_t[capacity];
+	fillFrame(depth, 3, false);
+	size_t plain = encodeDepthFrame(depth, WIDTH, HEIGHT, encoded, capacity);
+	fillFrame(depth, 3, true);
+	size_t withPlayers = encodeDepthFrame(depth, WIDTH, HEIGHT, encoded, capacity);
+	CHECK(withPlayers < plain + plain / 10);
+	CHECK(encodeDepthFrame(depth, WIDTH, HEIGHT, encoded, capacity - 1) == 0);
+	delete[] encoded;
+}
+
+static uint8_t* putVarint(uint8_t* out, uint32_t value)
+{
+	while( value >= 0x80 )
+	{
+		*out++ = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (uint8_t)value;
+	return out;
+}
+
+// Header for a frame, followed by the given tokens
+static size_t buildFrame(uint8_t* out, int width, int height, int shift, int flags, const uint32_t* tokens,
+						 int count)
+{
+	uint8_t* start = out;
+	memcpy(out, "LDC1", 4);
+	out[4] = (uint8_t)width;
+	out[5] = (uint8_t)(width >> 8);
+	out[6] = (uint8_t)height;
+	out[7] = (uint8_t)(height >> 8);
+	out[8] = (uint8_t)shift;
+	out[9] = (uint8_t)flags;
+	out += DEPTH_CODEC_HEADER_SIZE;
+	for( int i = 0; i < count; i++ )
+		out = putVarint(out, tokens[i]);
+	return out - start;
+}
+
+#define RESIDUAL(r) ((((uint32_t)(r) << 1) ^ (uint32_t)((int)(r) >> 31)) << 2)
+#define HOLES(n) ((((uint32_t)(n) - 1) << 2) | 1)
+#define REPEAT(n) ((((uint32_t)(n) - 1) << 2) | 2)
+
+static void testHandBuilt(void)
+{
+	uint8_t encoded[64];
+	uint16_t depth[4];
+
+	// Frames written before the player index stream, with a shift of zero
+	// whenever a pixel had player bits, still decode. The row start takes
+	// the reading above.
+	const uint32_t older[] = { RESIDUAL(1001), REPEAT(1), RESIDUAL(1), HOLES(1) };
+	size_t size = buildFrame(encoded, 2, 2, 0, 0, older, 4);
+	CHECK(decodeDepthFrame(encoded, size, depth, 2, 2));
+	CHECK(depth[0] == 1001 && depth[1] == 1001 && depth[2] == 1002 && depth[3] == 0);
+
+	// A hole at the start of a row leaves the prediction where it was
+	uint16_t rows[6];
+	const uint32_t shifted[] = { RESIDUAL(1000), RESIDUAL(200), HOLES(2), RESIDUAL(5), HOLES(1) };
+	size = buildFrame(encoded, 3, 2, DEPTH_PLAYER_INDEX_SHIFT, 0, shifted, 5);
+	CHECK(decodeDepthFrame(encoded, size, rows, 3, 2));
+	CHECK(rows[0] == 1000 << 3 && rows[1] == 1200 << 3 && rows[2] == 0 && rows[3] == 0 && rows[4] == 1205 << 3);
+
+	// Player runs go on top of the depth, holes included
+	const uint32_t players[] = { RESIDUAL(1000), HOLES(3), 2 << 3 | 2, 0 };
+	size = buildFrame(encoded, 2, 2, DEPTH_PLAYER_INDEX_SHIFT, 1, players, 4);
+	CHECK(decodeDepthFrame(encoded, size, depth, 2, 2));
+	CHECK(depth[0] == (1000 << 3 | 2) && depth[1] == 2 && depth[2] == 2 && depth[3] == 0);
+}
+
+static void testCorrupt(void)
+{
+	uint8_t encoded[64];
+	uint16_t depth[4];
+
+	// Residuals that would overflow or leave the 16 bit range
+	const uint32_t hugeDown[] = { RESIDUAL(1000), 0xFFFFFFFC, HOLES(2) };
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, 0, 0, hugeDown, 3), depth, 2, 2));
+	const uint32_t hugeUp[] = { RESIDUAL(1000), 0xFFFFFFF8, HOLES(2) };
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, 0, 0, hugeUp, 3), depth, 2, 2));
+	const uint32_t tooFar[] = { RESIDUAL(0x2000), HOLES(3) };
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, DEPTH_PLAYER_INDEX_SHIFT, 0, tooFar, 2), depth, 2, 2));
+	const uint32_t negative[] = { RESIDUAL(-1), HOLES(3) };
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, 0, 0, negative, 2), depth, 2, 2));
+
+	// Runs past the end, a repeat with nothing to repeat, an unknown token
+	const uint32_t longRun[] = { HOLES(5) };
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, 0, 0, longRun, 1), depth, 2, 2));
+	const uint32_t nothing[] = { REPEAT(4) };
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, 0, 0, nothing, 1), depth, 2, 2));
+	const uint32_t unknown[] = { 3, HOLES(3) };
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, 0, 0, unknown, 2), depth, 2, 2));
+
+	// Bad header fields and player runs that do not cover the frame exactly
+	const uint32_t holes[] = { HOLES(4) };
+	CHECK(decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, 0, 0, holes, 1), depth, 2, 2));
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, 1, 0, holes, 1), depth, 2, 2));
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, 0, 2, holes, 1), depth, 2, 2));
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, 0, 1, holes, 1), depth, 2, 2));
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, 0, 0, holes, 1), depth, 2, 1));
+	const uint32_t overrun[] = { HOLES(4), 3 << 3 | 1, 0 };
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, DEPTH_PLAYER_INDEX_SHIFT, 1, overrun, 3), depth, 2, 2));
+	const uint32_t partial[] = { HOLES(4), 2 << 3 | 1 };
+	CHECK(!decodeDepthFrame(encoded, buildFrame(encoded, 2, 2, DEPTH_PLAYER_INDEX_SHIFT, 1, partial, 2), depth, 2, 2));
+	encoded[0] = 'X';
+	CHECK(!decodeDepthFrame(encoded, DEPTH_CODEC_HEADER_SIZE + 1, depth, 2, 2));
+	CHECK(!decodeDepthFrame(encoded, 3, depth, 2, 2));
+
+	// Every cut short frame and one with a byte too many are refused
+	uint16_t frame[PIXELS], decoded[PIXELS];
+	fillFrame(frame, 3, true);
+	size_t capacity = depthCodecMaxEncodedSize(WIDTH, HEIGHT);
+	uint8_t* valid = new uint8_t[capacity + 1];
+	size_t size = encodeDepthFrame(frame, WIDTH, HEIGHT, valid, capacity);
+	int accepted = 0;
+	for( size_t cut = 0; cut < size; cut++ )
+		accepted += decodeDepthFrame(valid, cut, decoded, WIDTH, HEIGHT);
+	CHECK(accepted == 0);
+	valid[size] = 0;
+	CHECK(!decodeDepthFrame(valid, size + 1, decoded, WIDTH, HEIGHT));
+
+	// Flipped bits and random garbage must come back as a failure or a
+	// frame, never a crash
+	uint8_t* damaged = new uint8_t[size];
+	for( int i = 0; i < 2000; i++ )
+	{
+		memcpy(damaged, valid, size);
+		damaged[DEPTH_CODEC_HEADER_SIZE + nextRandom() % (size - DEPTH_CODEC_HEADER_SIZE)] ^=
+			(uint8_t)(1 << (nextRandom() & 7));
+		decodeDepthFrame(damaged, size, decoded, WIDTH, HEIGHT);
+
+		for( size_t j = DEPTH_CODEC_HEADER_SIZE; j < size; j++ )
+			damaged[j] = (uint8_t)nextRandom();
+		decodeDepthFrame(damaged, size, decoded, WIDTH, HEIGHT);
+	}
+	delete[] damaged;
+	delete[] valid;
+}
+
+void testDepthCodec(void)
+{
+	testRoundTrip();
+	testHandBuilt();
+	testCorrupt();
+}
@@ -0,0 +1,129 @@
+#include <stdint.h>
+#include <atomic>
+#include <thread>
+
+#include "Check.h"
+#include "DisplayMailbox.h"
+
+// Against a made up clock, so the answers do not depend on the machine
+static void testRateLimiter(void)
+{
+	RateLimiter limiter(10.0);
+	int allowed = 0;
+	for( int step = 0; step < 1000; step++ )
+		allowed += limiter.ready(step * 0.001);
+	CHECK(allowed == 10);
+
+	// A display that stalled picks up from now instead of bursting
+	RateLimiter stalled(10.0);
+	CHECK(stalled.ready(0.0));
+	CHECK(stalled.ready(1.0));
+	CHECK(!stalled.ready(1.001));
+	CHECK(!stalled.ready(1.05));
+	CHECK_NEAR(stalled.wait(1.05), 0.05, 1e-9);
+	CHECK(stalled.ready(1.1));
+	CHECK(stalled.wait(1.25) == 0.0);
+
+	RateLimiter unlimited(0.0);
+	CHECK(unlimited.ready(0.0) && unlimited.ready(0.0) && unlimited.wait(0.0) == 0.0);
+}
+
+static void fill(DisplayMailbox& mailbox, uint32_t frame)
+{
+	uint32_t* pixels = (uint32_t*)mailbox.backBuffer();
+	for( int i = 0; i < mailbox.width() * mailbox.height(); i++ )
+		pixels[i] = frame;
+	mailbox.backOverlay()->frame = frame;
+	mailbox.publish();
+}
+
+static bool intact(const DisplayMailbox& mailbox, const uint8_t* pixels, const DisplayOverlay* overlay)
+{
+	for( int i = 0; i < mailbox.width() * mailbox.height(); i++ )
+		if( ((const uint32_t*)pixels)[i] != overlay->frame )
+			return false;
+	return true;
+}
+
+static void testHandOver(void)
+{
+	DisplayMailbox mailbox;
+	const uint8_t* pixels;
+	const DisplayOverlay* overlay;
+	CHECK(!mailbox.acquire(&pixels, &overlay));
+	CHECK(mailbox.initialize(16, 8));
+	CHECK(!mailbox.acquire(&pixels, &overlay));
+
+	fill(mailbox, 1);
+	CHECK(mailbox.acquire(&pixels, &overlay) && overlay->frame == 1 && intact(mailbox, pixels, overlay));
+	CHECK(!mailbox.acquire(&pixels, &overlay));
+
+	// Only the newest frame is shown, the one in between is skipped
+	fill(mailbox, 2);
+	fill(mailbox, 3);
+	CHECK(mailbox.acquire(&pixels, &overlay) && overlay->frame == 3);
+
+	// The frame being shown is left alone however much the producer publishes
+	for( uint32_t frame = 4; frame < 10; frame++ )
+		fill(mailbox, frame);
+	CHECK(overlay->frame == 3 && intact(mailbox, pixels, overlay));
+	CHECK(mailbox.acquire(&pixels, &overlay) && overlay->frame == 9 && intact(mailbox, pixels, overlay));
+
+	CHECK(mailbox.published() == 9);
+	CHECK(mailbox.shown() == 3);
+	CHECK(mailbox.skipped() == 6);
+}
+
+// A producer publishing flat out against a display taking frames as fast as
+// it can. Every pixel carries the frame number so a torn frame shows up.
+static void testThreads(void)
+{
+	const uint32_t frames = 20000;
+	DisplayMailbox mailbox;
+	CHECK(mailbox.initialize(64, 48));
+	std::atomic<bool> done(false);
+
+	std::thread producer([&]()
+	{
+		for( uint32_t frame = 1; frame <= frames; frame++ )
+		{
+			fill(mailbox, frame);
+			if( frame % 64 == 0 )
+				std::this_thread::yield();
+		}
+		done = true;
+	});
+
+	int torn = 0, backwards = 0;
+	uint32_t lastFrame = 0;
+	for( ;; )
+	{
+		bool finished = done;
+		const uint8_t* pixels;
+		const DisplayOverlay* overlay;
+		if( !mailbox.acquire(&pixels, &overlay) )
+		{
+			if( finished )
+				break;
+			std::this_thread::yield();
+			continue;
+		}
+		torn += !intact(mailbox, pixels, overlay);
+		backwards += overlay->frame <= lastFrame;
+		lastFrame = overlay->frame;
+	}
+	producer.join();
+
+	CHECK(torn == 0);
+	CHECK(backwards == 0);
+	CHECK(lastFrame == frames);
+	CHECK(mailbox.published() == frames);
+	CHECK(mailbox.shown() + mailbox.skipped() == frames);
+}
+
+void testDisplayMailbox(void)
+{
+	testRateLimiter();
+	testHandOver();
+	testThreads();
+}
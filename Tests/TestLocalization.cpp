@@ -0,0 +1,191 @@
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+
+#include "Check.h"
+#include "Localization.h"
+#include "TrackingPipeline.h"
+#include "SyntheticScene.h"
+
+typedef struct
+{
+	Point3D center;
+	float radius;
+} Beacon;
+
+// Beacons as discs facing the camera in front of a wall 3m away, with a hole every few pixels
+static void renderBeacons(const CameraIntrinsics& camera, const Beacon* beacons, int count, std::vector<uint16_t>& depth)
+{
+	for( int v = 0; v < camera.height; v++ )
+	{
+		for( int u = 0; u < camera.width; u++ )
+		{
+			float rx = (u - camera.cx) / camera.fx;
+			float ry = (v - camera.cy) / camera.fy;
+			float z = 3.0f;
+			for( int i = 0; i < count; i++ )
+			{
+				float dx = rx * beacons[i].center.z - beacons[i].center.x;
+				float dy = ry * beacons[i].center.z - beacons[i].center.y;
+				if( dx * dx + dy * dy < beacons[i].radius * beacons[i].radius && beacons[i].center.z < z )
+					z = beacons[i].center.z;
+			}
+			int mm = (int)(z * 1000.0f + 0.5f);
+			if( (u * 7 + v * 13) % 11 == 0 )
+				mm = 0;
+			depth[v * camera.width + u] = (uint16_t)(mm << DEPTH_PLAYER_INDEX_SHIFT);
+		}
+	}
+}
+
+static Coordinate project(const CameraIntrinsics& camera, const Point3D& point)
+{
+	Coordinate pixel;
+	pixel.x = (int)(camera.fx * point.x / point.z + camera.cx + 0.5f);
+	pixel.y = (int)(camera.fy * point.y / point.z + camera.cy + 0.5f);
+	return pixel;
+}
+
+static float distance(const Point3D& a, const Point3D& b)
+{
+	float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+static void testBeacons(void)
+{
+	CameraIntrinsics depthIntrinsics, camera;
+	CameraExtrinsics extrinsics;
+	getKinectDefaultCalibration(&depthIntrinsics, &camera, &extrinsics);
+	std::vector<uint16_t> depth(camera.width * camera.height);
+
+	TargetLocalizer localizer;
+	CHECK(localizer.initialize(camera));
+
+	static const Beacon scenes[][2] = {
+		{ { { -0.40f, 0.10f, 1.20f }, 0.06f }, { { 0.30f, 0.10f, 1.50f }, 0.06f } },
+		{ { { -0.50f, 0.20f, 2.00f }, 0.08f }, { { 0.50f, 0.20f, 2.40f }, 0.08f } },
+		{ { { 0.20f, -0.10f, 2.80f }, 0.10f }, { { 0.90f, -0.10f, 2.60f }, 0.10f } },
+	};
+	for( size_t s = 0; s < sizeof(scenes) / sizeof(scenes[0]); s++ )
+	{
+		const Beacon* beacons = scenes[s];
+		renderBeacons(camera, beacons, 2, depth);
+		Coordinate first = project(camera, beacons[0].center);
+		Coordinate second = project(camera, beacons[1].center);
+
+		// Half a pixel of centroid rounding is about 2.5mm sideways at 2.8m
+		Point3D location;
+		CHECK(localizer.localize(&depth[0], first, &location));
+		CHECK(distance(location, beacons[0].center) < 0.005f);
+		CHECK(localizer.localize(&depth[0], second, &location));
+		CHECK(distance(location, beacons[1].center) < 0.005f);
+
+		BeaconPair pair;
+		CHECK(localizer.localizePair(&depth[0], first, second, &pair));
+		float mx = (beacons[0].center.x + beacons[1].center.x) * 0.5f;
+		float mz = (beacons[0].center.z + beacons[1].center.z) * 0.5f;
+		CHECK_NEAR(pair.range, sqrtf(mx * mx + mz * mz), 0.002);
+		CHECK_NEAR(pair.bearing, atan2f(mx, mz), 0.002);
+		CHECK_NEAR(pair.separation, distance(beacons[0].center, beacons[1].center), 0.01);
+	}
+
+	// Off the frame, and a window with too few readings, give no location
+	Point3D location;
+	Coordinate outside = { -1, 10 };
+	CHECK(!localizer.localize(&depth[0], outside, &location));
+	Coordinate center = { camera.width / 2, camera.height / 2 };
+	for( int y = center.y - 3; y <= center.y + 3; y++ )
+		for( int x = center.x - 3; x <= center.x + 3; x++ )
+			depth[y * camera.width + x] = 0;
+	CHECK(!localizer.localize(&depth[0], center, &location));
+}
+
+// The pipeline locates the synthetic target at the range the scene drew it at
+static void testPipeline(int width, int height)
+{
+	SyntheticSceneConfig sceneConfig;
+	getDefaultSyntheticSceneConfig(&sceneConfig);
+	sceneConfig.width = width;
+	sceneConfig.height = height;
+	sceneConfig.radius = 12 * width / 320;
+	sceneConfig.distractors = 0;
+	sceneConfig.noise = 0;
+	SyntheticScene scene;
+	CHECK(scene.initialize(sceneConfig));
+
+	TrackingPipelineConfig config;
+	getDefaultTrackingPipelineConfig(&config);
+	config.depthRegistered = true;
+	config.estimateGround = false;
+	TrackingPipeline pipeline;
+	CHECK(pipeline.initialize(config, width, height));
+
+	CameraIntrinsics depthIntrinsics, camera;
+	CameraExtrinsics extrinsics;
+	getKinectDefaultCalibration(&depthIntrinsics, &camera, &extrinsics);
+	scaleCameraIntrinsics(&camera, width, height);
+
+	int located = 0;
+	for( int i = 0; i < 60; i++ )
+	{
+		Frame frame;
+		TrackingResult result;
+		CHECK(scene.nextFrame(&frame));
+		CHECK(pipeline.process(frame, &result));
+		if( !result.located )
+			continue;
+		located++;
+
+		// Where the tracker puts the centroid is its own business, the ray
+		// through it has to come from the camera scaled to the frame
+		float range = scene.blob(0).range / 1000.0f;
+		CHECK_NEAR(result.location.z, range, 0.001);
+		CHECK_NEAR(result.location.x, (result.target.x - camera.cx) / camera.fx * range, 0.001);
+		CHECK_NEAR(result.location.y, (result.target.y - camera.cy) / camera.fy * range, 0.001);
+	}
+	CHECK(located > 50);
+}
+
+// Kinect depth comes in the depth camera and has to be registered first. A
+// wall straight ahead reads the same range wherever the target is seen on it.
+static void testPipelineRegistration(void)
+{
+	SyntheticSceneConfig sceneConfig;
+	getDefaultSyntheticSceneConfig(&sceneConfig);
+	sceneConfig.distractors = 0;
+	SyntheticScene scene;
+	CHECK(scene.initialize(sceneConfig));
+
+	TrackingPipelineConfig config;
+	getDefaultTrackingPipelineConfig(&config);
+	config.estimateGround = false;
+	TrackingPipeline pipeline;
+	CHECK(pipeline.initialize(config));
+
+	std::vector<uint16_t> wall(640 * 480, (uint16_t)(2000 << DEPTH_PLAYER_INDEX_SHIFT));
+	int located = 0;
+	for( int i = 0; i < 30; i++ )
+	{
+		Frame frame;
+		TrackingResult result;
+		CHECK(scene.nextFrame(&frame));
+		frame.depth = &wall[0];
+		CHECK(pipeline.process(frame, &result));
+		if( result.located )
+		{
+			located++;
+			CHECK_NEAR(result.location.z, 2.0, 0.001);
+		}
+	}
+	CHECK(located > 20);
+}
+
+void testLocalization(void)
+{
+	testBeacons();
+	testPipeline(640, 480);
+	testPipeline(320, 240);
+	testPipelineRegistration();
+}
@@ -0,0 +1,65 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "Check.h"
+#include "TrackerCore.h"
+#include "SyntheticScene.h"
+
+// Tracks the scene with a full scan and with motion gating side by side.
+// With threshold 0 every frame has to come out exactly the same, centroid
+// and descriptor alike. Halfway through, descriptors are switched over on
+// both so the tiles' kept sums have to follow. Returns the fraction of
+// tiles skipped.
+static double compareWithFullScan(const SyntheticSceneConfig& config, int tileSize, int frames)
+{
+	SyntheticScene scene;
+	CHECK(scene.initialize(config));
+	TrackerCore full, gated;
+	gated.setMotionGating(tileSize, 0);
+
+	int differing = 0;
+	int64_t tiles = 0, skipped = 0;
+	for( int i = 0; i < frames; i++ )
+	{
+		if( i == frames / 2 )
+			full.computeDescriptors = gated.computeDescriptors = !full.computeDescriptors;
+
+		Frame frame;
+		CHECK(scene.nextFrame(&frame));
+		int size = frame.colorPitch * frame.colorHeight;
+		full.centerOne.x = full.centerOne.y = gated.centerOne.x = gated.centerOne.y = -1;
+		full.findTarget(frame.color, frame.colorPitch, size);
+		gated.findTarget(frame.color, frame.colorPitch, size);
+
+		differing += full.centerOne.x != gated.centerOne.x || full.centerOne.y != gated.centerOne.y ||
+					 memcmp(&full.targetOne, &gated.targetOne, sizeof(TargetDescriptor)) != 0;
+		tiles += gated.tileCount;
+		skipped += gated.tilesSkipped;
+	}
+	CHECK(differing == 0);
+	CHECK(tiles > 0);
+	return tiles ? (double)skipped / tiles : 0.0;
+}
+
+void testMotionGating(void)
+{
+	SyntheticSceneConfig config;
+	getDefaultSyntheticSceneConfig(&config);
+	config.width = 320;
+	config.height = 240;
+	config.radius = 12;
+
+	// Sensor noise touches every tile, so nothing is skipped but the result still matches
+	compareWithFullScan(config, 32, 20);
+
+	// Without noise most of the frame stands still and is skipped
+	config.noise = 0;
+	CHECK(compareWithFullScan(config, 32, 40) > 0.5);
+	CHECK(compareWithFullScan(config, 16, 40) > 0.5);
+
+	// Tiles cut short at the right and bottom edges
+	config.width = 100;
+	config.height = 75;
+	config.radius = 6;
+	CHECK(compareWithFullScan(config, 32, 40) > 0.2);
+}
@@ -0,0 +1,83 @@
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "Check.h"
+#include "Registration.h"
+
+// Ranges from 0.5 to 4.5m in bands, a hole every few pixels and player
+// index bits in some readings, which the mapping has to ignore
+static void fillDepth(std::vector<uint16_t>& depth, int width, int height)
+{
+	for( int y = 0; y < height; y++ )
+		for( int x = 0; x < width; x++ )
+		{
+			int i = y * width + x;
+			int mm = 500 + (x * 13 + y * 7) % 4000;
+			int player = (x / 40 + y / 40) % 8;
+			depth[i] = (uint16_t)((mm << DEPTH_PLAYER_INDEX_SHIFT) | player);
+			if( (x * 7 + y * 13) % 31 == 0 )
+				depth[i] = 0;
+		}
+}
+
+void testRegistration(void)
+{
+	CameraIntrinsics depthIntrinsics, colorIntrinsics;
+	CameraExtrinsics extrinsics;
+	getKinectDefaultCalibration(&depthIntrinsics, &colorIntrinsics, &extrinsics);
+	int width = depthIntrinsics.width, height = depthIntrinsics.height;
+	int pixels = width * height;
+
+	std::vector<uint16_t> depth(pixels);
+	fillDepth(depth, width, height);
+
+	DepthRegistration registration;
+	CHECK(registration.initialize(depthIntrinsics, colorIntrinsics, extrinsics));
+
+	// The tables only drop the optical axis translation, which the Kinect
+	// calibration does not have, so they agree with the camera model up to rounding
+	CHECK(registration.compareToReference(&depth[0]) <= 1);
+
+	std::vector<int> fast(pixels * 2), scalar(pixels * 2), reference(pixels * 2);
+	registration.mapDepthToColor(&depth[0], &fast[0]);
+	registration.setUseSimd(false);
+	registration.mapDepthToColor(&depth[0], &scalar[0]);
+	registration.setUseSimd(true);
+	registration.mapDepthToColorReference(&depth[0], &reference[0]);
+	CHECK(fast == scalar);
+
+	int holes = 0, wrongHoles = 0;
+	for( int i = 0; i < pixels; i++ )
+	{
+		if( depth[i] >> DEPTH_PLAYER_INDEX_SHIFT )
+			continue;
+		holes++;
+		if( fast[2 * i] != -1 || fast[2 * i + 1] != -1 || reference[2 * i] != -1 )
+			wrongHoles++;
+	}
+	CHECK(holes > 0);
+	CHECK(wrongHoles == 0);
+
+	// A point straight ahead at 1m shows up left of the color center by the
+	// 25mm baseline times the color focal length over the range
+	int center = (height / 2) * width + width / 2;
+	depth[center] = (uint16_t)(1000 << DEPTH_PLAYER_INDEX_SHIFT);
+	registration.mapDepthToColor(&depth[0], &fast[0]);
+	CHECK_NEAR(fast[2 * center], colorIntrinsics.cx - colorIntrinsics.fx * 25.0f / 1000.0f, 1.0);
+	CHECK_NEAR(fast[2 * center + 1], colorIntrinsics.cy, 1.0);
+
+	std::vector<uint16_t> registered(pixels), registeredScalar(pixels);
+	registration.registerDepthToColor(&depth[0], &registered[0]);
+	registration.setUseSimd(false);
+	registration.registerDepthToColor(&depth[0], &registeredScalar[0]);
+	registration.setUseSimd(true);
+	CHECK(registered == registeredScalar);
+	CHECK(registered[fast[2 * center + 1] * width + fast[2 * center]] <= depth[center]);
+
+	// Translation along the optical axis is outside the table model and
+	// has to show up in the comparison
+	extrinsics.translation[2] = 50.0f;
+	CHECK(registration.initialize(depthIntrinsics, colorIntrinsics, extrinsics));
+	CHECK(registration.compareToReference(&depth[0]) > 1);
+}
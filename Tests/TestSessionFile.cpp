@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "Check.h"
+#include "SessionFile.h"
+
+#define SESSION_PATH "TestSession.tmp"
+#define WIDTH 32
+#define HEIGHT 24
+
+static FILE* openFile(const char* path, const char* mode)
+{
+	FILE* file;
+#ifdef _WIN32
+	if( fopen_s(&file, path, mode) )
+		file = NULL;
+#else
+	file = fopen(path, mode);
+#endif
+	return file;
+}
+
+// Reads the whole file, the caller deletes the buffer
+static uint8_t* loadFile(const char* path, size_t* size)
+{
+	FILE* file = openFile(path, "rb");
+	if( file == NULL )
+		return NULL;
+	fseek(file, 0, SEEK_END);
+	*size = (size_t)ftell(file);
+	fseek(file, 0, SEEK_SET);
+	uint8_t* data = new uint8_t[*size];
+	bool ok = fread(data, 1, *size, file) == *size;
+	fclose(file);
+	if( !ok )
+	{
+		delete[] data;
+		return NULL;
+	}
+	return data;
+}
+
+static bool opens(const uint8_t* data, size_t size)
+{
+	FILE* file = openFile(SESSION_PATH, "wb");
+	if( file == NULL )
+		return false;
+	bool written = fwrite(data, 1, size, file) == size;
+	fclose(file);
+
+	SessionPlayback playback;
+	return written && playback.open(SESSION_PATH);
+}
+
+static void putU32(uint8_t* at, uint32_t value)
+{
+	memcpy(at, &value, sizeof(value));
+}
+
+static void putU64(uint8_t* at, uint64_t value)
+{
+	memcpy(at, &value, sizeof(value));
+}
+
+// Three color frames, each after a depth frame, raw and compressed
+static bool writeSession(void)
+{
+	uint8_t color[WIDTH * HEIGHT * 4];
+	uint16_t depth[WIDTH * HEIGHT];
+	for( int i = 0; i < WIDTH * HEIGHT; i++ )
+	{
+		color[i * 4] = color[i * 4 + 1] = color[i * 4 + 2] = (uint8_t)i;
+		color[i * 4 + 3] = 0;
+		depth[i] = (uint16_t)((1000 + i) << 3);
+	}
+
+	SessionWriter writer;
+	bool ok = writer.open(SESSION_PATH);
+	for( int f = 0; f < 3 && ok; f++ )
+	{
+		ok = writer.writeDepth(depth, WIDTH, HEIGHT, f / 30.0, f != 1) &&
+			 writer.writeColor(color, WIDTH, HEIGHT, WIDTH * 4, f / 30.0);
+	}
+	return writer.close() && ok;
+}
+
+static void testPlayback(void)
+{
+	CHECK(writeSession());
+	SessionPlayback playback;
+	CHECK(playback.open(SESSION_PATH));
+	CHECK(playback.frameCount() == 3);
+
+	Frame frame;
+	int frames = 0;
+	while( playback.nextFrame(&frame) )
+	{
+		CHECK(frame.colorWidth == WIDTH && frame.colorHeight == HEIGHT && frame.colorPitch == WIDTH * 4);
+		CHECK(frame.depth && frame.depthWidth == WIDTH && frame.depthHeight == HEIGHT);
+		CHECK(frame.depth[5] == (1000 + 5) << 3);
+		frames++;
+	}
+	CHECK(frames == 3);
+}
+
+static void testDamaged(void)
+{
+	CHECK(writeSession());
+	size_t size = 0;
+	uint8_t* valid = loadFile(SESSION_PATH, &size);
+	CHECK(valid != NULL);
+	if( valid == NULL )
+		return;
+	uint8_t* data = new uint8_t[size];
+
+	const size_t footerOffset = size - sizeof(SessionFileFooter);
+	const size_t entries = offsetof(SessionFileFooter, entries);
+	const size_t indexOffset = offsetof(SessionFileFooter, indexOffset);
+	uint64_t realIndex;
+	memcpy(&realIndex, valid + footerOffset + indexOffset, sizeof(realIndex));
+	const size_t firstRecord = sizeof(SessionFileHeader);
+
+	CHECK(opens(valid, size));
+
+	// Cut short anywhere, the footer is gone or points past the end
+	int accepted = 0;
+	for( size_t cut = 0; cut < size; cut += cut < size - 64 ? size / 32 : 1 )
+		accepted += opens(valid, cut);
+	CHECK(accepted == 0);
+
+	// An entry count whose index would wrap round to end at the footer
+	memcpy(data, valid, size);
+	putU32(data + footerOffset + entries, 0xFFFFFFFF);
+	putU64(data + footerOffset + indexOffset, footerOffset - 0xFFFFFFFFull * sizeof(SessionIndexEntry));
+	CHECK(!opens(data, size));
+
+	// An index starting inside the file header, in a file just big enough
+	// for three entries between the header and the footer
+	uint8_t small[sizeof(SessionFileHeader) + 3 * sizeof(SessionIndexEntry) + sizeof(SessionFileFooter)];
+	memset(small, 0, sizeof(small));
+	memcpy(small, valid, sizeof(SessionFileHeader));
+	memcpy(small + sizeof(small) - sizeof(SessionFileFooter), valid + footerOffset, sizeof(SessionFileFooter));
+	CHECK(!opens(small, sizeof(small)));
+	putU32(small + sizeof(small) - sizeof(SessionFileFooter) + entries, 3);
+	putU64(small + sizeof(small) - sizeof(SessionFileFooter) + indexOffset, 0);
+	CHECK(!opens(small, sizeof(small)));
+
+	// Record offsets that wrap, land in the header or are not aligned
+	uint64_t badOffsets[] = { 0xFFFFFFFFFFFFFFF0ull, 0, firstRecord + 4, realIndex };
+	for( int i = 0; i < 4; i++ )
+	{
+		memcpy(data, valid, size);
+		putU64(data + realIndex + offsetof(SessionIndexEntry, offset), badOffsets[i]);
+		CHECK(!opens(data, size));
+	}
+
+	// Record headers that claim more than the file holds or make no sense
+	struct
+	{
+		size_t field;
+		uint32_t value;
+	} badFields[] =
+	{
+		{ offsetof(SessionRecordHeader, size), 0xFFFFFFFF },
+		{ offsetof(SessionRecordHeader, width), 0 },
+		{ offsetof(SessionRecordHeader, width), 0xFFFFFFFF },
+		{ offsetof(SessionRecordHeader, height), 0x80000000 },
+		{ offsetof(SessionRecordHeader, encoding), 7 },
+	};
+	// The second depth record is raw and follows the first color record
+	uint64_t rawDepth;
+	memcpy(&rawDepth, valid + realIndex + 2 * sizeof(SessionIndexEntry) + offsetof(SessionIndexEntry, offset),
+		   sizeof(rawDepth));
+	for( int i = 0; i < (int)(sizeof(badFields) / sizeof(badFields[0])); i++ )
+	{
+		memcpy(data, valid, size);
+		putU32(data + firstRecord + badFields[i].field, badFields[i].value);
+		CHECK(!opens(data, size));
+		memcpy(data, valid, size);
+		putU32(data + (size_t)rawDepth + badFields[i].field, badFields[i].value);
+		CHECK(!opens(data, size));
+	}
+	memcpy(data, valid, size);
+	putU32(data + (size_t)rawDepth + offsetof(SessionRecordHeader, pitch), WIDTH);
+	CHECK(!opens(data, size));
+
+	delete[] data;
+	delete[] valid;
+}
+
+void testSessionFile(void)
+{
+	testPlayback();
+	testDamaged();
+	remove(SESSION_PATH);
+}
@@ -0,0 +1,227 @@
+#include <stdint.h>
+#include <math.h>
+
+#include "Check.h"
+#include "TargetFilter.h"
+#include "TrackerCore.h"
+#include "SyntheticScene.h"
+
+#define RATE 30.0
+#define NOISE 1.5
+// How far ahead a controller wants the target, two frames of latency
+#define LEAD 0.066
+
+enum { TRAJECTORY_LINE, TRAJECTORY_THROW, TRAJECTORY_CIRCLE, TRAJECTORY_COUNT };
+
+static void trajectoryPosition(int trajectory, double t, double* x, double* y)
+{
+	switch( trajectory )
+	{
+	case TRAJECTORY_LINE:
+		*x = 100.0 + 150.0 * t;
+		*y = 200.0 - 60.0 * t;
+		break;
+	case TRAJECTORY_THROW:
+		*x = 50.0 + 120.0 * t;
+		*y = 400.0 - 300.0 * t + 0.5 * 200.0 * t * t;
+		break;
+	default:
+		*x = 320.0 + 150.0 * cos(2.0 * t);
+		*y = 240.0 + 150.0 * sin(2.0 * t);
+		break;
+	}
+}
+
+static double gaussianNoise(uint32_t* random)
+{
+	double u[2];
+	for( int i = 0; i < 2; i++ )
+	{
+		*random ^= *random << 13;
+		*random ^= *random >> 17;
+		*random ^= *random << 5;
+		u[i] = (*random + 1.0) / 4294967297.0;
+	}
+	return sqrt(-2.0 * log(u[0])) * cos(2.0 * 3.14159265358979 * u[1]);
+}
+
+static double squaredDistance(double x0, double y0, double x1, double y1)
+{
+	return (x0 - x1) * (x0 - x1) + (y0 - y1) * (y0 - y1);
+}
+
+// Ten seconds of one trajectory with noisy measurements and dropouts of 5
+// and 8 frames, compared against the ground truth. Filtering has to beat
+// the raw measurements, coasting has to beat holding the last measurement
+// and the prediction has to beat acting on a stale one by a wide margin.
+static void followTrajectory(int trajectory, bool constantAcceleration)
+{
+	const int frames = 300;
+	TargetFilterConfig config;
+	getDefaultTargetFilterConfig(&config);
+	config.constantAcceleration = constantAcceleration;
+	if( constantAcceleration )
+		config.processNoise = 200000.0;
+	config.measurementNoise = NOISE;
+	TargetFilter filter;
+	filter.initialize(config);
+
+	uint32_t random = 2463534242u;
+	double rawError = 0.0, filteredError = 0.0, coastError = 0.0, holdError = 0.0, staleError = 0.0, predictError = 0.0;
+	int measured = 0, coasted = 0;
+	double lastX = 0.0, lastY = 0.0;
+	for( int i = 0; i < frames; i++ )
+	{
+		double t = i / RATE;
+		double x, y;
+		trajectoryPosition(trajectory, t, &x, &y);
+		bool found = !(i >= 100 && i < 105) && !(i >= 200 && i < 208);
+		double mx = x + NOISE * gaussianNoise(&random);
+		double my = y + NOISE * gaussianNoise(&random);
+		filter.update(0, t, found, mx, my);
+		const TargetTrack& track = filter.track(0);
+		CHECK(track.active && track.coasting == !found && track.timestamp == t);
+
+		// Leave the first half second for the track to settle
+		if( i < 15 )
+		{
+			lastX = mx;
+			lastY = my;
+			continue;
+		}
+		if( found )
+		{
+			rawError += squaredDistance(mx, my, x, y);
+			filteredError += squaredDistance(track.x, track.y, x, y);
+			measured++;
+			lastX = mx;
+			lastY = my;
+
+			double futureX, futureY, px, py;
+			trajectoryPosition(trajectory, t + LEAD, &futureX, &futureY);
+			CHECK(filter.predict(0, t + LEAD, &px, &py));
+			staleError += squaredDistance(mx, my, futureX, futureY);
+			predictError += squaredDistance(px, py, futureX, futureY);
+		}
+		else
+		{
+			coastError += squaredDistance(track.x, track.y, x, y);
+			holdError += squaredDistance(lastX, lastY, x, y);
+			coasted++;
+		}
+	}
+
+	CHECK(filteredError < rawError * 0.8 * 0.8);
+	CHECK(coastError < holdError * 0.5 * 0.5);
+	CHECK(predictError < staleError * 0.5 * 0.5);
+	// Within a few standard deviations of the measurement noise
+	CHECK(sqrt(predictError / measured) < 4.0 * NOISE);
+	CHECK(sqrt(coastError / coasted) < 12.0 * NOISE);
+
+	const TargetTrack& track = filter.track(0);
+	CHECK(track.active);
+	CHECK(track.misses == 13);
+	CHECK(track.rejected == 0);
+	CHECK(track.updates == frames - 13);
+	CHECK(!filter.track(1).active);
+}
+
+// A wild measurement is gated off, a long dropout ends the track and the
+// next measurement starts a new one where it was seen
+static void testTrackLifetime(void)
+{
+	TargetFilterConfig config;
+	getDefaultTargetFilterConfig(&config);
+	TargetFilter filter;
+	filter.initialize(config);
+	double x, y;
+	CHECK(!filter.predict(0, 0.0, &x, &y));
+
+	int frame = 0;
+	for( ; frame < 30; frame++ )
+		filter.update(0, frame / RATE, true, 100.0 + frame, 100.0);
+	CHECK_NEAR(filter.track(0).vx, RATE, 1.0);
+
+	filter.update(0, frame / RATE, true, 400.0, 400.0);
+	CHECK(filter.track(0).rejected == 1 && filter.track(0).coasting);
+	CHECK_NEAR(filter.track(0).x, 100.0 + frame, 0.5);
+	frame++;
+
+	// Coasting up to maxCoast keeps the track, a frame past it drops it
+	double lastMeasurement = filter.track(0).lastMeasurement;
+	for( ; frame / RATE - lastMeasurement <= config.maxCoast; frame++ )
+	{
+		filter.update(0, frame / RATE, false, 0.0, 0.0);
+		CHECK(filter.track(0).active);
+	}
+	filter.update(0, frame / RATE, false, 0.0, 0.0);
+	CHECK(!filter.track(0).active);
+	CHECK(!filter.predict(0, frame / RATE, &x, &y));
+
+	frame++;
+	filter.update(0, frame / RATE, true, 400.0, 400.0);
+	CHECK(filter.track(0).active && filter.track(0).x == 400.0 && filter.track(0).y == 400.0);
+	CHECK(filter.track(0).vx == 0.0 && filter.track(0).updates == 1);
+
+	filter.reset();
+	CHECK(!filter.track(0).active);
+}
+
+// The filter on centroids the tracker measured from synthetic images,
+// predicting two frames ahead
+static void testTracked(void)
+{
+	const int frames = 150, lead = 2;
+	SyntheticSceneConfig sceneConfig;
+	getDefaultSyntheticSceneConfig(&sceneConfig);
+	sceneConfig.width = 320;
+	sceneConfig.height = 240;
+	sceneConfig.radius = 12;
+	sceneConfig.targets = 1;
+	sceneConfig.distractors = 0;
+	SyntheticScene scene;
+	CHECK(scene.initialize(sceneConfig));
+	TrackerCore tracker;
+	TargetFilter filter;
+
+	double truthX[frames], truthY[frames], measuredX[frames], measuredY[frames], predictedX[frames],
+		predictedY[frames];
+	int count = 0;
+	Frame frame;
+	for( ; count < frames && scene.nextFrame(&frame); count++ )
+	{
+		scene.targetCentroid(&truthX[count], &truthY[count]);
+		tracker.findTarget(frame.color, frame.colorPitch, frame.colorPitch * frame.colorHeight);
+		filter.update(frame.colorTimestamp, tracker);
+		measuredX[count] = tracker.targetOne.found ? tracker.targetOne.x : -1.0;
+		measuredY[count] = tracker.targetOne.y;
+		if( !filter.predict(0, frame.colorTimestamp + lead / sceneConfig.frameRate, &predictedX[count],
+							&predictedY[count]) )
+			predictedX[count] = -1.0;
+	}
+	CHECK(count == frames);
+
+	double staleError = 0.0, predictError = 0.0;
+	int compared = 0;
+	for( int i = 15; i + lead < count; i++ )
+	{
+		if( measuredX[i] < 0.0 || truthX[i + lead] < 0.0 || predictedX[i] < 0.0 )
+			continue;
+		staleError += squaredDistance(measuredX[i], measuredY[i], truthX[i + lead], truthY[i + lead]);
+		predictError += squaredDistance(predictedX[i], predictedY[i], truthX[i + lead], truthY[i + lead]);
+		compared++;
+	}
+	CHECK(compared > frames / 2);
+	CHECK(predictError < staleError * 0.5 * 0.5);
+}
+
+void testTargetFilter(void)
+{
+	for( int trajectory = 0; trajectory < TRAJECTORY_COUNT; trajectory++ )
+	{
+		followTrajectory(trajectory, false);
+		followTrajectory(trajectory, true);
+	}
+	testTrackLifetime();
+	testTracked();
+}
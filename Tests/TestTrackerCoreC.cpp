@@ -0,0 +1,111 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "Check.h"
+#include "TrackerCore.h"
+#include "TrackerCoreC.h"
+#include "SyntheticScene.h"
+
+#define WIDTH 160
+#define HEIGHT 120
+#define FRAMES 8
+
+// Every batch size and thread count gives what measureTarget gives
+static void testMatchesDirect(void)
+{
+	SyntheticSceneConfig config;
+	getDefaultSyntheticSceneConfig(&config);
+	config.width = WIDTH;
+	config.height = HEIGHT;
+	config.radius = 8;
+	SyntheticScene scene;
+	CHECK(scene.initialize(config));
+
+	static uint32_t pixels[FRAMES][WIDTH * HEIGHT];
+	TrackerCoreFrame frames[FRAMES];
+	TargetDescriptor expected[FRAMES];
+	TrackerCore direct;
+	for( int i = 0; i < FRAMES; i++ )
+	{
+		Frame frame;
+		CHECK(scene.nextFrame(&frame) && frame.colorPitch == WIDTH * 4);
+		memcpy(pixels[i], frame.color, sizeof(pixels[i]));
+		frames[i].timestamp = i / 30.0;
+		frames[i].width = WIDTH;
+		frames[i].height = HEIGHT;
+		frames[i].stride = WIDTH * 4;
+		frames[i].reserved = 0;
+		frames[i].pixels = pixels[i];
+		direct.measureTarget(pixels[i], WIDTH, HEIGHT, WIDTH * 4, &expected[i]);
+		CHECK(expected[i].found);
+	}
+
+	int threads[2] = { 1, 0 };
+	for( int t = 0; t < 2; t++ )
+	{
+		TrackerCoreHandle tracker = trackerCoreCreate(threads[t], 0);
+		CHECK(tracker != NULL);
+		if( tracker == NULL )
+			continue;
+		for( int size = 1; size <= FRAMES; size *= 2 )
+		{
+			TrackerCoreResult results[FRAMES];
+			for( int first = 0; first < FRAMES; first += size )
+				CHECK(trackerCoreProcess(tracker, &frames[first], &results[first], size) == TRACKERCORE_OK);
+			int mismatches = 0;
+			for( int i = 0; i < FRAMES; i++ )
+			{
+				const TargetDescriptor& want = expected[i];
+				mismatches += results[i].status != TRACKERCORE_OK || results[i].found != (int32_t)want.found ||
+							  results[i].x != want.x || results[i].y != want.y || results[i].area != want.area ||
+							  results[i].majorAxis != want.majorAxis || results[i].left != want.left ||
+							  results[i].bottom != want.bottom;
+			}
+			CHECK(mismatches == 0);
+		}
+		trackerCoreDestroy(tracker);
+	}
+}
+
+static void testBadArguments(void)
+{
+	TrackerCoreHandle tracker = trackerCoreCreate(1, 0);
+	CHECK(tracker != NULL);
+	if( tracker == NULL )
+		return;
+
+	uint32_t pixels[16 * 16];
+	memset(pixels, 0, sizeof(pixels));
+	TrackerCoreFrame frames[3];
+	for( int i = 0; i < 3; i++ )
+	{
+		frames[i].timestamp = i;
+		frames[i].width = 16;
+		frames[i].height = 16;
+		frames[i].stride = 16 * 4;
+		frames[i].reserved = 0;
+		frames[i].pixels = pixels;
+	}
+	frames[1].stride = 15 * 4;
+	frames[2].pixels = NULL;
+
+	// Bad frames are reported on their own, the rest still get processed
+	TrackerCoreResult results[3];
+	CHECK(trackerCoreProcess(tracker, frames, results, 3) == TRACKERCORE_ERROR_ARGUMENT);
+	CHECK(results[0].status == TRACKERCORE_OK && results[0].found == 0);
+	CHECK(results[1].status == TRACKERCORE_ERROR_ARGUMENT);
+	CHECK(results[2].status == TRACKERCORE_ERROR_ARGUMENT);
+
+	CHECK(trackerCoreProcess(NULL, frames, results, 1) == TRACKERCORE_ERROR_ARGUMENT);
+	CHECK(trackerCoreProcess(tracker, NULL, results, 1) == TRACKERCORE_ERROR_ARGUMENT);
+	CHECK(trackerCoreProcess(tracker, frames, results, -1) == TRACKERCORE_ERROR_ARGUMENT);
+	CHECK(trackerCoreProcess(tracker, NULL, NULL, 0) == TRACKERCORE_OK);
+	trackerCoreDestroy(tracker);
+}
+
+void testTrackerCoreC(void)
+{
+	CHECK(trackerCoreVersion() == TRACKERCORE_C_VERSION);
+	testMatchesDirect();
+	testBadArguments();
+}
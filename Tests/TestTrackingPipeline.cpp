@@ -0,0 +1,183 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "Check.h"
+#include "TrackingPipeline.h"
+#include "SyntheticScene.h"
+
+// The floor the synthetic scene lays into its depth has to come back at the
+// mount height and pitch it was drawn with, whatever the frame size
+static void testGroundAtSize(int width, int height)
+{
+	SyntheticSceneConfig sceneConfig;
+	getDefaultSyntheticSceneConfig(&sceneConfig);
+	sceneConfig.width = width;
+	sceneConfig.height = height;
+	sceneConfig.radius = 12 * width / 320;
+	SyntheticScene scene;
+	CHECK(scene.initialize(sceneConfig));
+
+	TrackingPipelineConfig config;
+	getDefaultTrackingPipelineConfig(&config);
+	config.depthRegistered = true;
+	TrackingPipeline pipeline;
+	CHECK(pipeline.initialize(config, width, height));
+
+	int found = 0;
+	for( int i = 0; i < 10; i++ )
+	{
+		Frame frame;
+		TrackingResult result;
+		CHECK(scene.nextFrame(&frame));
+		CHECK(pipeline.process(frame, &result));
+		if( !result.groundFound )
+			continue;
+		found++;
+
+		// The normal leans toward the camera by the pitch: y down, z forward
+		CHECK_NEAR(result.ground.d, sceneConfig.sensorHeight, 0.02);
+		CHECK_NEAR(atan2(-result.ground.c, -result.ground.b), sceneConfig.sensorPitch, 0.02);
+	}
+	CHECK(found == 10);
+}
+
+// The bare floor fills the nearer part of the grid with free cells and
+// nothing else, the balls standing on it show up as obstacles
+static void testGridAtSize(int width, int height)
+{
+	SyntheticSceneConfig sceneConfig;
+	getDefaultSyntheticSceneConfig(&sceneConfig);
+	sceneConfig.width = width;
+	sceneConfig.height = height;
+	sceneConfig.radius = 12 * width / 320;
+
+	TrackingPipelineConfig config;
+	getDefaultTrackingPipelineConfig(&config);
+	config.depthRegistered = true;
+	config.grid.sensorHeight = sceneConfig.sensorHeight;
+	config.grid.sensorPitch = sceneConfig.sensorPitch;
+
+	for( int objects = 0; objects < 2; objects++ )
+	{
+		sceneConfig.targets = objects;
+		sceneConfig.distractors = objects ? 3 : 0;
+		SyntheticScene scene;
+		CHECK(scene.initialize(sceneConfig));
+		TrackingPipeline pipeline;
+		CHECK(pipeline.initialize(config, width, height));
+
+		int obstacles = 0, craters = 0;
+		for( int i = 0; i < 10; i++ )
+		{
+			Frame frame;
+			TrackingResult result;
+			CHECK(scene.nextFrame(&frame));
+			CHECK(pipeline.process(frame, &result));
+			CHECK(result.obstacleCells == pipeline.grid().obstacleCells());
+			CHECK(result.craterCells == pipeline.grid().craterCells());
+			obstacles += result.obstacleCells;
+			craters += result.craterCells;
+		}
+
+		const OccupancyGrid& grid = pipeline.grid();
+		int cells = grid.columns() * grid.rows();
+		int free = 0;
+		for( int i = 0; i < cells; i++ )
+			free += grid.states()[i] == CELL_FREE;
+		CHECK(free > cells / 5);
+		if( objects )
+			CHECK(obstacles > 0);
+		else
+			CHECK(obstacles == 0 && craters == 0);
+	}
+}
+
+#define PROBE_WIDTH 320
+#define PROBE_HEIGHT 240
+
+// One frame with an orange disc around (targetX, targetY) at targetRange and
+// everything else at backgroundRange, except a patch at the image center at
+// centerRange. Ranges in millimeters.
+static TrackingResult probeFrame(TrackingPipeline& pipeline, int targetX, int targetY, int targetRange,
+								 int centerRange, int backgroundRange)
+{
+	static uint32_t color[PROBE_WIDTH * PROBE_HEIGHT];
+	static uint16_t depth[PROBE_WIDTH * PROBE_HEIGHT];
+	static uint32_t index = 0;
+	for( int y = 0; y < PROBE_HEIGHT; y++ )
+		for( int x = 0; x < PROBE_WIDTH; x++ )
+		{
+			int range = backgroundRange;
+			color[y * PROBE_WIDTH + x] = 0x00606060;
+			if( abs(x - PROBE_WIDTH / 2) <= 4 && abs(y - PROBE_HEIGHT / 2) <= 4 )
+				range = centerRange;
+			if( targetX >= 0 && (x - targetX) * (x - targetX) + (y - targetY) * (y - targetY) <= 100 )
+			{
+				color[y * PROBE_WIDTH + x] = 0x00FF8C00;
+				range = targetRange;
+			}
+			depth[y * PROBE_WIDTH + x] = (uint16_t)(range << DEPTH_PLAYER_INDEX_SHIFT);
+		}
+
+	Frame frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.index = index;
+	frame.color = (uint8_t*)color;
+	frame.colorPitch = PROBE_WIDTH * 4;
+	frame.colorWidth = PROBE_WIDTH;
+	frame.colorHeight = PROBE_HEIGHT;
+	frame.colorTimestamp = index / 30.0;
+	frame.depth = depth;
+	frame.depthWidth = PROBE_WIDTH;
+	frame.depthHeight = PROBE_HEIGHT;
+	frame.depthTimestamp = frame.colorTimestamp;
+	index++;
+
+	TrackingResult result;
+	CHECK(pipeline.process(frame, &result));
+	return result;
+}
+
+// The alert looks at the range where the target is, the same as the
+// viewer's, and only at the image center when there is no target
+static void testProximityAlert(void)
+{
+	TrackingPipelineConfig config;
+	getDefaultTrackingPipelineConfig(&config);
+	config.depthRegistered = true;
+	config.filterDepth = false;
+	config.estimateGround = false;
+	config.buildGrid = false;
+	config.filterTarget = false;
+	TrackingPipeline pipeline;
+	CHECK(pipeline.initialize(config, PROBE_WIDTH, PROBE_HEIGHT));
+
+	// Off center inside the window, with the center out of it
+	TrackingResult result = probeFrame(pipeline, 60, 70, 900, 2000, 3000);
+	CHECK(result.found && result.newDepth);
+	CHECK(result.centerRange == 900);
+	CHECK(result.alert);
+
+	// Off center out of the window, with the center inside it
+	result = probeFrame(pipeline, 250, 180, 2000, 900, 3000);
+	CHECK(result.found);
+	CHECK(result.centerRange == 2000);
+	CHECK(!result.alert);
+
+	// Without a target the center decides
+	result = probeFrame(pipeline, -1, -1, 0, 900, 3000);
+	CHECK(!result.found);
+	CHECK(result.centerRange == 900);
+	CHECK(result.alert);
+}
+
+void testTrackingPipeline(void)
+{
+	testGroundAtSize(640, 480);
+	testGroundAtSize(320, 240);
+	testGridAtSize(640, 480);
+	testGridAtSize(320, 240);
+	testProximityAlert();
+}
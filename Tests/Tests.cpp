@@ -0,0 +1,78 @@
+// Correctness checks for the TrackerCore modules, on synthetic data so no
+// Kinect is needed. Timing lives in the Benchmark tool, this only answers
+// whether the results are right.
+//
+//   Tests [suite ...]
+//
+// Runs every suite, or only the ones named. Exits with 1 when a check fails.
+//
+// Nothing here is Windows specific, on Linux it builds with
+//   g++ -std=c++11 -O2 -pthread -ITrackerCore TrackerCore/*.cpp Tests/*.cpp -lrt
+// leaving out TrackerCore/dllmain.cpp and TrackerCore/stdafx.cpp.
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Check.h"
+
+typedef struct
+{
+	const char* name;
+	void (*run)(void);
+} Suite;
+
+static const Suite suites[] =
+{
+	{ "registration", testRegistration },
+	{ "localization", testLocalization },
+	{ "pipeline", testTrackingPipeline },
+	{ "codec", testDepthCodec },
+	{ "session", testSessionFile },
+	{ "capi", testTrackerCoreC },
+	{ "display", testDisplayMailbox },
+	{ "gating", testMotionGating },
+	{ "filter", testTargetFilter },
+};
+
+static int failures = 0;
+
+void checkFailed(const char* file, int line, const char* text)
+{
+	printf("  %s:%d: check failed: %s\n", file, line, text);
+	failures++;
+}
+
+void checkFailedNear(const char* file, int line, const char* text, double value, double expected, double tolerance)
+{
+	printf("  %s:%d: check failed: %s is %g, expected %g within %g\n", file, line, text, value, expected, tolerance);
+	failures++;
+}
+
+int main(int argc, char* argv[])
+{
+	int count = sizeof(suites) / sizeof(suites[0]);
+	int ran = 0;
+	for( int i = 0; i < count; i++ )
+	{
+		bool wanted = argc < 2;
+		for( int arg = 1; arg < argc; arg++ )
+			if( !strcmp(argv[arg], suites[i].name) )
+				wanted = true;
+		if( !wanted )
+			continue;
+
+		int before = failures;
+		printf("%s\n", suites[i].name);
+		suites[i].run();
+		printf("  %s\n", failures == before ? "ok" : "FAILED");
+		ran++;
+	}
+
+	if( !ran )
+	{
+		printf("no suite matched\n");
+		return 1;
+	}
+	printf("%d check%s failed\n", failures, failures == 1 ? "" : "s");
+	return failures ? 1 : 0;
+}
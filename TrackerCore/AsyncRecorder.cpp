@@ -0,0 +1,236 @@
+#include "stdafx.h"
+#include "AsyncRecorder.h"
+#include "SessionFile.h"
+#include "Timing.h"
+
+#include <string.h>
+#include <thread>
+#include <atomic>
+#include <chrono>
+
+// How long the writer naps when it finds the ring empty
+#define WRITER_IDLE_MICROSECONDS 2000
+
+typedef struct
+{
+	SessionRecordHeader header;
+	uint8_t* payload;
+} RecorderSlot;
+
+struct AsyncRecorder::State
+{
+	SessionWriter writer;
+	std::thread thread;
+	std::atomic<bool> running;
+	bool compressDepth;
+	double startTime;
+
+	RecorderSlot* slots;
+	uint8_t* storage;
+	uint32_t slotCount;
+	int maxPayload;
+
+	// Free running counters, the producer owns head and the writer owns tail
+	std::atomic<uint32_t> head;
+	std::atomic<uint32_t> tail;
+
+	// Only the producer writes these
+	std::atomic<uint64_t> colorQueued;
+	std::atomic<uint64_t> depthQueued;
+	std::atomic<uint64_t> colorDropped;
+	std::atomic<uint64_t> depthDropped;
+	std::atomic<int> maxQueued;
+
+	// Only the writer writes these
+	std::atomic<uint64_t> written;
+	std::atomic<uint64_t> writeErrors;
+	std::atomic<uint64_t> bytesWritten;
+};
+
+AsyncRecorder::AsyncRecorder()
+{
+	state = new State();
+	state->running = false;
+	state->compressDepth = true;
+	state->startTime = 0.0;
+	state->slots = NULL;
+	state->storage = NULL;
+	state->slotCount = 0;
+	state->maxPayload = 0;
+	state->head = 0;
+	state->tail = 0;
+	return;
+}
+
+AsyncRecorder::~AsyncRecorder()
+{
+	stop();
+	delete state;
+	return;
+}
+
+bool AsyncRecorder::start(const char* path, int slots, int maxPayload, bool compressDepth)
+{
+	stop();
+
+	if( slots < 1 || maxPayload < 1 )
+		return false;
+
+	try
+	{
+		state->slots = new RecorderSlot[slots];
+		state->storage = new uint8_t[(size_t)slots * maxPayload];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for recorder ring: " << ba.what() << std::endl;
+		delete[] state->slots;
+		state->slots = NULL;
+		return false;
+	}
+	for( int i = 0; i < slots; i++ )
+		state->slots[i].payload = &state->storage[(size_t)i * maxPayload];
+
+	if( !state->writer.open(path) )
+	{
+		delete[] state->slots;
+		delete[] state->storage;
+		state->slots = NULL;
+		state->storage = NULL;
+		return false;
+	}
+
+	state->slotCount = slots;
+	state->maxPayload = maxPayload;
+	state->compressDepth = compressDepth;
+	state->startTime = getTimeSeconds();
+	state->head = 0;
+	state->tail = 0;
+	state->colorQueued = state->depthQueued = 0;
+	state->colorDropped = state->depthDropped = 0;
+	state->maxQueued = 0;
+	state->written = state->writeErrors = state->bytesWritten = 0;
+	state->running = true;
+	state->thread = std::thread(writerMain, state);
+	return true;
+}
+
+void AsyncRecorder::stop(void)
+{
+	if( !state->running )
+		return;
+
+	state->running = false;
+	state->thread.join();
+	state->writer.close();
+
+	delete[] state->slots;
+	delete[] state->storage;
+	state->slots = NULL;
+	state->storage = NULL;
+	state->slotCount = 0;
+}
+
+bool AsyncRecorder::isRecording(void) const
+{
+	return state->running;
+}
+
+bool AsyncRecorder::enqueue(uint32_t type, const void* data, int width, int height, int pitch, int size, double timestamp)
+{
+	if( !state->running )
+		return false;
+
+	std::atomic<uint64_t>& dropped = type == SESSION_RECORD_COLOR ? state->colorDropped : state->depthDropped;
+	uint32_t head = state->head.load(std::memory_order_relaxed);
+	uint32_t queued = head - state->tail.load(std::memory_order_acquire);
+	if( queued >= state->slotCount || size > state->maxPayload )
+	{
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	RecorderSlot& slot = state->slots[head % state->slotCount];
+	slot.header.type = type;
+	slot.header.encoding = SESSION_ENCODING_RAW;
+	slot.header.width = width;
+	slot.header.height = height;
+	slot.header.pitch = pitch;
+	slot.header.size = size;
+	slot.header.timestamp = timestamp - state->startTime;
+	memcpy(slot.payload, data, size);
+
+	// Publishing the slot, the writer may pick it up from here on
+	state->head.store(head + 1, std::memory_order_release);
+
+	if( (int)queued + 1 > state->maxQueued.load(std::memory_order_relaxed) )
+		state->maxQueued.store(queued + 1, std::memory_order_relaxed);
+	std::atomic<uint64_t>& counter = type == SESSION_RECORD_COLOR ? state->colorQueued : state->depthQueued;
+	counter.fetch_add(1, std::memory_order_relaxed);
+	return true;
+}
+
+bool AsyncRecorder::recordColor(const uint8_t* color, int width, int height, int pitch, double timestamp)
+{
+	return enqueue(SESSION_RECORD_COLOR, color, width, height, pitch, pitch * height, timestamp);
+}
+
+bool AsyncRecorder::recordDepth(const uint16_t* depth, int width, int height, double timestamp)
+{
+	int pitch = width * sizeof(uint16_t);
+	return enqueue(SESSION_RECORD_DEPTH, depth, width, height, pitch, pitch * height, timestamp);
+}
+
+void AsyncRecorder::writerMain(State* state)
+{
+	for( ;; )
+	{
+		// Read the flag before the ring, so once it reads false the ring
+		// already holds everything the producer will ever queue
+		bool stopping = !state->running.load(std::memory_order_acquire);
+		uint32_t tail = state->tail.load(std::memory_order_relaxed);
+		uint32_t head = state->head.load(std::memory_order_acquire);
+
+		if( tail == head )
+		{
+			if( stopping )
+				return;
+			std::this_thread::sleep_for(std::chrono::microseconds(WRITER_IDLE_MICROSECONDS));
+			continue;
+		}
+
+		for( ; tail != head; tail++ )
+		{
+			RecorderSlot& slot = state->slots[tail % state->slotCount];
+			bool ok;
+			if( slot.header.type == SESSION_RECORD_DEPTH && state->compressDepth )
+				ok = state->writer.writeDepth((const uint16_t*)slot.payload, slot.header.width,
+											  slot.header.height, slot.header.timestamp, true);
+			else
+				ok = state->writer.writeRecord(slot.header, slot.payload);
+
+			if( ok )
+				state->written.fetch_add(1, std::memory_order_relaxed);
+			else
+				state->writeErrors.fetch_add(1, std::memory_order_relaxed);
+			state->bytesWritten.store(state->writer.bytesWritten(), std::memory_order_relaxed);
+
+			// Hand the slot back to the producer
+			state->tail.store(tail + 1, std::memory_order_release);
+		}
+	}
+}
+
+AsyncRecorderStats AsyncRecorder::stats(void) const
+{
+	AsyncRecorderStats result;
+	result.colorQueued = state->colorQueued.load();
+	result.depthQueued = state->depthQueued.load();
+	result.colorDropped = state->colorDropped.load();
+	result.depthDropped = state->depthDropped.load();
+	result.written = state->written.load();
+	result.writeErrors = state->writeErrors.load();
+	result.bytesWritten = state->bytesWritten.load();
+	result.maxQueued = state->maxQueued.load();
+	return result;
+}
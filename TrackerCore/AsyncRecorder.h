@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+
+typedef struct
+{
+	uint64_t colorQueued;
+	uint64_t depthQueued;
+	// Frames turned away because the ring was full or too small for them
+	uint64_t colorDropped;
+	uint64_t depthDropped;
+	uint64_t written;
+	uint64_t writeErrors;
+	uint64_t bytesWritten;
+	// Most slots that were waiting for the writer at once
+	int maxQueued;
+} AsyncRecorderStats;
+
+// Records frames to a session file without ever making the capture thread
+// wait on the disk. record* copies the frame into a slot of a ring that was
+// allocated up front and returns, a writer thread drains the ring, compresses
+// depth and writes it out in large sequential chunks. When the writer falls
+// behind and the ring fills up new frames are dropped and counted.
+//
+// The ring has a single producer and a single consumer: all record* calls
+// must come from one thread.
+class TRACKERCORE_API AsyncRecorder
+{
+public:
+	AsyncRecorder(void);
+	~AsyncRecorder(void);
+
+	// Opens the session file and starts the writer, each slot holds up to maxPayload bytes
+	bool start(const char* path, int slots = 16, int maxPayload = 640 * 480 * 4, bool compressDepth = true);
+
+	// Writes out whatever is still queued and closes the file
+	void stop(void);
+
+	bool isRecording(void) const;
+
+	// Timestamps are getTimeSeconds() values, stored relative to start().
+	// False means the frame was dropped.
+	bool recordColor(const uint8_t* color, int width, int height, int pitch, double timestamp);
+	bool recordDepth(const uint16_t* depth, int width, int height, double timestamp);
+
+	AsyncRecorderStats stats(void) const;
+
+private:
+	struct State;
+	State* state;
+
+	bool enqueue(uint32_t type, const void* data, int width, int height, int pitch, int size, double timestamp);
+	static void writerMain(State* state);
+
+	AsyncRecorder(const AsyncRecorder&);
+	AsyncRecorder& operator=(const AsyncRecorder&);
+};
@@ -0,0 +1,268 @@
+#include "stdafx.h"
+#include "DepthCodec.h"
+#include "Registration.h"
+
+#include <string.h>
+
+static const uint8_t codecMagic[4] = { 'L', 'D', 'C', '1' };
+
+#define TOKEN_RESIDUAL 0
+#define TOKEN_HOLES 1
+#define TOKEN_REPEAT 2
+
+static inline uint8_t* writeVarint(uint8_t* out, uint32_t value)
+{
+	if( value < 0x80 )
+	{
+		*out++ = (uint8_t)value;
+		return out;
+	}
+	while( value >= 0x80 )
+	{
+		*out++ = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	*out++ = (uint8_t)value;
+	return out;
+}
+
+static inline bool readVarint(const uint8_t*& in, const uint8_t* end, uint32_t* value)
+{
+	if( in != end && !(*in & 0x80) )
+	{
+		*value = *in++;
+		return true;
+	}
+
+	uint32_t result = 0;
+	for( int bits = 0; bits < 35; bits += 7 )
+	{
+		if( in == end )
+			return false;
+		uint8_t byte = *in++;
+		result |= (uint32_t)(byte & 0x7F) << bits;
+		if( !(byte & 0x80) )
+		{
+			*value = result;
+			return true;
+		}
+	}
+	return false;
+}
+
+#define FLAG_PLAYERS 1
+
+static inline uint8_t* writeRun(uint8_t* out, int type, uint32_t length)
+{
+	// A lone repeat goes out as a zero residual, the same byte, which keeps
+	// the decoder on its residual path
+	if( type == TOKEN_REPEAT && length == 1 )
+		return writeVarint(out, TOKEN_RESIDUAL);
+	return writeVarint(out, ((length - 1) << 2) | type);
+}
+
+size_t depthCodecMaxEncodedSize(int width, int height)
+{
+	// A residual is at most 14 bits of zigzag plus the tag, three varint
+	// bytes, and a player index run at least one byte per pixel
+	return DEPTH_CODEC_HEADER_SIZE + (size_t)width * height * 4;
+}
+
+static uint8_t* encodePlayers(const uint16_t* depth, int pixels, uint8_t* out)
+{
+	const int mask = (1 << DEPTH_PLAYER_INDEX_SHIFT) - 1;
+	int i = 0;
+	while( i < pixels )
+	{
+		int player = depth[i] & mask;
+		int start = i++;
+		while( i < pixels && (depth[i] & mask) == player )
+			i++;
+		out = writeVarint(out, ((uint32_t)(i - start - 1) << DEPTH_PLAYER_INDEX_SHIFT) | player);
+	}
+	return out;
+}
+
+size_t encodeDepthFrame(const uint16_t* depth, int width, int height, uint8_t* encoded, size_t capacity)
+{
+	if( width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF ||
+		capacity < depthCodecMaxEncodedSize(width, height) )
+		return 0;
+
+	uint8_t* out = encoded;
+	memcpy(out, codecMagic, sizeof(codecMagic));
+	out[4] = (uint8_t)(width & 0xFF);
+	out[5] = (uint8_t)(width >> 8);
+	out[6] = (uint8_t)(height & 0xFF);
+	out[7] = (uint8_t)(height >> 8);
+	out[8] = DEPTH_PLAYER_INDEX_SHIFT;
+	out[9] = 0;
+	out += DEPTH_CODEC_HEADER_SIZE;
+
+	int last = 0;
+	int runType = -1;
+	uint32_t runLength = 0;
+	uint16_t lowBits = 0;
+
+	for( int y = 0; y < height; y++ )
+	{
+		const uint16_t* row = &depth[y * width];
+		// A reading at the start of a row is predicted from the one above it
+		if( y > 0 && (row[0] >> DEPTH_PLAYER_INDEX_SHIFT) && (row[-width] >> DEPTH_PLAYER_INDEX_SHIFT) )
+			last = row[-width] >> DEPTH_PLAYER_INDEX_SHIFT;
+
+		for( int x = 0; x < width; x++ )
+		{
+			lowBits |= row[x];
+			int value = row[x] >> DEPTH_PLAYER_INDEX_SHIFT;
+			int type = TOKEN_HOLES;
+			int residual = 0;
+
+			if( value )
+			{
+				residual = value - last;
+				type = residual ? TOKEN_RESIDUAL : TOKEN_REPEAT;
+				last = value;
+			}
+
+			if( type == runType )
+			{
+				runLength++;
+				continue;
+			}
+			if( runLength )
+			{
+				out = writeRun(out, runType, runLength);
+				runLength = 0;
+				runType = -1;
+			}
+
+			if( type == TOKEN_RESIDUAL )
+			{
+				uint32_t zigzag = ((uint32_t)residual << 1) ^ (uint32_t)(residual >> 31);
+				out = writeVarint(out, (zigzag << 2) | TOKEN_RESIDUAL);
+			}
+			else
+			{
+				runType = type;
+				runLength = 1;
+			}
+		}
+	}
+	if( runLength )
+		out = writeRun(out, runType, runLength);
+
+	if( lowBits & ((1 << DEPTH_PLAYER_INDEX_SHIFT) - 1) )
+	{
+		encoded[9] = FLAG_PLAYERS;
+		out = encodePlayers(depth, width * height, out);
+	}
+
+	return out - encoded;
+}
+
+bool readDepthFrameHeader(const uint8_t* encoded, size_t size, int* width, int* height)
+{
+	if( size < DEPTH_CODEC_HEADER_SIZE || memcmp(encoded, codecMagic, sizeof(codecMagic)) )
+		return false;
+	*width = encoded[4] | (encoded[5] << 8);
+	*height = encoded[6] | (encoded[7] << 8);
+	return true;
+}
+
+static bool decodePlayers(const uint8_t*& in, const uint8_t* end, uint16_t* depth, int pixels)
+{
+	int i = 0;
+	while( i < pixels )
+	{
+		uint32_t token;
+		if( !readVarint(in, end, &token) )
+			return false;
+		uint32_t run = token >> DEPTH_PLAYER_INDEX_SHIFT;
+		uint16_t player = (uint16_t)(token & ((1 << DEPTH_PLAYER_INDEX_SHIFT) - 1));
+		if( run >= (uint32_t)(pixels - i) )
+			return false;
+		if( player )
+			for( uint32_t n = 0; n <= run; n++ )
+				depth[i + n] |= player;
+		i += run + 1;
+	}
+	return true;
+}
+
+bool decodeDepthFrame(const uint8_t* encoded, size_t size, uint16_t* depth, int width, int height)
+{
+	int frameWidth, frameHeight;
+	if( !readDepthFrameHeader(encoded, size, &frameWidth, &frameHeight) ||
+		frameWidth != width || frameHeight != height )
+		return false;
+
+	// Frames from before the player index stream was split off are coded
+	// with a shift of zero when any pixel had player bits
+	int shift = encoded[8];
+	int flags = encoded[9];
+	if( (shift != 0 && shift != DEPTH_PLAYER_INDEX_SHIFT) || (flags & ~FLAG_PLAYERS) ||
+		((flags & FLAG_PLAYERS) && !shift) )
+		return false;
+	// Largest reading in coded units
+	int64_t limit = 0xFFFF >> shift;
+
+	const uint8_t* in = encoded + DEPTH_CODEC_HEADER_SIZE;
+	const uint8_t* end = encoded + size;
+	int pixels = width * height;
+	int last = 0;
+	int i = 0;
+	int x = 0;
+
+	while( i < pixels )
+	{
+		uint32_t token;
+		if( !readVarint(in, end, &token) )
+			return false;
+
+		int type = token & 3;
+		uint32_t payload = token >> 2;
+		if( type == TOKEN_RESIDUAL )
+		{
+			if( x == 0 && i >= width && depth[i - width] )
+				last = depth[i - width] >> shift;
+			// Wide enough that no payload can overflow before the range check
+			int64_t residual = (int64_t)(payload >> 1) ^ -(int64_t)(payload & 1);
+			int64_t value = last + residual;
+			if( value <= 0 || value > limit )
+				return false;
+			last = (int)value;
+			depth[i++] = (uint16_t)(last << shift);
+			if( ++x == width )
+				x = 0;
+			continue;
+		}
+		if( type != TOKEN_HOLES && type != TOKEN_REPEAT )
+			return false;
+		if( payload >= (uint32_t)(pixels - i) )
+			return false;
+
+		uint32_t count = payload + 1;
+		if( type == TOKEN_HOLES )
+		{
+			memset(&depth[i], 0, count * sizeof(uint16_t));
+			i += count;
+			x = (int)((x + count) % width);
+			continue;
+		}
+		for( uint32_t n = 0; n < count; n++ )
+		{
+			if( x == 0 && i >= width && depth[i - width] )
+				last = depth[i - width] >> shift;
+			if( !last )
+				return false;
+			depth[i++] = (uint16_t)(last << shift);
+			if( ++x == width )
+				x = 0;
+		}
+	}
+
+	if( (flags & FLAG_PLAYERS) && !decodePlayers(in, end, depth, pixels) )
+		return false;
+	return in == end;
+}
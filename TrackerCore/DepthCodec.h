@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+
+// Lossless codec for 16 bit Kinect depth frames, built for logging every
+// frame at 30 Hz. Pixels are scanned in raster order and predicted from the
+// last reading (or from the pixel above at the start of a row). The stream is
+// a sequence of LEB128 varints, each tagged in its two low bits:
+//   0  zigzag residual against the prediction
+//   1  run of holes
+//   2  run of pixels equal to the prediction
+// Holes never disturb the prediction, so a surface picks up where it left
+// off on the far side of a dropout. Only the millimeters are predicted, the
+// player index bits are dropped before coding. When any pixel has them set
+// they follow as a second stream of varints, each a run of one index with
+// the index in its three low bits.
+
+// Bytes before the coded pixels: magic, width, height, shift and flags
+#define DEPTH_CODEC_HEADER_SIZE 10
+
+// Largest buffer encodeDepthFrame can need for a frame of this size
+TRACKERCORE_API size_t depthCodecMaxEncodedSize(int width, int height);
+
+// Returns the encoded size in bytes, zero if the output buffer is too small
+TRACKERCORE_API size_t encodeDepthFrame(const uint16_t* depth, int width, int height,
+										uint8_t* encoded, size_t capacity);
+
+// Reads the frame size from an encoded frame, false if it is not one
+TRACKERCORE_API bool readDepthFrameHeader(const uint8_t* encoded, size_t size, int* width, int* height);
+
+// Decodes a frame of the given size, false if the data is corrupt or the sizes do not match
+TRACKERCORE_API bool decodeDepthFrame(const uint8_t* encoded, size_t size, uint16_t* depth,
+									  int width, int height);
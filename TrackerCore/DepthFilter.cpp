@@ -0,0 +1,211 @@
+#include "stdafx.h"
+#include "DepthFilter.h"
+
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define DEPTH_FILTER_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define DEPTH_FILTER_AVX2
+#include <immintrin.h>
+#endif
+
+DepthFilter::DepthFilter()
+{
+	frameWidth = frameHeight = 0;
+	maxGap = 0;
+	useSimd = true;
+	ring = NULL;
+	ringHead = 0;
+	framesSeen = 0;
+	return;
+}
+
+DepthFilter::~DepthFilter()
+{
+	delete[] ring;
+	return;
+}
+
+bool DepthFilter::initialize(int width, int height, int maxHoleGap)
+{
+	delete[] ring;
+	ring = NULL;
+	frameWidth = width;
+	frameHeight = height;
+	maxGap = maxHoleGap;
+	reset();
+
+	try
+	{
+		ring = new uint16_t[width * height * DEPTH_FILTER_HISTORY];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for depth history: " << ba.what() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void DepthFilter::reset(void)
+{
+	ringHead = 0;
+	framesSeen = 0;
+}
+
+// Holes are mapped to 0xFFFF so they sort last, then the median is taken
+// unless it is a hole, in which case the nearest valid reading is used:
+//   one hole    -> farther of the two readings
+//   two holes   -> the only reading
+//   three holes -> hole
+static inline uint16_t medianOfThree(uint16_t a, uint16_t b, uint16_t c)
+{
+	uint16_t x = a ? a : 0xFFFF;
+	uint16_t y = b ? b : 0xFFFF;
+	uint16_t z = c ? c : 0xFFFF;
+	uint16_t low = x < y ? x : y;
+	uint16_t high = x < y ? y : x;
+	uint16_t median = high < z ? high : z;
+	median = low > median ? low : median;
+	uint16_t least = low < z ? low : z;
+	uint16_t result = median != 0xFFFF ? median : least;
+	return result != 0xFFFF ? result : 0;
+}
+
+void DepthFilter::temporalMedian(uint16_t* filtered) const
+{
+	int pixels = frameWidth * frameHeight;
+	const uint16_t* a = &ring[0];
+	const uint16_t* b = &ring[pixels];
+	const uint16_t* c = &ring[pixels * 2];
+	int i = 0;
+
+	if( useSimd )
+	{
+#ifdef DEPTH_FILTER_AVX2
+		// Same steps as the SSE2 loop below
+		const __m256i zero256 = _mm256_setzero_si256();
+		const __m256i bias256 = _mm256_set1_epi16((short)0x8000);
+		const __m256i ones256 = _mm256_cmpeq_epi16(zero256, zero256);
+		for( ; i + 16 <= pixels; i += 16 )
+		{
+			__m256i x = _mm256_loadu_si256((const __m256i*)&a[i]);
+			__m256i y = _mm256_loadu_si256((const __m256i*)&b[i]);
+			__m256i z = _mm256_loadu_si256((const __m256i*)&c[i]);
+			x = _mm256_xor_si256(_mm256_or_si256(x, _mm256_cmpeq_epi16(x, zero256)), bias256);
+			y = _mm256_xor_si256(_mm256_or_si256(y, _mm256_cmpeq_epi16(y, zero256)), bias256);
+			z = _mm256_xor_si256(_mm256_or_si256(z, _mm256_cmpeq_epi16(z, zero256)), bias256);
+			__m256i low = _mm256_min_epi16(x, y);
+			__m256i high = _mm256_max_epi16(x, y);
+			__m256i median = _mm256_max_epi16(low, _mm256_min_epi16(high, z));
+			__m256i least = _mm256_min_epi16(low, z);
+			median = _mm256_xor_si256(median, bias256);
+			least = _mm256_xor_si256(least, bias256);
+			__m256i empty = _mm256_cmpeq_epi16(median, ones256);
+			__m256i result = _mm256_or_si256(_mm256_andnot_si256(empty, median), _mm256_and_si256(empty, least));
+			result = _mm256_andnot_si256(_mm256_cmpeq_epi16(result, ones256), result);
+			_mm256_storeu_si256((__m256i*)&filtered[i], result);
+		}
+#endif
+#ifdef DEPTH_FILTER_SSE2
+		// SSE2 only has signed 16 bit min and max, flipping the top bit
+		// maps the unsigned order onto the signed one
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i bias = _mm_set1_epi16((short)0x8000);
+		const __m128i ones = _mm_cmpeq_epi16(zero, zero);
+		for( ; i + 8 <= pixels; i += 8 )
+		{
+			__m128i x = _mm_loadu_si128((const __m128i*)&a[i]);
+			__m128i y = _mm_loadu_si128((const __m128i*)&b[i]);
+			__m128i z = _mm_loadu_si128((const __m128i*)&c[i]);
+			x = _mm_xor_si128(_mm_or_si128(x, _mm_cmpeq_epi16(x, zero)), bias);
+			y = _mm_xor_si128(_mm_or_si128(y, _mm_cmpeq_epi16(y, zero)), bias);
+			z = _mm_xor_si128(_mm_or_si128(z, _mm_cmpeq_epi16(z, zero)), bias);
+			__m128i low = _mm_min_epi16(x, y);
+			__m128i high = _mm_max_epi16(x, y);
+			__m128i median = _mm_max_epi16(low, _mm_min_epi16(high, z));
+			__m128i least = _mm_min_epi16(low, z);
+			median = _mm_xor_si128(median, bias);
+			least = _mm_xor_si128(least, bias);
+			__m128i empty = _mm_cmpeq_epi16(median, ones);
+			__m128i result = _mm_or_si128(_mm_andnot_si128(empty, median), _mm_and_si128(empty, least));
+			result = _mm_andnot_si128(_mm_cmpeq_epi16(result, ones), result);
+			_mm_storeu_si128((__m128i*)&filtered[i], result);
+		}
+#endif
+	}
+
+	for( ; i < pixels; i++ )
+		filtered[i] = medianOfThree(a[i], b[i], c[i]);
+}
+
+void DepthFilter::fillRowHoles(uint16_t* row) const
+{
+	int x = 0;
+
+	while( x < frameWidth )
+	{
+#ifdef DEPTH_FILTER_SSE2
+		// Most of a row has no holes, skip eight readings at a time
+		if( useSimd )
+		{
+			const __m128i zero = _mm_setzero_si128();
+			while( x + 8 <= frameWidth &&
+				   !_mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)&row[x]), zero)) )
+				x += 8;
+		}
+#endif
+		if( x >= frameWidth )
+			break;
+		if( row[x] )
+		{
+			x++;
+			continue;
+		}
+
+		int start = x;
+		while( x < frameWidth && !row[x] )
+			x++;
+
+		// Only bridge gaps with a reading on both sides
+		if( start == 0 || x == frameWidth || x - start > maxGap )
+			continue;
+
+		uint16_t left = row[start - 1];
+		uint16_t right = row[x];
+		uint16_t fill = left > right ? left : right;
+		for( int i = start; i < x; i++ )
+			row[i] = fill;
+	}
+}
+
+void DepthFilter::filter(const uint16_t* depth, uint16_t* filtered)
+{
+	if( ring == NULL )
+	{
+		std::cerr << "DepthFilter::filter called before initialize" << std::endl;
+		return;
+	}
+
+	int pixels = frameWidth * frameHeight;
+	uint16_t* slot = &ring[ringHead * pixels];
+	memcpy(slot, depth, pixels * sizeof(uint16_t));
+	ringHead = (ringHead + 1) % DEPTH_FILTER_HISTORY;
+
+	// Until the history fills the missing frames are copies of the first one
+	if( framesSeen == 0 )
+	{
+		for( int i = 1; i < DEPTH_FILTER_HISTORY; i++ )
+			memcpy(&ring[((ringHead + i - 1) % DEPTH_FILTER_HISTORY) * pixels], depth, pixels * sizeof(uint16_t));
+	}
+	framesSeen++;
+
+	temporalMedian(filtered);
+
+	if( maxGap > 0 )
+		for( int y = 0; y < frameHeight; y++ )
+			fillRowHoles(&filtered[y * frameWidth]);
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+
+// Frames kept for the temporal median
+#define DEPTH_FILTER_HISTORY 3
+
+// Cleans up raw Kinect depth before anything probes it. Each pixel becomes
+// the median of its last three readings with holes sorted to the far end, so
+// one dropout or speckle is voted out and a pixel is only a hole when it
+// was empty in all three frames. Short runs of holes left along a row are
+// then bridged with the farther of the two readings either side, which keeps
+// foreground objects from growing into the gap.
+//
+// The temporal pass works on eight (SSE2) or sixteen (AVX2 builds) depth
+// words at a time and the history lives in a ring allocated once.
+class TRACKERCORE_API DepthFilter
+{
+public:
+	DepthFilter(void);
+	~DepthFilter(void);
+
+	// Gaps longer than maxHoleGap pixels are left as holes, zero disables the spatial pass
+	bool initialize(int width, int height, int maxHoleGap = 8);
+
+	// Filters one frame, input and output may be the same buffer
+	void filter(const uint16_t* depth, uint16_t* filtered);
+
+	// Drops the history, the next frame is used as is
+	void reset(void);
+
+	// Falls back to the scalar loops, used to check the vector paths
+	void setUseSimd(bool enable) { useSimd = enable; }
+
+private:
+	int frameWidth;
+	int frameHeight;
+	int maxGap;
+	bool useSimd;
+
+	// DEPTH_FILTER_HISTORY frames back to back, newest at ringHead
+	uint16_t* ring;
+	int ringHead;
+	int framesSeen;
+
+	void temporalMedian(uint16_t* filtered) const;
+	void fillRowHoles(uint16_t* row) const;
+
+	DepthFilter(const DepthFilter&);
+	DepthFilter& operator=(const DepthFilter&);
+};
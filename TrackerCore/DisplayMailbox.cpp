@@ -0,0 +1,150 @@
+#include "stdafx.h"
+#include "DisplayMailbox.h"
+
+#include <string.h>
+#include <atomic>
+
+// Set in the shared index while it holds a frame the consumer has not taken
+#define MAILBOX_FRESH 4u
+#define MAILBOX_INDEX 3u
+
+RateLimiter::RateLimiter(double maxRate)
+{
+	next = 0.0;
+	setRate(maxRate);
+	return;
+}
+
+void RateLimiter::setRate(double maxRate)
+{
+	interval = maxRate > 0.0 ? 1.0 / maxRate : 0.0;
+}
+
+bool RateLimiter::ready(double now)
+{
+	if( interval <= 0.0 )
+		return true;
+	if( now < next )
+		return false;
+	next += interval;
+	if( next <= now )
+		next = now + interval;
+	return true;
+}
+
+double RateLimiter::wait(double now) const
+{
+	if( interval <= 0.0 || now >= next )
+		return 0.0;
+	return next - now;
+}
+
+struct DisplayMailbox::State
+{
+	uint8_t* pixels;
+	DisplayOverlay overlays[3];
+
+	// Producer owns back, consumer owns front, the third index is shared
+	uint32_t back;
+	uint32_t front;
+	std::atomic<uint32_t> middle;
+
+	std::atomic<uint64_t> published;
+	std::atomic<uint64_t> shown;
+	std::atomic<uint64_t> skipped;
+};
+
+DisplayMailbox::DisplayMailbox()
+{
+	state = new State();
+	state->pixels = NULL;
+	state->back = 0;
+	state->middle = 1;
+	state->front = 2;
+	state->published = state->shown = state->skipped = 0;
+	frameWidth = frameHeight = 0;
+	return;
+}
+
+DisplayMailbox::~DisplayMailbox()
+{
+	delete[] state->pixels;
+	delete state;
+	return;
+}
+
+bool DisplayMailbox::initialize(int width, int height)
+{
+	delete[] state->pixels;
+	state->pixels = NULL;
+	frameWidth = frameHeight = 0;
+
+	try
+	{
+		state->pixels = new uint8_t[(size_t)width * height * 4 * 3];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for display buffers: " << ba.what() << std::endl;
+		return false;
+	}
+	memset(state->pixels, 0, (size_t)width * height * 4 * 3);
+	memset(state->overlays, 0, sizeof(state->overlays));
+	frameWidth = width;
+	frameHeight = height;
+	state->back = 0;
+	state->middle = 1;
+	state->front = 2;
+	state->published = state->shown = state->skipped = 0;
+	return true;
+}
+
+uint8_t* DisplayMailbox::backBuffer(void)
+{
+	if( !state->pixels )
+		return NULL;
+	return &state->pixels[(size_t)state->back * frameWidth * frameHeight * 4];
+}
+
+DisplayOverlay* DisplayMailbox::backOverlay(void)
+{
+	return &state->overlays[state->back];
+}
+
+void DisplayMailbox::publish(void)
+{
+	uint32_t previous = state->middle.exchange(state->back | MAILBOX_FRESH, std::memory_order_acq_rel);
+	if( previous & MAILBOX_FRESH )
+		state->skipped.fetch_add(1, std::memory_order_relaxed);
+	state->back = previous & MAILBOX_INDEX;
+	state->published.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool DisplayMailbox::acquire(const uint8_t** pixels, const DisplayOverlay** overlay)
+{
+	if( !state->pixels || !(state->middle.load(std::memory_order_relaxed) & MAILBOX_FRESH) )
+		return false;
+
+	uint32_t previous = state->middle.exchange(state->front, std::memory_order_acq_rel);
+	state->front = previous & MAILBOX_INDEX;
+	state->shown.fetch_add(1, std::memory_order_relaxed);
+
+	*pixels = &state->pixels[(size_t)state->front * frameWidth * frameHeight * 4];
+	*overlay = &state->overlays[state->front];
+	return true;
+}
+
+uint64_t DisplayMailbox::published(void) const
+{
+	return state->published.load(std::memory_order_relaxed);
+}
+
+uint64_t DisplayMailbox::shown(void) const
+{
+	return state->shown.load(std::memory_order_relaxed);
+}
+
+uint64_t DisplayMailbox::skipped(void) const
+{
+	return state->skipped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+
+#define DISPLAY_MAX_TARGETS 2
+
+typedef struct
+{
+	bool found;
+	// Centroid in image pixels
+	float x, y;
+	// Radius of the circle drawn around the target, 0 when the tracker does not report it
+	float radius;
+	// Bounding box in image pixels, inclusive, only when hasBox is set
+	bool hasBox;
+	int left, top, right, bottom;
+} DisplayTarget;
+
+// What the tracker found in a frame, drawn over the image instead of into it
+typedef struct
+{
+	uint32_t frame;
+	double timestamp;
+	int targetCount;
+	DisplayTarget targets[DISPLAY_MAX_TARGETS];
+} DisplayOverlay;
+
+// Lets a display run no faster than a set rate. ready() says whether a
+// frame may be shown now and books the slot; a display that fell behind
+// picks up from now instead of bursting to catch up.
+class TRACKERCORE_API RateLimiter
+{
+public:
+	RateLimiter(double maxRate = 30.0);
+
+	// Frames per second, 0 for no limit
+	void setRate(double maxRate);
+
+	bool ready(double now);
+	// Seconds until ready() will say yes, 0 if it would now
+	double wait(double now) const;
+
+private:
+	double interval;
+	double next;
+};
+
+// Hands the newest frame from the tracking thread to the display thread
+// without either one ever waiting for the other. Three buffers rotate:
+// the tracker fills the back one and publishes it, the display takes
+// whatever was published last. Frames published while the display was busy
+// are overwritten and counted as skipped, never queued.
+//
+// One producer thread and one consumer thread.
+class TRACKERCORE_API DisplayMailbox
+{
+public:
+	DisplayMailbox(void);
+	~DisplayMailbox(void);
+
+	bool initialize(int width, int height);
+
+	int width(void) const { return frameWidth; }
+	int height(void) const { return frameHeight; }
+	// Bytes per row, images are 4 bytes per pixel
+	int pitch(void) const { return frameWidth * 4; }
+
+	// Producer: fill these, then publish()
+	uint8_t* backBuffer(void);
+	DisplayOverlay* backOverlay(void);
+	void publish(void);
+
+	// Consumer: the newest frame if one was published since the last call.
+	// The frame stays valid until the next successful acquire.
+	bool acquire(const uint8_t** pixels, const DisplayOverlay** overlay);
+
+	uint64_t published(void) const;
+	uint64_t shown(void) const;
+	uint64_t skipped(void) const;
+
+private:
+	struct State;
+	State* state;
+	int frameWidth, frameHeight;
+
+	DisplayMailbox(const DisplayMailbox&);
+	DisplayMailbox& operator=(const DisplayMailbox&);
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+
+typedef struct
+{
+	// ARGB pixels, NULL when the frame has no color image
+	const uint8_t* color;
+	// Bytes per color row
+	int colorPitch;
+	int colorWidth, colorHeight;
+	double colorTimestamp;
+
+	// Raw NUI depth, NULL when the frame has no depth image
+	const uint16_t* depth;
+	int depthWidth, depthHeight;
+	double depthTimestamp;
+
+	// Position of the frame in its stream, counting from zero
+	uint32_t index;
+} Frame;
+
+// Anything that hands out paired color and depth frames, a live sensor, a
+// recorded session or a synthetic scene. The pointers in a frame belong to
+// the source and stay valid until the next call to nextFrame.
+class TRACKERCORE_API FrameSource
+{
+public:
+	virtual ~FrameSource(void) {}
+
+	// Fills in the next frame, false at the end of the stream or on error
+	virtual bool nextFrame(Frame* frame) = 0;
+
+	// Starts the stream again from the first frame, false if the source cannot
+	virtual bool rewind(void) { return false; }
+};
@@ -0,0 +1,418 @@
+#include "stdafx.h"
+#include "GroundPlane.h"
+#include "Timing.h"
+
+#include <math.h>
+#include <string.h>
+
+#define MILLIMETERS_PER_METER 1000.0f
+
+void getDefaultGroundPlaneConfig(GroundPlaneConfig* config)
+{
+	config->sampleStride = 4;
+	config->inlierThreshold = 0.02f;
+	config->minIterations = 8;
+	config->maxIterations = 200;
+	config->confidence = 0.99f;
+	config->maxTilt = 0.8f;
+	config->seed = 0x4C554E41;
+}
+
+// Small hash so that every hypothesis index gets an unrelated sequence
+static uint32_t mixSeed(uint32_t value)
+{
+	value ^= value >> 16;
+	value *= 0x7FEB352D;
+	value ^= value >> 15;
+	value *= 0x846CA68B;
+	value ^= value >> 16;
+	return value ? value : 1;
+}
+
+static uint32_t nextRandom(uint32_t* state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+GroundPlaneEstimator::GroundPlaneEstimator()
+{
+	memset(&camera, 0, sizeof(camera));
+	getDefaultGroundPlaneConfig(&settings);
+	workers = NULL;
+	shift = DEPTH_PLAYER_INDEX_SHIFT;
+	chunks = 1;
+	rays = NULL;
+	pointX = pointY = pointZ = NULL;
+	pointCount = pointCapacity = 0;
+	chunkPlane = NULL;
+	chunkInliers = NULL;
+	chunkIndex = NULL;
+	memset(&currentPlane, 0, sizeof(currentPlane));
+	memset(&lastStats, 0, sizeof(lastStats));
+	havePlane = false;
+	frameNumber = 0;
+	heightMap = NULL;
+	frame = NULL;
+	hypothesisCount = 0;
+	return;
+}
+
+GroundPlaneEstimator::~GroundPlaneEstimator()
+{
+	release();
+	return;
+}
+
+void GroundPlaneEstimator::release(void)
+{
+	delete[] rays;
+	delete[] pointX;
+	delete[] pointY;
+	delete[] pointZ;
+	delete[] chunkPlane;
+	delete[] chunkInliers;
+	delete[] chunkIndex;
+	delete[] heightMap;
+	rays = NULL;
+	pointX = pointY = pointZ = NULL;
+	chunkPlane = NULL;
+	chunkInliers = NULL;
+	chunkIndex = NULL;
+	heightMap = NULL;
+	pointCapacity = 0;
+}
+
+bool GroundPlaneEstimator::initialize(const CameraIntrinsics& depthCamera, const GroundPlaneConfig& config,
+									  WorkerPool* pool, int depthShift)
+{
+	release();
+	reset();
+
+	camera = depthCamera;
+	settings = config;
+	workers = pool;
+	shift = depthShift;
+	chunks = pool ? pool->size() : 1;
+	if( settings.sampleStride < 1 )
+		settings.sampleStride = 1;
+	if( settings.maxIterations < settings.minIterations )
+		settings.maxIterations = settings.minIterations;
+
+	int pixels = camera.width * camera.height;
+	pointCapacity = ((camera.width + settings.sampleStride - 1) / settings.sampleStride) *
+					((camera.height + settings.sampleStride - 1) / settings.sampleStride);
+	try
+	{
+		rays = new float[pixels * 2];
+		pointX = new float[pointCapacity];
+		pointY = new float[pointCapacity];
+		pointZ = new float[pointCapacity];
+		chunkPlane = new GroundPlane[chunks];
+		chunkInliers = new int[chunks];
+		chunkIndex = new int[chunks];
+		heightMap = new float[pixels];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for ground plane: " << ba.what() << std::endl;
+		release();
+		return false;
+	}
+
+	for( int v = 0; v < camera.height; v++ )
+	{
+		for( int u = 0; u < camera.width; u++ )
+		{
+			float* ray = &rays[(v * camera.width + u) * 2];
+			ray[0] = (u - camera.cx) / camera.fx;
+			ray[1] = (v - camera.cy) / camera.fy;
+		}
+	}
+	return true;
+}
+
+void GroundPlaneEstimator::reset(void)
+{
+	havePlane = false;
+	frameNumber = 0;
+}
+
+int GroundPlaneEstimator::countInliers(const GroundPlane& plane) const
+{
+	int inliers = 0;
+	float threshold = settings.inlierThreshold;
+
+	for( int i = 0; i < pointCount; i++ )
+	{
+		float distance = plane.a * pointX[i] + plane.b * pointY[i] + plane.c * pointZ[i] + plane.d;
+		inliers += fabsf(distance) < threshold;
+	}
+	return inliers;
+}
+
+// Normalizes the plane and turns its normal toward the sensor at the origin,
+// false if it is degenerate or tilted further than allowed from the -y axis
+static bool orientPlane(GroundPlane* plane, float maxTilt)
+{
+	float length = sqrtf(plane->a * plane->a + plane->b * plane->b + plane->c * plane->c);
+	if( length < 1e-9f )
+		return false;
+
+	float scale = (plane->d < 0.0f ? -1.0f : 1.0f) / length;
+	plane->a *= scale;
+	plane->b *= scale;
+	plane->c *= scale;
+	plane->d *= scale;
+
+	// Camera y points down, so the floor normal is close to -y
+	return -plane->b >= cosf(maxTilt);
+}
+
+bool GroundPlaneEstimator::hypothesis(int index, GroundPlane* plane) const
+{
+	uint32_t state = mixSeed(settings.seed ^ mixSeed(frameNumber) ^ ((uint32_t)index * 0x9E3779B9u));
+	int i0 = nextRandom(&state) % pointCount;
+	int i1 = nextRandom(&state) % pointCount;
+	int i2 = nextRandom(&state) % pointCount;
+	if( i0 == i1 || i1 == i2 || i0 == i2 )
+		return false;
+
+	float ux = pointX[i1] - pointX[i0];
+	float uy = pointY[i1] - pointY[i0];
+	float uz = pointZ[i1] - pointZ[i0];
+	float vx = pointX[i2] - pointX[i0];
+	float vy = pointY[i2] - pointY[i0];
+	float vz = pointZ[i2] - pointZ[i0];
+
+	plane->a = uy * vz - uz * vy;
+	plane->b = uz * vx - ux * vz;
+	plane->c = ux * vy - uy * vx;
+	plane->d = -(plane->a * pointX[i0] + plane->b * pointY[i0] + plane->c * pointZ[i0]);
+	return orientPlane(plane, settings.maxTilt);
+}
+
+// Least squares fit of y = p * x + q * z + r over the inliers. The floor
+// normal is close to the camera y axis, so y is a safe dependent variable.
+bool GroundPlaneEstimator::refine(GroundPlane* plane) const
+{
+	double sxx = 0, sxz = 0, szz = 0, sx = 0, sz = 0, n = 0;
+	double sxy = 0, szy = 0, sy = 0;
+	float threshold = settings.inlierThreshold;
+
+	for( int i = 0; i < pointCount; i++ )
+	{
+		float x = pointX[i], y = pointY[i], z = pointZ[i];
+		float distance = plane->a * x + plane->b * y + plane->c * z + plane->d;
+		if( fabsf(distance) >= threshold )
+			continue;
+		sxx += x * x; sxz += x * z; szz += z * z;
+		sx += x; sz += z; n += 1;
+		sxy += x * y; szy += z * y; sy += y;
+	}
+	if( n < 3 )
+		return false;
+
+	// Cramer's rule on the 3x3 normal equations
+	double det = sxx * (szz * n - sz * sz) - sxz * (sxz * n - sz * sx) + sx * (sxz * sz - szz * sx);
+	if( fabs(det) < 1e-12 )
+		return false;
+	double p = (sxy * (szz * n - sz * sz) - sxz * (szy * n - sz * sy) + sx * (szy * sz - szz * sy)) / det;
+	double q = (sxx * (szy * n - sy * sz) - sxy * (sxz * n - sz * sx) + sx * (sxz * sy - szy * sx)) / det;
+	double r = (sxx * (szz * sy - sz * szy) - sxz * (sxz * sy - sx * szy) + sxy * (sxz * sz - szz * sx)) / det;
+
+	GroundPlane fitted;
+	fitted.a = (float)p;
+	fitted.b = -1.0f;
+	fitted.c = (float)q;
+	fitted.d = (float)r;
+	if( !orientPlane(&fitted, settings.maxTilt) )
+		return false;
+	*plane = fitted;
+	return true;
+}
+
+void GroundPlaneEstimator::searchTask(void* context, int index)
+{
+	((GroundPlaneEstimator*)context)->searchChunk(index);
+}
+
+void GroundPlaneEstimator::heightTask(void* context, int index)
+{
+	((GroundPlaneEstimator*)context)->heightBand(index);
+}
+
+void GroundPlaneEstimator::searchChunk(int chunk)
+{
+	int perChunk = (hypothesisCount + chunks - 1) / chunks;
+	int first = chunk * perChunk;
+	int last = first + perChunk < hypothesisCount ? first + perChunk : hypothesisCount;
+
+	chunkInliers[chunk] = -1;
+	chunkIndex[chunk] = -1;
+	for( int i = first; i < last; i++ )
+	{
+		GroundPlane candidate;
+		if( !hypothesis(i, &candidate) )
+			continue;
+		int inliers = countInliers(candidate);
+		if( inliers > chunkInliers[chunk] )
+		{
+			chunkInliers[chunk] = inliers;
+			chunkIndex[chunk] = i;
+			chunkPlane[chunk] = candidate;
+		}
+	}
+}
+
+void GroundPlaneEstimator::heightBand(int band)
+{
+	int rowsPerBand = (camera.height + chunks - 1) / chunks;
+	int top = band * rowsPerBand;
+	int bottom = top + rowsPerBand < camera.height ? top + rowsPerBand : camera.height;
+	const GroundPlane& p = currentPlane;
+
+	for( int v = top; v < bottom; v++ )
+	{
+		const uint16_t* row = &frame[v * camera.width];
+		const float* ray = &rays[v * camera.width * 2];
+		float* out = &heightMap[v * camera.width];
+		for( int u = 0; u < camera.width; u++ )
+		{
+			int mm = row[u] >> shift;
+			float z = mm / MILLIMETERS_PER_METER;
+			float height = z * (p.a * ray[2 * u] + p.b * ray[2 * u + 1] + p.c) + p.d;
+			out[u] = mm ? height : GROUND_HEIGHT_UNKNOWN;
+		}
+	}
+}
+
+bool GroundPlaneEstimator::estimate(const uint16_t* depth)
+{
+	if( rays == NULL )
+	{
+		std::cerr << "GroundPlaneEstimator::estimate called before initialize" << std::endl;
+		return false;
+	}
+
+	double start = getTimeSeconds();
+	frame = depth;
+	frameNumber++;
+
+	// Subsample the frame into points in meters
+	pointCount = 0;
+	int stride = settings.sampleStride;
+	for( int v = 0; v < camera.height; v += stride )
+	{
+		const uint16_t* row = &depth[v * camera.width];
+		const float* ray = &rays[v * camera.width * 2];
+		for( int u = 0; u < camera.width; u += stride )
+		{
+			int mm = row[u] >> shift;
+			if( !mm )
+				continue;
+			float z = mm / MILLIMETERS_PER_METER;
+			pointX[pointCount] = ray[2 * u] * z;
+			pointY[pointCount] = ray[2 * u + 1] * z;
+			pointZ[pointCount] = z;
+			pointCount++;
+		}
+	}
+
+	lastStats.points = pointCount;
+	lastStats.warmStarted = false;
+	lastStats.iterations = 0;
+
+	GroundPlane best = currentPlane;
+	int bestInliers = -1;
+	if( pointCount >= 3 )
+	{
+		// Score last frame's plane first, its inlier ratio w tells how many
+		// samples of three are needed to hit an all-inlier one with the
+		// configured confidence: log(1 - confidence) / log(1 - w^3)
+		hypothesisCount = settings.maxIterations;
+		if( havePlane )
+		{
+			bestInliers = countInliers(currentPlane);
+			double w = (double)bestInliers / pointCount;
+			double all = w * w * w;
+			if( all > 0.999999 )
+				hypothesisCount = settings.minIterations;
+			else if( all > 0.0 )
+			{
+				double needed = ceil(log(1.0 - settings.confidence) / log(1.0 - all));
+				if( needed < hypothesisCount )
+					hypothesisCount = needed < settings.minIterations ? settings.minIterations : (int)needed;
+			}
+			lastStats.warmStarted = true;
+		}
+
+		if( workers )
+			workers->run(searchTask, this, chunks);
+		else
+			for( int c = 0; c < chunks; c++ )
+				searchChunk(c);
+
+		// More inliers wins, ties go to the lowest hypothesis index so the
+		// answer does not depend on how the hypotheses were split up
+		int bestIndex = -1;
+		for( int c = 0; c < chunks; c++ )
+		{
+			if( chunkIndex[c] < 0 )
+				continue;
+			if( chunkInliers[c] > bestInliers ||
+				(chunkInliers[c] == bestInliers && bestIndex >= 0 && chunkIndex[c] < bestIndex) )
+			{
+				bestInliers = chunkInliers[c];
+				bestIndex = chunkIndex[c];
+				best = chunkPlane[c];
+			}
+		}
+		lastStats.iterations = hypothesisCount;
+
+		GroundPlane refined = best;
+		if( bestInliers >= 3 && refine(&refined) )
+		{
+			int refinedInliers = countInliers(refined);
+			if( refinedInliers >= bestInliers )
+			{
+				best = refined;
+				bestInliers = refinedInliers;
+			}
+		}
+	}
+
+	lastStats.found = bestInliers >= 3;
+	lastStats.inliers = lastStats.found ? bestInliers : 0;
+	if( lastStats.found )
+	{
+		currentPlane = best;
+		havePlane = true;
+	}
+	else
+	{
+		havePlane = false;
+	}
+
+	if( havePlane )
+	{
+		if( workers )
+			workers->run(heightTask, this, chunks);
+		else
+			for( int c = 0; c < chunks; c++ )
+				heightBand(c);
+	}
+	else
+	{
+		for( int i = 0; i < camera.width * camera.height; i++ )
+			heightMap[i] = GROUND_HEIGHT_UNKNOWN;
+	}
+
+	frame = NULL;
+	lastStats.milliseconds = (getTimeSeconds() - start) * 1e3;
+	return lastStats.found;
+}
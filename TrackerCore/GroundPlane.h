@@ -0,0 +1,118 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+#include "Registration.h"
+#include "WorkerPool.h"
+
+// Written into the height map where the depth frame has a hole
+#define GROUND_HEIGHT_UNKNOWN -1.0e30f
+
+typedef struct
+{
+	// Unit normal pointing from the floor toward the sensor and the offset,
+	// in meters in the camera frame: a * x + b * y + c * z + d = 0. With the
+	// normal facing the sensor, d is the sensor height and a * x + b * y +
+	// c * z + d is the height of a point above the floor.
+	float a, b, c, d;
+} GroundPlane;
+
+typedef struct
+{
+	// Only every Nth pixel in each direction is used for fitting
+	int sampleStride;
+	// Points within this many meters of a hypothesis count as inliers
+	float inlierThreshold;
+	// Bounds on the number of hypotheses tried per frame
+	int minIterations;
+	int maxIterations;
+	// Chance of drawing at least one all-inlier sample that the adaptive iteration count aims for
+	float confidence;
+	// Hypotheses whose normal is further than this from the expected up direction are skipped, in radians
+	float maxTilt;
+	// Seed for the hypothesis generator, a frame is reproducible from the seed alone
+	uint32_t seed;
+} GroundPlaneConfig;
+
+typedef struct
+{
+	int iterations;
+	int points;
+	int inliers;
+	bool warmStarted;
+	bool found;
+	double milliseconds;
+} GroundPlaneStats;
+
+TRACKERCORE_API void getDefaultGroundPlaneConfig(GroundPlaneConfig* config);
+
+// Fits the arena floor to each depth frame with RANSAC and reports the height
+// of every pixel above it. Hypotheses are split across the worker pool, each
+// drawn from its own index-seeded generator so the result does not depend on
+// how many threads ran. The previous frame's plane is scored first and its
+// inlier ratio sets how many fresh hypotheses are still needed, so while the
+// sensor tilts slowly most frames only need the minimum.
+class TRACKERCORE_API GroundPlaneEstimator
+{
+public:
+	GroundPlaneEstimator(void);
+	~GroundPlaneEstimator(void);
+
+	// The pool is optional and not owned
+	bool initialize(const CameraIntrinsics& depthCamera, const GroundPlaneConfig& config,
+					WorkerPool* pool = NULL, int depthShift = DEPTH_PLAYER_INDEX_SHIFT);
+
+	// Fits the plane and fills the height map, returns false when no plane was found
+	bool estimate(const uint16_t* depth);
+
+	// Forget the previous plane, the next frame starts cold
+	void reset(void);
+
+	const GroundPlane& plane(void) const { return currentPlane; }
+	const GroundPlaneStats& stats(void) const { return lastStats; }
+	// Height above the plane in meters for every pixel of the last frame
+	const float* heights(void) const { return heightMap; }
+
+private:
+	CameraIntrinsics camera;
+	GroundPlaneConfig settings;
+	WorkerPool* workers;
+	int shift;
+	int chunks;
+
+	// Unit-z rays for every pixel, interleaved x and y
+	float* rays;
+	// Subsampled points of the current frame
+	float* pointX;
+	float* pointY;
+	float* pointZ;
+	int pointCount;
+	int pointCapacity;
+
+	// Best hypothesis found by each chunk
+	GroundPlane* chunkPlane;
+	int* chunkInliers;
+	int* chunkIndex;
+
+	GroundPlane currentPlane;
+	bool havePlane;
+	uint32_t frameNumber;
+	GroundPlaneStats lastStats;
+	float* heightMap;
+
+	const uint16_t* frame;
+	int hypothesisCount;
+
+	void release(void);
+	int countInliers(const GroundPlane& plane) const;
+	bool hypothesis(int index, GroundPlane* plane) const;
+	bool refine(GroundPlane* plane) const;
+	void searchChunk(int chunk);
+	void heightBand(int band);
+	static void searchTask(void* context, int index);
+	static void heightTask(void* context, int index);
+
+	GroundPlaneEstimator(const GroundPlaneEstimator&);
+	GroundPlaneEstimator& operator=(const GroundPlaneEstimator&);
+};
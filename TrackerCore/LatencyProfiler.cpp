@@ -0,0 +1,351 @@
+#include "stdafx.h"
+#include "LatencyProfiler.h"
+#include "Timing.h"
+
+#include <string.h>
+#include <atomic>
+
+// A record is copied in and out of the ring a word at a time through
+// relaxed atomics, so a reader racing the writer gets a torn copy that the
+// sequence check throws away rather than undefined behavior
+#define LATENCY_RECORD_WORDS (sizeof(LatencyRecord) / sizeof(uint64_t))
+static_assert(sizeof(LatencyRecord) % sizeof(uint64_t) == 0, "LatencyRecord must be whole words");
+
+typedef struct
+{
+	// Odd while the recording thread is writing the slot
+	std::atomic<uint32_t> sequence;
+	std::atomic<uint64_t> record[LATENCY_RECORD_WORDS];
+} LatencySlot;
+
+typedef struct
+{
+	std::atomic<uint32_t> buckets[LATENCY_HISTOGRAM_BUCKETS];
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> total;
+	std::atomic<uint64_t> max;
+} LatencyHistogram;
+
+struct LatencyProfiler::State
+{
+	const char* const* names;
+	int stageCount;
+
+	LatencySlot* ring;
+	uint32_t ringSize;
+	std::atomic<uint64_t> frames;
+	std::atomic<uint64_t> dropped;
+	LatencyHistogram histograms[LATENCY_MAX_STAGES];
+
+	// The frame being recorded, only the recording thread touches these
+	LatencyRecord current;
+	uint64_t lastMark;
+	bool inFrame;
+};
+
+static inline int bucketFor(uint64_t nanoseconds)
+{
+	if( nanoseconds < LATENCY_SUB_BUCKETS )
+		return (int)nanoseconds;
+	int exponent = 63;
+	while( !(nanoseconds >> exponent) )
+		exponent--;
+	int bucket = (exponent - 2) * LATENCY_SUB_BUCKETS + (int)((nanoseconds >> (exponent - 3)) & (LATENCY_SUB_BUCKETS - 1));
+	return bucket < LATENCY_HISTOGRAM_BUCKETS ? bucket : LATENCY_HISTOGRAM_BUCKETS - 1;
+}
+
+static inline uint64_t bucketLow(int bucket)
+{
+	if( bucket < LATENCY_SUB_BUCKETS )
+		return bucket;
+	int exponent = bucket / LATENCY_SUB_BUCKETS + 2;
+	return (uint64_t)(LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) << (exponent - 3);
+}
+
+static inline uint64_t bucketHigh(int bucket)
+{
+	return bucket + 1 < LATENCY_HISTOGRAM_BUCKETS ? bucketLow(bucket + 1) : bucketLow(bucket) * 2;
+}
+
+// Only the recording thread writes, so a plain load and store is enough
+// and keeps locked instructions out of the pipeline
+static inline void bump(std::atomic<uint32_t>& counter)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+static inline void bump(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+LatencyProfiler::LatencyProfiler()
+{
+	state = new State();
+	state->names = NULL;
+	state->stageCount = 0;
+	state->ring = NULL;
+	state->ringSize = 0;
+	state->frames = 0;
+	state->dropped = 0;
+	for( int stage = 0; stage < LATENCY_MAX_STAGES; stage++ )
+	{
+		LatencyHistogram& histogram = state->histograms[stage];
+		for( int bucket = 0; bucket < LATENCY_HISTOGRAM_BUCKETS; bucket++ )
+			histogram.buckets[bucket] = 0;
+		histogram.count = 0;
+		histogram.total = 0;
+		histogram.max = 0;
+	}
+	memset(&state->current, 0, sizeof(state->current));
+	state->lastMark = 0;
+	state->inFrame = false;
+	return;
+}
+
+LatencyProfiler::~LatencyProfiler()
+{
+	delete[] state->ring;
+	delete state;
+	return;
+}
+
+bool LatencyProfiler::initialize(const char* const* stageNames, int stageCount, int ringFrames)
+{
+	if( stageCount < 1 || stageCount > LATENCY_MAX_STAGES || ringFrames < 1 )
+		return false;
+
+	delete[] state->ring;
+	state->ring = NULL;
+	try
+	{
+		state->ring = new LatencySlot[ringFrames];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for latency ring: " << ba.what() << std::endl;
+		return false;
+	}
+	for( int i = 0; i < ringFrames; i++ )
+	{
+		state->ring[i].sequence = 0;
+		for( size_t word = 0; word < LATENCY_RECORD_WORDS; word++ )
+			state->ring[i].record[word] = 0;
+	}
+	state->ringSize = ringFrames;
+	state->names = stageNames;
+	state->stageCount = stageCount;
+	return true;
+}
+
+void LatencyProfiler::beginFrame(void)
+{
+	state->current.stages = 0;
+	state->current.start = state->lastMark = getTimeNanoseconds();
+	state->inFrame = true;
+}
+
+void LatencyProfiler::mark(int stage)
+{
+	if( !state->inFrame || stage < 0 || stage >= state->stageCount )
+		return;
+	uint64_t now = getTimeNanoseconds();
+	uint64_t elapsed = now - state->lastMark;
+	state->lastMark = now;
+
+	// A stage that runs twice in a frame is charged for both
+	if( state->current.stages & (1u << stage) )
+		elapsed += state->current.duration[stage];
+	state->current.duration[stage] = elapsed;
+	state->current.stages |= 1u << stage;
+}
+
+void LatencyProfiler::endFrame(void)
+{
+	if( !state->inFrame || !state->ring )
+		return;
+	state->inFrame = false;
+
+	uint64_t frame = state->frames.load(std::memory_order_relaxed);
+	state->current.frame = (uint32_t)frame;
+
+	for( int stage = 0; stage < state->stageCount; stage++ )
+	{
+		if( !(state->current.stages & (1u << stage)) )
+			continue;
+		uint64_t duration = state->current.duration[stage];
+		LatencyHistogram& histogram = state->histograms[stage];
+		bump(histogram.buckets[bucketFor(duration)]);
+		bump(histogram.count, 1);
+		bump(histogram.total, duration);
+		if( duration > histogram.max.load(std::memory_order_relaxed) )
+			histogram.max.store(duration, std::memory_order_relaxed);
+	}
+
+	// Seqlock publish, readers retry or skip a slot they catch mid-write
+	LatencySlot& slot = state->ring[frame % state->ringSize];
+	uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	uint64_t words[LATENCY_RECORD_WORDS];
+	memcpy(words, &state->current, sizeof(words));
+	for( size_t word = 0; word < LATENCY_RECORD_WORDS; word++ )
+		slot.record[word].store(words[word], std::memory_order_relaxed);
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+
+	state->frames.store(frame + 1, std::memory_order_release);
+}
+
+void LatencyProfiler::countDropped(uint32_t frames)
+{
+	bump(state->dropped, frames);
+}
+
+uint64_t LatencyProfiler::frames(void) const
+{
+	return state->frames.load(std::memory_order_acquire);
+}
+
+uint64_t LatencyProfiler::dropped(void) const
+{
+	return state->dropped.load(std::memory_order_relaxed);
+}
+
+bool LatencyProfiler::summarize(int stage, LatencySummary* summary) const
+{
+	if( stage < 0 || stage >= state->stageCount )
+		return false;
+	const LatencyHistogram& histogram = state->histograms[stage];
+
+	// Counted from the buckets so the percentiles add up even while recording goes on
+	uint32_t buckets[LATENCY_HISTOGRAM_BUCKETS];
+	uint64_t count = 0;
+	for( int bucket = 0; bucket < LATENCY_HISTOGRAM_BUCKETS; bucket++ )
+	{
+		buckets[bucket] = histogram.buckets[bucket].load(std::memory_order_relaxed);
+		count += buckets[bucket];
+	}
+
+	memset(summary, 0, sizeof(LatencySummary));
+	summary->count = count;
+	if( !count )
+		return true;
+	uint64_t recorded = histogram.count.load(std::memory_order_relaxed);
+	summary->mean = recorded ? histogram.total.load(std::memory_order_relaxed) / 1000.0 / recorded : 0.0;
+	summary->max = histogram.max.load(std::memory_order_relaxed) / 1000.0;
+
+	// Each percentile is reported as the middle of the bucket it falls in
+	const double fractions[3] = { 0.50, 0.90, 0.99 };
+	double* results[3] = { &summary->p50, &summary->p90, &summary->p99 };
+	for( int i = 0; i < 3; i++ )
+	{
+		uint64_t rank = (uint64_t)(fractions[i] * (count - 1));
+		uint64_t seen = 0;
+		for( int bucket = 0; bucket < LATENCY_HISTOGRAM_BUCKETS; bucket++ )
+		{
+			seen += buckets[bucket];
+			if( seen > rank )
+			{
+				*results[i] = (bucketLow(bucket) + bucketHigh(bucket)) / 2000.0;
+				break;
+			}
+		}
+		if( *results[i] > summary->max )
+			*results[i] = summary->max;
+	}
+	return true;
+}
+
+int LatencyProfiler::recentFrames(LatencyRecord* records, int maxRecords) const
+{
+	if( !state->ring || maxRecords < 1 )
+		return 0;
+
+	uint64_t newest = frames();
+	uint64_t available = newest < state->ringSize ? newest : state->ringSize;
+	if( available > (uint64_t)maxRecords )
+		available = maxRecords;
+
+	int copied = 0;
+	for( uint64_t frame = newest - available; frame < newest; frame++ )
+	{
+		const LatencySlot& slot = state->ring[frame % state->ringSize];
+		uint32_t before = slot.sequence.load(std::memory_order_acquire);
+		uint64_t words[LATENCY_RECORD_WORDS];
+		for( size_t word = 0; word < LATENCY_RECORD_WORDS; word++ )
+			words[word] = slot.record[word].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint32_t after = slot.sequence.load(std::memory_order_relaxed);
+		// Skip slots that were being rewritten or already hold a newer frame
+		LatencyRecord record;
+		memcpy(&record, words, sizeof(record));
+		if( before != after || (before & 1) || record.frame != (uint32_t)frame )
+			continue;
+		records[copied++] = record;
+	}
+	return copied;
+}
+
+bool LatencyProfiler::writeText(FILE* file) const
+{
+	fprintf(file, "latency over %llu frames, %llu dropped\n", (unsigned long long)frames(),
+			(unsigned long long)dropped());
+	fprintf(file, "%-12s %10s %10s %10s %10s %10s %10s  (us)\n", "stage", "count", "mean", "p50", "p90", "p99", "max");
+	for( int stage = 0; stage < state->stageCount; stage++ )
+	{
+		LatencySummary summary;
+		summarize(stage, &summary);
+		fprintf(file, "%-12s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f\n", state->names[stage],
+				(unsigned long long)summary.count, summary.mean, summary.p50, summary.p90, summary.p99, summary.max);
+	}
+	return ferror(file) == 0;
+}
+
+bool LatencyProfiler::writeJson(FILE* file) const
+{
+	fprintf(file, "{\n  \"frames\": %llu,\n  \"dropped\": %llu,\n  \"stages\": [\n",
+			(unsigned long long)frames(), (unsigned long long)dropped());
+	for( int stage = 0; stage < state->stageCount; stage++ )
+	{
+		LatencySummary summary;
+		summarize(stage, &summary);
+		fprintf(file, "    { \"name\": \"%s\", \"count\": %llu, \"mean_us\": %.3f, \"p50_us\": %.3f, "
+				"\"p90_us\": %.3f, \"p99_us\": %.3f, \"max_us\": %.3f,\n      \"histogram_ns\": [",
+				state->names[stage], (unsigned long long)summary.count, summary.mean, summary.p50, summary.p90,
+				summary.p99, summary.max);
+
+		// Only the buckets that were hit, as [low, high, count]
+		const LatencyHistogram& histogram = state->histograms[stage];
+		bool first = true;
+		for( int bucket = 0; bucket < LATENCY_HISTOGRAM_BUCKETS; bucket++ )
+		{
+			uint32_t count = histogram.buckets[bucket].load(std::memory_order_relaxed);
+			if( !count )
+				continue;
+			fprintf(file, "%s[%llu, %llu, %u]", first ? "" : ", ", (unsigned long long)bucketLow(bucket),
+					(unsigned long long)bucketHigh(bucket), count);
+			first = false;
+		}
+		fprintf(file, "] }%s\n", stage + 1 < state->stageCount ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+	return ferror(file) == 0;
+}
+
+bool LatencyProfiler::saveJson(const char* path) const
+{
+	FILE* file = NULL;
+#ifdef _WIN32
+	if( fopen_s(&file, path, "w") )
+		file = NULL;
+#else
+	file = fopen(path, "w");
+#endif
+	if( file == NULL )
+	{
+		std::cerr << "Failed to create latency snapshot " << path << std::endl;
+		return false;
+	}
+	bool written = writeJson(file);
+	return fclose(file) == 0 && written;
+}
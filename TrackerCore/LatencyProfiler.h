@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+
+// Builds leave the LATENCY_* hooks in unless this is defined to 0, the
+// profiler class itself is always there so the DLL interface never changes
+#ifndef LATENCY_PROFILING
+#define LATENCY_PROFILING 1
+#endif
+
+#if LATENCY_PROFILING
+#define LATENCY_BEGIN(profiler) (profiler).beginFrame()
+#define LATENCY_MARK(profiler, stage) (profiler).mark(stage)
+#define LATENCY_END(profiler) (profiler).endFrame()
+#define LATENCY_DROPPED(profiler, frames) (profiler).countDropped(frames)
+#else
+#define LATENCY_BEGIN(profiler) ((void)0)
+#define LATENCY_MARK(profiler, stage) ((void)0)
+#define LATENCY_END(profiler) ((void)0)
+#define LATENCY_DROPPED(profiler, frames) ((void)0)
+#endif
+
+#define LATENCY_MAX_STAGES 8
+
+// Eight buckets per power of two from 1 ns up to about 18 minutes, so a
+// bucket is never more than 12.5% wide. Longer stages land in the top bucket
+// but still count in full toward the mean and the max.
+#define LATENCY_SUB_BUCKETS 8
+#define LATENCY_HISTOGRAM_BUCKETS (38 * LATENCY_SUB_BUCKETS)
+
+typedef struct
+{
+	uint32_t frame;
+	// Bit per stage that ran in this frame
+	uint32_t stages;
+	// When the frame began, on the getTimeNanoseconds() clock
+	uint64_t start;
+	// Time spent in each stage in nanoseconds
+	uint64_t duration[LATENCY_MAX_STAGES];
+} LatencyRecord;
+
+typedef struct
+{
+	uint64_t count;
+	// Microseconds, percentiles are read from the histogram
+	double mean;
+	double p50, p90, p99;
+	double max;
+} LatencySummary;
+
+// Times the stages of a frame pipeline. The pipeline thread calls
+// beginFrame(), then mark() as each stage finishes, then endFrame(); a stage
+// is charged with the time since the previous mark. Every finished frame
+// goes into a ring of recent frames and into a histogram per stage.
+//
+// Only one thread may record. Any thread may read summaries, recent frames
+// or snapshots while it does, nothing on the recording side takes a lock.
+class TRACKERCORE_API LatencyProfiler
+{
+public:
+	LatencyProfiler(void);
+	~LatencyProfiler(void);
+
+	// Stage names must outlive the profiler
+	bool initialize(const char* const* stageNames, int stageCount, int ringFrames = 256);
+
+	void beginFrame(void);
+	void mark(int stage);
+	void endFrame(void);
+	// Frames the source produced that never reached the pipeline
+	void countDropped(uint32_t frames);
+
+	uint64_t frames(void) const;
+	uint64_t dropped(void) const;
+	bool summarize(int stage, LatencySummary* summary) const;
+	// Copies up to maxRecords of the latest frames, oldest first, returns how many
+	int recentFrames(LatencyRecord* records, int maxRecords) const;
+
+	bool writeText(FILE* file) const;
+	bool writeJson(FILE* file) const;
+	// Writes a JSON snapshot to a new file at path
+	bool saveJson(const char* path) const;
+
+private:
+	struct State;
+	State* state;
+
+	LatencyProfiler(const LatencyProfiler&);
+	LatencyProfiler& operator=(const LatencyProfiler&);
+};
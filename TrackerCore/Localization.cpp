@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include "Localization.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+#define MILLIMETERS_PER_METER 1000.0f
+#define MAX_WINDOW_SAMPLES ((2 * LOCALIZER_MAX_SAMPLE_RADIUS + 1) * (2 * LOCALIZER_MAX_SAMPLE_RADIUS + 1))
+
+TargetLocalizer::TargetLocalizer()
+{
+	rays = NULL;
+	shift = DEPTH_PLAYER_INDEX_SHIFT;
+	radius = 3;
+	minimumSamples = 5;
+	memset(&intrinsics, 0, sizeof(intrinsics));
+	return;
+}
+
+TargetLocalizer::~TargetLocalizer()
+{
+	delete[] rays;
+	return;
+}
+
+bool TargetLocalizer::initialize(const CameraIntrinsics& camera, int depthShift)
+{
+	delete[] rays;
+	rays = NULL;
+	intrinsics = camera;
+	shift = depthShift;
+
+	try
+	{
+		rays = new float[camera.width * camera.height * 2];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for ray table: " << ba.what() << std::endl;
+		return false;
+	}
+
+	for( int v = 0; v < camera.height; v++ )
+	{
+		for( int u = 0; u < camera.width; u++ )
+		{
+			float* ray = &rays[(v * camera.width + u) * 2];
+			ray[0] = (u - camera.cx) / camera.fx;
+			ray[1] = (v - camera.cy) / camera.fy;
+		}
+	}
+	return true;
+}
+
+void TargetLocalizer::setSampleWindow(int radius, int minimumSamples)
+{
+	this->radius = std::max(0, std::min(radius, LOCALIZER_MAX_SAMPLE_RADIUS));
+	this->minimumSamples = std::max(1, minimumSamples);
+}
+
+// The median of the window ignores holes and is not pulled
+// around by the background showing through at blob edges
+int TargetLocalizer::sampleDepth(const uint16_t* depth, Coordinate pixel) const
+{
+	int samples[MAX_WINDOW_SAMPLES];
+	int count = 0;
+
+	int left = std::max(pixel.x - radius, 0);
+	int right = std::min(pixel.x + radius, intrinsics.width - 1);
+	int top = std::max(pixel.y - radius, 0);
+	int bottom = std::min(pixel.y + radius, intrinsics.height - 1);
+
+	for( int y = top; y <= bottom; y++ )
+	{
+		const uint16_t* row = &depth[y * intrinsics.width];
+		for( int x = left; x <= right; x++ )
+		{
+			int z = row[x] >> shift;
+			if( z )
+				samples[count++] = z;
+		}
+	}
+
+	if( count < minimumSamples )
+		return 0;
+
+	std::nth_element(samples, samples + count / 2, samples + count);
+	return samples[count / 2];
+}
+
+bool TargetLocalizer::localize(const uint16_t* depth, Coordinate pixel, Point3D* location) const
+{
+	if( rays == NULL )
+	{
+		std::cerr << "localize called before initialize" << std::endl;
+		return false;
+	}
+	if( pixel.x < 0 || pixel.x >= intrinsics.width || pixel.y < 0 || pixel.y >= intrinsics.height )
+		return false;
+
+	int z = sampleDepth(depth, pixel);
+	if( !z )
+		return false;
+
+	const float* ray = &rays[(pixel.y * intrinsics.width + pixel.x) * 2];
+	float meters = z / MILLIMETERS_PER_METER;
+	location->x = ray[0] * meters;
+	location->y = ray[1] * meters;
+	location->z = meters;
+	return true;
+}
+
+bool TargetLocalizer::localizePair(const uint16_t* depth, Coordinate first, Coordinate second, BeaconPair* pair) const
+{
+	Point3D one, two;
+
+	if( !localize(depth, first, &one) || !localize(depth, second, &two) )
+		return false;
+
+	pair->midpoint.x = (one.x + two.x) * 0.5f;
+	pair->midpoint.y = (one.y + two.y) * 0.5f;
+	pair->midpoint.z = (one.z + two.z) * 0.5f;
+	pair->range = sqrtf(pair->midpoint.x * pair->midpoint.x + pair->midpoint.z * pair->midpoint.z);
+	pair->bearing = atan2f(pair->midpoint.x, pair->midpoint.z);
+
+	float dx = two.x - one.x;
+	float dy = two.y - one.y;
+	float dz = two.z - one.z;
+	pair->separation = sqrtf(dx * dx + dy * dy + dz * dz);
+	pair->baselineAngle = atan2f(dz, dx);
+	return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+#include "TrackerCore.h"
+#include "Registration.h"
+
+// Largest depth sampling window is (2 * radius + 1) squared pixels
+#define LOCALIZER_MAX_SAMPLE_RADIUS 7
+
+typedef struct
+{
+	// Meters in the camera frame: x right, y down, z out along the optical axis
+	float x, y, z;
+} Point3D;
+
+typedef struct
+{
+	// Midpoint between the two beacons
+	Point3D midpoint;
+	// Horizontal distance to the midpoint in meters
+	float range;
+	// Angle to the midpoint from the optical axis in radians, positive to the right
+	float bearing;
+	// Distance between the beacons in meters
+	float separation;
+	// Angle of the line from beacon one to beacon two around the vertical axis in radians
+	float baselineAngle;
+} BeaconPair;
+
+// Turns a pixel centroid into a point in meters. The Kinect reports depth
+// along the optical axis rather than along the ray, so the table holds one
+// ray per pixel scaled to unit z and a point is just the ray times the depth.
+// The depth frame must be in the same camera as the centroids, use
+// DepthRegistration::registerDepthToColor for color centroids.
+class TRACKERCORE_API TargetLocalizer
+{
+public:
+	TargetLocalizer(void);
+	~TargetLocalizer(void);
+
+	// Builds the ray table for the camera the centroids come from
+	bool initialize(const CameraIntrinsics& camera, int depthShift = DEPTH_PLAYER_INDEX_SHIFT);
+
+	// Half width of the window depth is sampled from around a centroid and the
+	// fewest valid readings in it for a location to be trusted
+	void setSampleWindow(int radius, int minimumSamples);
+
+	// Median depth in the window around a pixel in millimeters, zero if too few readings
+	int sampleDepth(const uint16_t* depth, Coordinate pixel) const;
+
+	// Returns false when the centroid is outside the frame or has no usable depth
+	bool localize(const uint16_t* depth, Coordinate pixel, Point3D* location) const;
+
+	// Locates both beacons and the range and bearing to the pair, for
+	// callers that have two centroids; TrackerCore only finds one target
+	bool localizePair(const uint16_t* depth, Coordinate first, Coordinate second, BeaconPair* pair) const;
+
+private:
+	CameraIntrinsics intrinsics;
+	int shift;
+	int radius;
+	int minimumSamples;
+
+	// Ray x and y at unit depth, interleaved per pixel
+	float* rays;
+
+	TargetLocalizer(const TargetLocalizer&);
+	TargetLocalizer& operator=(const TargetLocalizer&);
+};
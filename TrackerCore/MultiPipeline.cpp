@@ -0,0 +1,308 @@
+#include "stdafx.h"
+#include "MultiPipeline.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+
+#if !defined(_WIN32) && defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct MultiPipeline::State
+{
+	// Hands every pipeline's results to the caller's sink and the merged stream
+	struct MergeSink : public TelemetrySink
+	{
+		State* owner;
+		void publish(const TrackingResult& result);
+	};
+
+	int count;
+	bool initialized;
+	bool pinThreads;
+	FrameSource* sources[MULTI_PIPELINE_MAX_SENSORS];
+	TrackingPipeline* pipelines[MULTI_PIPELINE_MAX_SENSORS];
+	// Set before the threads start, a thread that fails to pin itself clears its own
+	std::atomic<int> cores[MULTI_PIPELINE_MAX_SENSORS];
+	std::atomic<uint32_t> processed[MULTI_PIPELINE_MAX_SENSORS];
+	std::thread threads[MULTI_PIPELINE_MAX_SENSORS];
+	std::atomic<int> active;
+
+	MergeSink merge;
+	// Either one sink for every sensor, called under sinkLock, or one per sensor
+	TelemetrySink* sink;
+	std::mutex sinkLock;
+	TelemetrySink* sensorSinks[MULTI_PIPELINE_MAX_SENSORS];
+
+	// The merged stream, a ring that drops its oldest result when full
+	std::mutex lock;
+	std::condition_variable ready;
+	TrackingResult* queue;
+	int queueSize;
+	int head;
+	int queued;
+	uint64_t overflowed;
+};
+
+// Keeps the calling thread on one core, false where that is not supported
+static bool pinCurrentThread(int core)
+{
+#if defined(_WIN32)
+	return SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << (core % (sizeof(DWORD_PTR) * 8))) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+	return false;
+#endif
+}
+
+void MultiPipeline::State::MergeSink::publish(const TrackingResult& result)
+{
+	State* state = owner;
+	state->processed[result.sensor]++;
+
+	// Sinks are written for one pipeline, so a shared one gets one result at a time
+	if( state->sensorSinks[result.sensor] )
+		state->sensorSinks[result.sensor]->publish(result);
+	else if( state->sink )
+	{
+		std::lock_guard<std::mutex> guard(state->sinkLock);
+		state->sink->publish(result);
+	}
+
+	std::lock_guard<std::mutex> guard(state->lock);
+	state->queue[state->head] = result;
+	state->head = (state->head + 1) % state->queueSize;
+	if( state->queued < state->queueSize )
+		state->queued++;
+	else
+		state->overflowed++;
+	state->ready.notify_one();
+}
+
+MultiPipeline::MultiPipeline()
+{
+	state = new State();
+	state->count = 0;
+	state->initialized = false;
+	state->pinThreads = false;
+	for( int i = 0; i < MULTI_PIPELINE_MAX_SENSORS; i++ )
+	{
+		state->sources[i] = NULL;
+		state->pipelines[i] = NULL;
+		state->cores[i] = -1;
+		state->processed[i] = 0;
+		state->sensorSinks[i] = NULL;
+	}
+	state->active = 0;
+	state->merge.owner = state;
+	state->sink = NULL;
+	state->queue = NULL;
+	state->queueSize = 0;
+	state->head = state->queued = 0;
+	state->overflowed = 0;
+	return;
+}
+
+MultiPipeline::~MultiPipeline()
+{
+	stop();
+	wait();
+	for( int i = 0; i < MULTI_PIPELINE_MAX_SENSORS; i++ )
+		delete state->pipelines[i];
+	delete[] state->queue;
+	delete state;
+	return;
+}
+
+bool MultiPipeline::initialize(FrameSource** sources, int count, const TrackingPipelineConfig& config,
+							   int depthWidth, int depthHeight, bool pinThreads, int queueSize)
+{
+	if( running() )
+	{
+		std::cerr << "initialize called while the pipelines are running" << std::endl;
+		return false;
+	}
+	wait();
+
+	state->initialized = false;
+	if( count < 1 || count > MULTI_PIPELINE_MAX_SENSORS )
+	{
+		std::cerr << "MultiPipeline takes 1 to " << MULTI_PIPELINE_MAX_SENSORS << " sensors, not " << count << std::endl;
+		return false;
+	}
+
+	delete[] state->queue;
+	state->queue = NULL;
+	try
+	{
+		state->queue = new TrackingResult[queueSize > 0 ? queueSize : 1];
+		for( int i = 0; i < count; i++ )
+			if( !state->pipelines[i] )
+				state->pipelines[i] = new TrackingPipeline();
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for sensor pipelines: " << ba.what() << std::endl;
+		return false;
+	}
+	state->queueSize = queueSize > 0 ? queueSize : 1;
+	state->head = state->queued = 0;
+	state->overflowed = 0;
+
+	// No shared worker pool, a pipeline only ever uses its own thread
+	for( int i = 0; i < count; i++ )
+	{
+		TrackingPipelineConfig sensorConfig = config;
+		sensorConfig.sensor = i;
+		if( !state->pipelines[i]->initialize(sensorConfig, depthWidth, depthHeight, NULL) )
+			return false;
+		state->sources[i] = sources[i];
+	}
+	state->count = count;
+	state->pinThreads = pinThreads;
+	state->initialized = true;
+	return true;
+}
+
+bool MultiPipeline::start(TelemetrySink* sink, uint32_t maxFrames)
+{
+	if( !readyToStart() )
+		return false;
+	state->sink = sink;
+	for( int i = 0; i < MULTI_PIPELINE_MAX_SENSORS; i++ )
+		state->sensorSinks[i] = NULL;
+	startThreads(maxFrames);
+	return true;
+}
+
+bool MultiPipeline::startPerSensor(TelemetrySink* const* sinks, uint32_t maxFrames)
+{
+	if( !readyToStart() )
+		return false;
+	state->sink = NULL;
+	for( int i = 0; i < MULTI_PIPELINE_MAX_SENSORS; i++ )
+		state->sensorSinks[i] = sinks && i < state->count ? sinks[i] : NULL;
+	startThreads(maxFrames);
+	return true;
+}
+
+bool MultiPipeline::readyToStart(void)
+{
+	if( !state->initialized )
+	{
+		std::cerr << "start called before initialize" << std::endl;
+		return false;
+	}
+	if( running() )
+	{
+		std::cerr << "start called while the pipelines are running" << std::endl;
+		return false;
+	}
+	wait();
+	return true;
+}
+
+void MultiPipeline::startThreads(uint32_t maxFrames)
+{
+	int cores = (int)std::thread::hardware_concurrency();
+	if( cores <= 0 )
+		cores = 1;
+
+	state->active = state->count;
+	for( int i = 0; i < state->count; i++ )
+	{
+		state->processed[i] = 0;
+		state->cores[i] = state->pinThreads ? i % cores : -1;
+	}
+	for( int i = 0; i < state->count; i++ )
+		state->threads[i] = std::thread(pipelineMain, state, i, maxFrames);
+}
+
+void MultiPipeline::pipelineMain(State* state, int sensor, uint32_t maxFrames)
+{
+	int core = state->cores[sensor].load();
+	if( core >= 0 && !pinCurrentThread(core) )
+		state->cores[sensor] = -1;
+
+	state->pipelines[sensor]->run(state->sources[sensor], &state->merge, maxFrames);
+
+	// Wake any reader so it sees the last pipeline finish
+	std::lock_guard<std::mutex> guard(state->lock);
+	state->active--;
+	state->ready.notify_all();
+}
+
+void MultiPipeline::stop(void)
+{
+	for( int i = 0; i < state->count; i++ )
+		state->pipelines[i]->stop();
+}
+
+uint64_t MultiPipeline::wait(void)
+{
+	uint64_t total = 0;
+	for( int i = 0; i < MULTI_PIPELINE_MAX_SENSORS; i++ )
+	{
+		if( state->threads[i].joinable() )
+			state->threads[i].join();
+		if( i < state->count )
+			total += state->processed[i];
+	}
+	return total;
+}
+
+bool MultiPipeline::running(void) const
+{
+	return state->active.load() > 0;
+}
+
+int MultiPipeline::read(TrackingResult* results, int maxResults, double timeout)
+{
+	std::unique_lock<std::mutex> guard(state->lock);
+	if( !state->queued && timeout > 0.0 )
+		state->ready.wait_for(guard, std::chrono::microseconds((long long)(timeout * 1e6)),
+							  [this]() { return state->queued > 0 || state->active.load() == 0; });
+
+	int taken = 0;
+	while( taken < maxResults && state->queued )
+	{
+		int tail = (state->head + state->queueSize - state->queued) % state->queueSize;
+		results[taken++] = state->queue[tail];
+		state->queued--;
+	}
+	return taken;
+}
+
+int MultiPipeline::sensorCount(void) const
+{
+	return state->count;
+}
+
+TrackingPipeline& MultiPipeline::pipeline(int sensor)
+{
+	return *state->pipelines[sensor];
+}
+
+uint32_t MultiPipeline::processed(int sensor) const
+{
+	return state->processed[sensor].load();
+}
+
+int MultiPipeline::core(int sensor) const
+{
+	return state->cores[sensor].load();
+}
+
+uint64_t MultiPipeline::overflowed(void) const
+{
+	std::lock_guard<std::mutex> guard(state->lock);
+	return state->overflowed;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+#include "TrackingPipeline.h"
+
+#define MULTI_PIPELINE_MAX_SENSORS 8
+
+// Runs one TrackingPipeline per sensor, each on its own thread with its own
+// TrackerCore and buffers, and merges what they find into one stream of
+// results tagged with the sensor they came from. The pipelines share the
+// merged stream, which is only locked to copy a result in or out. A sink
+// given to start() is shared too and gets one result at a time, so a slow
+// one holds up every sensor. Sensors that must never wait on each other get
+// a sink each with startPerSensor().
+//
+// The sources can be anything that hands out frames, Kinects on the robot,
+// recorded sessions or synthetic scenes when testing.
+class TRACKERCORE_API MultiPipeline
+{
+public:
+	MultiPipeline(void);
+	~MultiPipeline(void);
+
+	// One pipeline per source, sensor i tags its results with i. The sources
+	// are not owned and each is only ever read from its own pipeline thread.
+	// With pinThreads every pipeline thread is kept on a core of its own
+	// (sensor i on core i, wrapping around), queueSize is how many results
+	// the merged stream holds before the oldest are dropped.
+	bool initialize(FrameSource** sources, int count, const TrackingPipelineConfig& config,
+					int depthWidth = 640, int depthHeight = 480, bool pinThreads = true, int queueSize = 256);
+
+	// Starts every pipeline. Each result goes to the sink, one call at a time
+	// from whichever pipeline thread produced it, and into the merged stream.
+	// A pipeline stops when its source runs dry or after maxFrames (0 for no limit).
+	bool start(TelemetrySink* sink = NULL, uint32_t maxFrames = 0);
+	// As start(), but sensor i's results go to sinks[i] from its own thread
+	// and without a lock. Entries may be NULL, the array is copied.
+	bool startPerSensor(TelemetrySink* const* sinks, uint32_t maxFrames = 0);
+
+	// Safe from any thread, the pipelines finish the frame in flight. Like
+	// TrackingPipeline::stop it sticks until initialize() is called again.
+	void stop(void);
+
+	// Waits for every pipeline to finish, returns how many frames they processed together
+	uint64_t wait(void);
+
+	// True while any pipeline is still running
+	bool running(void) const;
+
+	// Takes up to maxResults from the merged stream, oldest first. Waits up
+	// to timeout seconds for the first one, returns how many were taken.
+	int read(TrackingResult* results, int maxResults, double timeout = 0.0);
+
+	int sensorCount(void) const;
+	TrackingPipeline& pipeline(int sensor);
+	// Frames sensor has processed since start
+	uint32_t processed(int sensor) const;
+	// Core the sensor's thread is pinned to, -1 if it is not
+	int core(int sensor) const;
+	// Results dropped because nobody read the merged stream in time
+	uint64_t overflowed(void) const;
+
+private:
+	struct State;
+	State* state;
+
+	bool readyToStart(void);
+	void startThreads(uint32_t maxFrames);
+	static void pipelineMain(State* state, int sensor, uint32_t maxFrames);
+
+	MultiPipeline(const MultiPipeline&);
+	MultiPipeline& operator=(const MultiPipeline&);
+};
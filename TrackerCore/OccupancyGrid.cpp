@@ -0,0 +1,275 @@
+#include "stdafx.h"
+#include "OccupancyGrid.h"
+
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+#define MILLIMETERS_PER_METER 1000.0f
+
+void getDefaultOccupancyGridConfig(OccupancyGridConfig* config)
+{
+	config->cellSize = 0.05f;
+	config->minLateral = -2.0f;
+	config->maxLateral = 2.0f;
+	config->minForward = 0.5f;
+	config->maxForward = 4.5f;
+	config->sensorHeight = 0.6f;
+	config->sensorPitch = 0.35f;
+	config->stepThreshold = 0.1f;
+	config->minimumPoints = 3;
+	config->pixelStride = 2;
+}
+
+OccupancyGrid::OccupancyGrid()
+{
+	memset(&camera, 0, sizeof(camera));
+	memset(&settings, 0, sizeof(settings));
+	workers = NULL;
+	shift = DEPTH_PLAYER_INDEX_SHIFT;
+	gridColumns = gridRows = bands = 0;
+	projection = NULL;
+	bandMax = bandMin = NULL;
+	bandCount = NULL;
+	maxHeight = minHeight = NULL;
+	pointCount = NULL;
+	cellState = NULL;
+	chunkObstacles = NULL;
+	chunkCraters = NULL;
+	obstacles = craters = 0;
+	frame = NULL;
+	return;
+}
+
+OccupancyGrid::~OccupancyGrid()
+{
+	release();
+	return;
+}
+
+void OccupancyGrid::release(void)
+{
+	delete[] projection;
+	delete[] bandMax;
+	delete[] bandMin;
+	delete[] bandCount;
+	delete[] maxHeight;
+	delete[] minHeight;
+	delete[] pointCount;
+	delete[] cellState;
+	delete[] chunkObstacles;
+	delete[] chunkCraters;
+	projection = NULL;
+	bandMax = bandMin = NULL;
+	bandCount = NULL;
+	maxHeight = minHeight = NULL;
+	pointCount = NULL;
+	cellState = NULL;
+	chunkObstacles = NULL;
+	chunkCraters = NULL;
+}
+
+bool OccupancyGrid::initialize(const CameraIntrinsics& depthCamera, const OccupancyGridConfig& config,
+							   WorkerPool* pool, int depthShift)
+{
+	release();
+
+	camera = depthCamera;
+	settings = config;
+	workers = pool;
+	shift = depthShift;
+	if( settings.pixelStride < 1 )
+		settings.pixelStride = 1;
+
+	gridColumns = (int)ceilf((config.maxLateral - config.minLateral) / config.cellSize);
+	gridRows = (int)ceilf((config.maxForward - config.minForward) / config.cellSize);
+	bands = pool ? pool->size() : 1;
+
+	int cells = gridColumns * gridRows;
+	try
+	{
+		projection = new float[camera.width * camera.height * 3];
+		bandMax = new float[cells * bands];
+		bandMin = new float[cells * bands];
+		bandCount = new int[cells * bands];
+		maxHeight = new float[cells];
+		minHeight = new float[cells];
+		pointCount = new int[cells];
+		cellState = new uint8_t[cells];
+		chunkObstacles = new int[bands];
+		chunkCraters = new int[bands];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for occupancy grid: " << ba.what() << std::endl;
+		release();
+		return false;
+	}
+
+	setSensorPose(config.sensorHeight, config.sensorPitch);
+	return true;
+}
+
+// With the camera pitched down by p, a point at depth z along unit-z ray
+// (rx, ry) lands at
+//   lateral = z * rx
+//   forward = z * (cos p - ry * sin p)
+//   height  = mount - z * (sin p + ry * cos p)
+void OccupancyGrid::setSensorPose(float height, float pitch)
+{
+	settings.sensorHeight = height;
+	settings.sensorPitch = pitch;
+	if( projection == NULL )
+		return;
+
+	float c = cosf(pitch);
+	float s = sinf(pitch);
+	for( int v = 0; v < camera.height; v++ )
+	{
+		float ry = (v - camera.cy) / camera.fy;
+		for( int u = 0; u < camera.width; u++ )
+		{
+			float* coefficients = &projection[(v * camera.width + u) * 3];
+			coefficients[0] = (u - camera.cx) / camera.fx;
+			coefficients[1] = c - ry * s;
+			coefficients[2] = s + ry * c;
+		}
+	}
+}
+
+void OccupancyGrid::binBandTask(void* context, int index)
+{
+	((OccupancyGrid*)context)->binBand(index);
+}
+
+void OccupancyGrid::mergeTask(void* context, int index)
+{
+	((OccupancyGrid*)context)->mergeCells(index);
+}
+
+void OccupancyGrid::binBand(int band)
+{
+	int cells = gridColumns * gridRows;
+	float* localMax = &bandMax[band * cells];
+	float* localMin = &bandMin[band * cells];
+	int* localCount = &bandCount[band * cells];
+
+	for( int i = 0; i < cells; i++ )
+	{
+		localMax[i] = -FLT_MAX;
+		localMin[i] = FLT_MAX;
+	}
+	memset(localCount, 0, cells * sizeof(int));
+
+	int stride = settings.pixelStride;
+	int rowsPerBand = (camera.height + bands - 1) / bands;
+	int top = band * rowsPerBand;
+	int bottom = top + rowsPerBand < camera.height ? top + rowsPerBand : camera.height;
+	// Keep every band on the same subsampling lattice
+	top += (stride - top % stride) % stride;
+
+	float inverseCell = 1.0f / settings.cellSize;
+	float mount = settings.sensorHeight;
+
+	for( int v = top; v < bottom; v += stride )
+	{
+		const uint16_t* row = &frame[v * camera.width];
+		const float* coefficients = &projection[v * camera.width * 3];
+		for( int u = 0; u < camera.width; u += stride )
+		{
+			int mm = row[u] >> shift;
+			if( !mm )
+				continue;
+
+			float z = mm / MILLIMETERS_PER_METER;
+			const float* k = &coefficients[u * 3];
+			float column = (z * k[0] - settings.minLateral) * inverseCell;
+			float forward = (z * k[1] - settings.minForward) * inverseCell;
+			if( column < 0.0f || forward < 0.0f || column >= gridColumns || forward >= gridRows )
+				continue;
+
+			float height = mount - z * k[2];
+			int cell = (int)forward * gridColumns + (int)column;
+			if( height > localMax[cell] )
+				localMax[cell] = height;
+			if( height < localMin[cell] )
+				localMin[cell] = height;
+			localCount[cell]++;
+		}
+	}
+}
+
+void OccupancyGrid::mergeCells(int chunk)
+{
+	int cells = gridColumns * gridRows;
+	int perChunk = (cells + bands - 1) / bands;
+	int first = chunk * perChunk;
+	int last = first + perChunk < cells ? first + perChunk : cells;
+	int raised = 0, sunk = 0;
+
+	for( int i = first; i < last; i++ )
+	{
+		float high = -FLT_MAX;
+		float low = FLT_MAX;
+		int count = 0;
+		for( int b = 0; b < bands; b++ )
+		{
+			int j = b * cells + i;
+			if( bandMax[j] > high )
+				high = bandMax[j];
+			if( bandMin[j] < low )
+				low = bandMin[j];
+			count += bandCount[j];
+		}
+
+		maxHeight[i] = high;
+		minHeight[i] = low;
+		pointCount[i] = count;
+		if( count < settings.minimumPoints )
+			cellState[i] = CELL_UNKNOWN;
+		else if( high > settings.stepThreshold )
+		{
+			cellState[i] = CELL_OBSTACLE;
+			raised++;
+		}
+		else if( low < -settings.stepThreshold )
+		{
+			cellState[i] = CELL_CRATER;
+			sunk++;
+		}
+		else
+			cellState[i] = CELL_FREE;
+	}
+
+	chunkObstacles[chunk] = raised;
+	chunkCraters[chunk] = sunk;
+}
+
+void OccupancyGrid::build(const uint16_t* depth)
+{
+	if( projection == NULL )
+	{
+		std::cerr << "OccupancyGrid::build called before initialize" << std::endl;
+		return;
+	}
+
+	frame = depth;
+	if( workers )
+	{
+		workers->run(binBandTask, this, bands);
+		workers->run(mergeTask, this, bands);
+	}
+	else
+	{
+		binBand(0);
+		mergeCells(0);
+	}
+
+	obstacles = craters = 0;
+	for( int b = 0; b < bands; b++ )
+	{
+		obstacles += chunkObstacles[b];
+		craters += chunkCraters[b];
+	}
+	frame = NULL;
+}
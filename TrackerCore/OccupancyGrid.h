@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+#include "Registration.h"
+#include "WorkerPool.h"
+
+// Cell states in OccupancyGrid::states()
+#define CELL_UNKNOWN 0
+#define CELL_FREE 1
+#define CELL_OBSTACLE 2
+#define CELL_CRATER 3
+
+typedef struct
+{
+	// Size of a square cell in meters
+	float cellSize;
+	// Area covered, lateral is positive to the right of the sensor
+	float minLateral, maxLateral;
+	float minForward, maxForward;
+	// Mount of the sensor above the floor, pitch is positive tilted down
+	float sensorHeight;
+	float sensorPitch;
+	// Cells reaching further than this above or below the floor are flagged
+	float stepThreshold;
+	// Fewest points for a cell to be known
+	int minimumPoints;
+	// Only every Nth pixel in each direction is back-projected
+	int pixelStride;
+} OccupancyGridConfig;
+
+TRACKERCORE_API void getDefaultOccupancyGridConfig(OccupancyGridConfig* config);
+
+// Top-down height grid built from a depth frame. Each pixel is projected with
+// a per-pixel table of lateral, forward and height coefficients for the
+// current sensor pose, so back-projection is three multiplies per point. Row
+// bands of the frame are binned in parallel into private grids that are then
+// merged, which keeps the threads off each others cache lines.
+class TRACKERCORE_API OccupancyGrid
+{
+public:
+	OccupancyGrid(void);
+	~OccupancyGrid(void);
+
+	// The pool is optional and not owned, without one the grid is built on the calling thread
+	bool initialize(const CameraIntrinsics& depthCamera, const OccupancyGridConfig& config,
+					WorkerPool* pool = NULL, int depthShift = DEPTH_PLAYER_INDEX_SHIFT);
+
+	// Rebuilds the projection table when the sensor moves on its mount
+	void setSensorPose(float height, float pitch);
+
+	void build(const uint16_t* depth);
+
+	// Grid size in cells, rows run forward and columns run lateral
+	int columns(void) const { return gridColumns; }
+	int rows(void) const { return gridRows; }
+
+	// Per-cell results of the last build, row major from the nearest row
+	const float* maxHeights(void) const { return maxHeight; }
+	const float* minHeights(void) const { return minHeight; }
+	const int* pointCounts(void) const { return pointCount; }
+	const uint8_t* states(void) const { return cellState; }
+	// Cells of the last build that rise above or drop below the floor
+	int obstacleCells(void) const { return obstacles; }
+	int craterCells(void) const { return craters; }
+
+private:
+	CameraIntrinsics camera;
+	OccupancyGridConfig settings;
+	WorkerPool* workers;
+	int shift;
+
+	int gridColumns;
+	int gridRows;
+	int bands;
+
+	// Per-pixel lateral, forward and height change per meter of depth, interleaved
+	float* projection;
+
+	// Private grids for each band, laid out band after band
+	float* bandMax;
+	float* bandMin;
+	int* bandCount;
+
+	float* maxHeight;
+	float* minHeight;
+	int* pointCount;
+	uint8_t* cellState;
+	// Obstacle and crater cells found by each merge chunk
+	int* chunkObstacles;
+	int* chunkCraters;
+	int obstacles;
+	int craters;
+
+	const uint16_t* frame;
+
+	void release(void);
+	void binBand(int band);
+	void mergeCells(int chunk);
+	static void binBandTask(void* context, int index);
+	static void mergeTask(void* context, int index);
+
+	OccupancyGrid(const OccupancyGrid&);
+	OccupancyGrid& operator=(const OccupancyGrid&);
+};
@@ -0,0 +1,322 @@
+#include "stdafx.h"
+#include "Registration.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define REGISTRATION_SSE2
+#include <emmintrin.h>
+#endif
+
+static inline int roundToInt(float value)
+{
+	return (int)(value + (value >= 0.0f ? 0.5f : -0.5f));
+}
+
+#ifdef REGISTRATION_SSE2
+// roundToInt on four lanes, half away from zero like the scalar version
+static inline __m128i roundToInt4(__m128 value)
+{
+	const __m128 sign = _mm_castsi128_ps(_mm_set1_epi32((int)0x80000000));
+	__m128 half = _mm_or_ps(_mm_set1_ps(0.5f), _mm_and_ps(value, sign));
+	return _mm_cvttps_epi32(_mm_add_ps(value, half));
+}
+#endif
+
+void getKinectDefaultCalibration(CameraIntrinsics* depth, CameraIntrinsics* color,
+								 CameraExtrinsics* extrinsics)
+{
+	depth->fx = depth->fy = 571.26f;
+	depth->cx = 320.0f;
+	depth->cy = 240.0f;
+	depth->width = 640;
+	depth->height = 480;
+
+	color->fx = color->fy = 525.0f;
+	color->cx = 320.0f;
+	color->cy = 240.0f;
+	color->width = 640;
+	color->height = 480;
+
+	// The IR and RGB cameras sit side by side about 25mm apart
+	memset(extrinsics, 0, sizeof(CameraExtrinsics));
+	extrinsics->rotation[0] = extrinsics->rotation[4] = extrinsics->rotation[8] = 1.0f;
+	extrinsics->translation[0] = -25.0f;
+}
+
+void scaleCameraIntrinsics(CameraIntrinsics* camera, int width, int height)
+{
+	float scaleX = (float)width / camera->width;
+	float scaleY = (float)height / camera->height;
+	camera->fx *= scaleX;
+	camera->cx *= scaleX;
+	camera->fy *= scaleY;
+	camera->cy *= scaleY;
+	camera->width = width;
+	camera->height = height;
+}
+
+DepthRegistration::DepthRegistration()
+{
+	baseX = baseY = slopeX = slopeY = NULL;
+	inverseDepth = NULL;
+	inverseDepthSize = 0;
+	shift = DEPTH_PLAYER_INDEX_SHIFT;
+	useSimd = true;
+	memset(&depthCamera, 0, sizeof(depthCamera));
+	memset(&colorCamera, 0, sizeof(colorCamera));
+	memset(&depthToColor, 0, sizeof(depthToColor));
+	return;
+}
+
+DepthRegistration::~DepthRegistration()
+{
+	release();
+	return;
+}
+
+void DepthRegistration::release(void)
+{
+	delete[] baseX;
+	delete[] baseY;
+	delete[] slopeX;
+	delete[] slopeY;
+	delete[] inverseDepth;
+	baseX = baseY = slopeX = slopeY = NULL;
+	inverseDepth = NULL;
+	inverseDepthSize = 0;
+}
+
+// For a depth pixel with unit-depth ray r the point is P = z * r, and in the
+// color camera Q = R * P + t = z * (R * r) + t. Writing q = R * r and taking
+// t.z as zero the projection splits into a per-pixel constant and a term
+// linear in 1/z:
+//   x = fx * q.x / q.z + cx  +  (fx * t.x / q.z) * (1 / z)
+bool DepthRegistration::initialize(const CameraIntrinsics& depth, const CameraIntrinsics& color,
+								   const CameraExtrinsics& extrinsics, int depthShift)
+{
+	release();
+
+	depthCamera = depth;
+	colorCamera = color;
+	depthToColor = extrinsics;
+	shift = depthShift;
+
+	int pixels = depth.width * depth.height;
+	inverseDepthSize = (0xFFFF >> shift) + 1;
+	try
+	{
+		baseX = new float[pixels];
+		baseY = new float[pixels];
+		slopeX = new float[pixels];
+		slopeY = new float[pixels];
+		inverseDepth = new float[inverseDepthSize];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for registration tables: " << ba.what() << std::endl;
+		release();
+		return false;
+	}
+
+	const float* R = extrinsics.rotation;
+	const float* t = extrinsics.translation;
+	for( int v = 0; v < depth.height; v++ )
+	{
+		float ry = (v - depth.cy) / depth.fy;
+		for( int u = 0; u < depth.width; u++ )
+		{
+			float rx = (u - depth.cx) / depth.fx;
+			float qx = R[0] * rx + R[1] * ry + R[2];
+			float qy = R[3] * rx + R[4] * ry + R[5];
+			float qz = R[6] * rx + R[7] * ry + R[8];
+			int i = v * depth.width + u;
+
+			baseX[i] = color.fx * qx / qz + color.cx;
+			baseY[i] = color.fy * qy / qz + color.cy;
+			slopeX[i] = color.fx * t[0] / qz;
+			slopeY[i] = color.fy * t[1] / qz;
+		}
+	}
+
+	inverseDepth[0] = 0.0f;
+	for( int z = 1; z < inverseDepthSize; z++ )
+		inverseDepth[z] = 1.0f / z;
+
+	return true;
+}
+
+#ifdef REGISTRATION_SSE2
+// Color coordinates of the four depth pixels from i and a mask of those
+// that have a reading. 1/z is divided out rather than looked up, SSE2 has
+// no gather and the division rounds exactly like the table entries.
+static inline void projectFour(const uint16_t* depth, int i, int shift, const float* baseX, const float* baseY,
+							   const float* slopeX, const float* slopeY, __m128i* x, __m128i* y, __m128i* hole)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i z = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)&depth[i]), zero);
+	z = _mm_srl_epi32(z, _mm_cvtsi32_si128(shift));
+	*hole = _mm_cmpeq_epi32(z, zero);
+
+	// Holes divide by zero, their lanes are thrown away by the caller
+	__m128 w = _mm_div_ps(_mm_set1_ps(1.0f), _mm_cvtepi32_ps(_mm_or_si128(z, _mm_srli_epi32(*hole, 31))));
+	*x = roundToInt4(_mm_add_ps(_mm_loadu_ps(&baseX[i]), _mm_mul_ps(_mm_loadu_ps(&slopeX[i]), w)));
+	*y = roundToInt4(_mm_add_ps(_mm_loadu_ps(&baseY[i]), _mm_mul_ps(_mm_loadu_ps(&slopeY[i]), w)));
+}
+#endif
+
+void DepthRegistration::mapDepthToColor(const uint16_t* depth, int* colorCoordinates) const
+{
+	if( inverseDepth == NULL )
+	{
+		std::cerr << "mapDepthToColor called before initialize" << std::endl;
+		return;
+	}
+
+	int pixels = depthCamera.width * depthCamera.height;
+	int i = 0;
+#ifdef REGISTRATION_SSE2
+	if( useSimd )
+	{
+		for( ; i + 4 <= pixels; i += 4 )
+		{
+			__m128i x, y, hole;
+			projectFour(depth, i, shift, baseX, baseY, slopeX, slopeY, &x, &y, &hole);
+			// Holes are all ones, which is the -1 they are reported as
+			x = _mm_or_si128(x, hole);
+			y = _mm_or_si128(y, hole);
+			_mm_storeu_si128((__m128i*)&colorCoordinates[2 * i], _mm_unpacklo_epi32(x, y));
+			_mm_storeu_si128((__m128i*)&colorCoordinates[2 * i + 4], _mm_unpackhi_epi32(x, y));
+		}
+	}
+#endif
+	for( ; i < pixels; i++ )
+	{
+		int z = depth[i] >> shift;
+		float w = inverseDepth[z];
+		int x = roundToInt(baseX[i] + slopeX[i] * w);
+		int y = roundToInt(baseY[i] + slopeY[i] * w);
+		colorCoordinates[2 * i] = z ? x : -1;
+		colorCoordinates[2 * i + 1] = z ? y : -1;
+	}
+}
+
+void DepthRegistration::registerDepthToColor(const uint16_t* depth, uint16_t* registeredDepth) const
+{
+	if( inverseDepth == NULL )
+	{
+		std::cerr << "registerDepthToColor called before initialize" << std::endl;
+		return;
+	}
+
+	memset(registeredDepth, 0, colorCamera.width * colorCamera.height * sizeof(uint16_t));
+
+	int pixels = depthCamera.width * depthCamera.height;
+	int i = 0;
+#ifdef REGISTRATION_SSE2
+	// The projection is done four pixels at a time, the scatter into the
+	// color image has to go one pixel at a time either way
+	if( useSimd )
+	{
+		for( ; i + 4 <= pixels; i += 4 )
+		{
+			__m128i x, y, hole;
+			projectFour(depth, i, shift, baseX, baseY, slopeX, slopeY, &x, &y, &hole);
+			if( _mm_movemask_epi8(hole) == 0xFFFF )
+				continue;
+
+			int xs[4], ys[4];
+			_mm_storeu_si128((__m128i*)xs, x);
+			_mm_storeu_si128((__m128i*)ys, y);
+			for( int k = 0; k < 4; k++ )
+				storeNearest(registeredDepth, depth[i + k], xs[k], ys[k]);
+		}
+	}
+#endif
+	for( ; i < pixels; i++ )
+	{
+		float w = inverseDepth[depth[i] >> shift];
+		storeNearest(registeredDepth, depth[i], roundToInt(baseX[i] + slopeX[i] * w), roundToInt(baseY[i] + slopeY[i] * w));
+	}
+}
+
+// One depth pixel of registerDepthToColor landing on color pixel (x, y)
+void DepthRegistration::storeNearest(uint16_t* registeredDepth, uint16_t raw, int x, int y) const
+{
+	if( !(raw >> shift) )
+		return;
+	// Unsigned compare folds the negative check into the bounds check
+	if( (unsigned)x >= (unsigned)colorCamera.width || (unsigned)y >= (unsigned)colorCamera.height )
+		return;
+
+	uint16_t* target = &registeredDepth[y * colorCamera.width + x];
+	if( *target == 0 || raw < *target )
+		*target = raw;
+}
+
+void DepthRegistration::mapDepthToColorReference(const uint16_t* depth, int* colorCoordinates) const
+{
+	const float* R = depthToColor.rotation;
+	const float* t = depthToColor.translation;
+
+	for( int v = 0; v < depthCamera.height; v++ )
+	{
+		for( int u = 0; u < depthCamera.width; u++ )
+		{
+			int i = v * depthCamera.width + u;
+			int z = depth[i] >> shift;
+			if( !z )
+			{
+				colorCoordinates[2 * i] = colorCoordinates[2 * i + 1] = -1;
+				continue;
+			}
+
+			float px = (u - depthCamera.cx) * z / depthCamera.fx;
+			float py = (v - depthCamera.cy) * z / depthCamera.fy;
+			float pz = (float)z;
+			float qx = R[0] * px + R[1] * py + R[2] * pz + t[0];
+			float qy = R[3] * px + R[4] * py + R[5] * pz + t[1];
+			float qz = R[6] * px + R[7] * py + R[8] * pz + t[2];
+
+			colorCoordinates[2 * i] = roundToInt(colorCamera.fx * qx / qz + colorCamera.cx);
+			colorCoordinates[2 * i + 1] = roundToInt(colorCamera.fy * qy / qz + colorCamera.cy);
+		}
+	}
+}
+
+int DepthRegistration::compareToReference(const uint16_t* depth) const
+{
+	if( inverseDepth == NULL )
+		return -1;
+
+	int pixels = depthCamera.width * depthCamera.height;
+	int* fast = NULL;
+	int* reference = NULL;
+	try
+	{
+		fast = new int[pixels * 2];
+		reference = new int[pixels * 2];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for registration check: " << ba.what() << std::endl;
+		delete[] fast;
+		return -1;
+	}
+
+	mapDepthToColor(depth, fast);
+	mapDepthToColorReference(depth, reference);
+
+	int worst = 0;
+	for( int i = 0; i < pixels * 2; i++ )
+	{
+		int difference = abs(fast[i] - reference[i]);
+		if( difference > worst )
+			worst = difference;
+	}
+
+	delete[] fast;
+	delete[] reference;
+	return worst;
+}
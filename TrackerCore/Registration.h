@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+
+// Depth frames from NUI_IMAGE_TYPE_DEPTH_AND_PLAYER_INDEX keep the player
+// index in the low bits, millimeters are the raw value shifted down by this
+#define DEPTH_PLAYER_INDEX_SHIFT 3
+
+typedef struct
+{
+	// Focal lengths in pixels
+	float fx, fy;
+	// Principal point in pixels
+	float cx, cy;
+	// Image size in pixels
+	int width, height;
+} CameraIntrinsics;
+
+typedef struct
+{
+	// Row major rotation from the depth camera frame to the color camera frame
+	float rotation[9];
+	// Translation from the depth camera to the color camera in millimeters
+	float translation[3];
+} CameraExtrinsics;
+
+// Nominal factory calibration of a 640x480 Kinect v1
+TRACKERCORE_API void getKinectDefaultCalibration(CameraIntrinsics* depth, CameraIntrinsics* color,
+												 CameraExtrinsics* extrinsics);
+
+// Rescales a calibration to the same camera delivering width x height images
+TRACKERCORE_API void scaleCameraIntrinsics(CameraIntrinsics* camera, int width, int height);
+
+// Maps depth pixels into the color image using tables built once from the
+// calibration. With the tables in place a pixel costs two multiply-adds and
+// one lookup of 1/z by depth value, there is no trig or division per pixel.
+// SSE2 builds project four pixels at a time.
+// The tables assume the two cameras share an image plane (no translation
+// along the optical axis), which holds for the Kinect; compareToReference()
+// reports how far that is from the full camera model for a given frame.
+class TRACKERCORE_API DepthRegistration
+{
+public:
+	DepthRegistration(void);
+	~DepthRegistration(void);
+
+	// Builds the per-pixel tables, returns false if allocation fails
+	bool initialize(const CameraIntrinsics& depth, const CameraIntrinsics& color,
+					const CameraExtrinsics& extrinsics, int depthShift = DEPTH_PLAYER_INDEX_SHIFT);
+
+	// Writes an (x, y) color pixel pair for every depth pixel, pixels with
+	// no depth reading get (-1, -1). Coordinates are not clipped to the color image.
+	void mapDepthToColor(const uint16_t* depth, int* colorCoordinates) const;
+
+	// Resamples a depth frame into the color image so depth can be read at a
+	// color pixel, holes are zero and overlapping pixels keep the nearest depth
+	void registerDepthToColor(const uint16_t* depth, uint16_t* registeredDepth) const;
+
+	// Same output as mapDepthToColor but evaluated straight from the camera model
+	void mapDepthToColorReference(const uint16_t* depth, int* colorCoordinates) const;
+
+	// Largest per-axis disagreement in pixels between the fast and reference mapping
+	int compareToReference(const uint16_t* depth) const;
+
+	// Falls back to the scalar loops, used to check the vector paths
+	void setUseSimd(bool enable) { useSimd = enable; }
+
+	const CameraIntrinsics& depthIntrinsics(void) const { return depthCamera; }
+	const CameraIntrinsics& colorIntrinsics(void) const { return colorCamera; }
+
+private:
+	CameraIntrinsics depthCamera;
+	CameraIntrinsics colorCamera;
+	CameraExtrinsics depthToColor;
+	int shift;
+	bool useSimd;
+
+	// Color position of a pixel at infinite depth plus the parallax per unit of 1/z
+	float* baseX;
+	float* baseY;
+	float* slopeX;
+	float* slopeY;
+	// 1/z in 1/mm indexed by the shifted depth value, zero for holes
+	float* inverseDepth;
+	int inverseDepthSize;
+
+	void release(void);
+	void storeNearest(uint16_t* registeredDepth, uint16_t raw, int x, int y) const;
+
+	// Owns its tables, not copyable
+	DepthRegistration(const DepthRegistration&);
+	DepthRegistration& operator=(const DepthRegistration&);
+};
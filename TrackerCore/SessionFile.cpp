@@ -0,0 +1,473 @@
+#include "stdafx.h"
+#include "SessionFile.h"
+#include "DepthCodec.h"
+#include "Timing.h"
+
+#include <string.h>
+#include <thread>
+#include <chrono>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static const char sessionMagic[4] = { 'L', 'S', 'E', 'S' };
+static const char indexMagic[4] = { 'L', 'I', 'D', 'X' };
+
+// Large writes go straight through to the disk in big sequential chunks
+#define SESSION_WRITE_BUFFER (1 << 20)
+
+static uint64_t alignUp(uint64_t value)
+{
+	return (value + SESSION_PAYLOAD_ALIGNMENT - 1) & ~(uint64_t)(SESSION_PAYLOAD_ALIGNMENT - 1);
+}
+
+SessionWriter::SessionWriter()
+{
+	file = NULL;
+	position = 0;
+	entries = NULL;
+	entryCount = entryCapacity = 0;
+	encoded = NULL;
+	encodedCapacity = 0;
+	return;
+}
+
+SessionWriter::~SessionWriter()
+{
+	if( file )
+		close();
+	delete[] entries;
+	delete[] encoded;
+	return;
+}
+
+bool SessionWriter::open(const char* path)
+{
+	if( file )
+		close();
+
+#ifdef _WIN32
+	if( fopen_s(&file, path, "wb") )
+		file = NULL;
+#else
+	file = fopen(path, "wb");
+#endif
+	if( file == NULL )
+	{
+		std::cerr << "Failed to create session file " << path << std::endl;
+		return false;
+	}
+	setvbuf(file, NULL, _IOFBF, SESSION_WRITE_BUFFER);
+
+	position = 0;
+	entryCount = 0;
+
+	SessionFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, sessionMagic, sizeof(sessionMagic));
+	header.version = SESSION_FILE_VERSION;
+	return write(&header, sizeof(header));
+}
+
+bool SessionWriter::write(const void* data, size_t size)
+{
+	if( size && fwrite(data, 1, size, file) != size )
+	{
+		std::cerr << "Failed to write session file" << std::endl;
+		return false;
+	}
+	position += size;
+	return true;
+}
+
+bool SessionWriter::writeRecord(const SessionRecordHeader& header, const void* payload)
+{
+	static const uint8_t padding[SESSION_PAYLOAD_ALIGNMENT] = { 0 };
+
+	if( file == NULL )
+		return false;
+
+	if( entryCount == entryCapacity )
+	{
+		uint32_t capacity = entryCapacity ? entryCapacity * 2 : 1024;
+		SessionIndexEntry* grown;
+		try
+		{
+			grown = new SessionIndexEntry[capacity];
+		}
+		catch( std::bad_alloc& ba )
+		{
+			std::cerr << "Failed to allocate memory for session index: " << ba.what() << std::endl;
+			return false;
+		}
+		if( entryCount )
+			memcpy(grown, entries, entryCount * sizeof(SessionIndexEntry));
+		delete[] entries;
+		entries = grown;
+		entryCapacity = capacity;
+	}
+
+	SessionIndexEntry& entry = entries[entryCount];
+	entry.offset = position;
+	entry.type = header.type;
+	entry.reserved = 0;
+	entry.timestamp = header.timestamp;
+
+	if( !write(&header, sizeof(header)) || !write(payload, header.size) )
+		return false;
+	if( !write(padding, (size_t)(alignUp(position) - position)) )
+		return false;
+
+	entryCount++;
+	return true;
+}
+
+bool SessionWriter::writeColor(const uint8_t* color, int width, int height, int pitch, double timestamp)
+{
+	SessionRecordHeader header;
+	header.type = SESSION_RECORD_COLOR;
+	header.encoding = SESSION_ENCODING_RAW;
+	header.width = width;
+	header.height = height;
+	header.pitch = pitch;
+	header.size = pitch * height;
+	header.timestamp = timestamp;
+	return writeRecord(header, color);
+}
+
+bool SessionWriter::writeDepth(const uint16_t* depth, int width, int height, double timestamp, bool compress)
+{
+	SessionRecordHeader header;
+	header.type = SESSION_RECORD_DEPTH;
+	header.encoding = SESSION_ENCODING_RAW;
+	header.width = width;
+	header.height = height;
+	header.pitch = width * sizeof(uint16_t);
+	header.size = header.pitch * height;
+	header.timestamp = timestamp;
+
+	if( !compress )
+		return writeRecord(header, depth);
+
+	size_t needed = depthCodecMaxEncodedSize(width, height);
+	if( encodedCapacity < needed )
+	{
+		delete[] encoded;
+		encoded = NULL;
+		encodedCapacity = 0;
+		try
+		{
+			encoded = new uint8_t[needed];
+		}
+		catch( std::bad_alloc& ba )
+		{
+			std::cerr << "Failed to allocate memory for depth compression: " << ba.what() << std::endl;
+			return false;
+		}
+		encodedCapacity = needed;
+	}
+
+	header.encoding = SESSION_ENCODING_DEPTH_CODEC;
+	header.size = (uint32_t)encodeDepthFrame(depth, width, height, encoded, encodedCapacity);
+	if( !header.size )
+		return false;
+	return writeRecord(header, encoded);
+}
+
+bool SessionWriter::close(void)
+{
+	if( file == NULL )
+		return false;
+
+	SessionFileFooter footer;
+	memcpy(footer.magic, indexMagic, sizeof(indexMagic));
+	footer.entries = entryCount;
+	footer.indexOffset = position;
+
+	bool ok = write(entries, entryCount * sizeof(SessionIndexEntry)) && write(&footer, sizeof(footer));
+	ok = fclose(file) == 0 && ok;
+	file = NULL;
+	return ok;
+}
+
+SessionPlayback::SessionPlayback()
+{
+	mapping = NULL;
+	mappingSize = 0;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = NULL;
+#else
+	fileDescriptor = -1;
+#endif
+	index = NULL;
+	entryCount = cursor = frames = emitted = 0;
+	frameRecordType = SESSION_RECORD_COLOR;
+	realTime = false;
+	playbackStart = 0.0;
+	depth = NULL;
+	depthWidth = depthHeight = 0;
+	depthTimestamp = 0.0;
+	decodedDepth = NULL;
+	decodedCapacity = 0;
+	return;
+}
+
+SessionPlayback::~SessionPlayback()
+{
+	close();
+	delete[] decodedDepth;
+	return;
+}
+
+void SessionPlayback::close(void)
+{
+#ifdef _WIN32
+	if( mapping )
+		UnmapViewOfFile(mapping);
+	if( mappingHandle )
+		CloseHandle(mappingHandle);
+	if( fileHandle != INVALID_HANDLE_VALUE )
+		CloseHandle(fileHandle);
+	mappingHandle = NULL;
+	fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if( mapping )
+		munmap((void*)mapping, (size_t)mappingSize);
+	if( fileDescriptor >= 0 )
+		::close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	mapping = NULL;
+	mappingSize = 0;
+	index = NULL;
+	entryCount = frames = 0;
+	rewind();
+}
+
+bool SessionPlayback::open(const char* path)
+{
+	close();
+
+	// Read-only, frames are handed out as const pointers into the mapping
+#ifdef _WIN32
+	fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+							 FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if( fileHandle == INVALID_HANDLE_VALUE )
+	{
+		std::cerr << "Failed to open session file " << path << std::endl;
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(fileHandle, &size);
+	mappingSize = size.QuadPart;
+	if( mappingSize >= sizeof(SessionFileHeader) + sizeof(SessionFileFooter) )
+	{
+		mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+		if( mappingHandle )
+			mapping = (const uint8_t*)MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	fileDescriptor = ::open(path, O_RDONLY);
+	if( fileDescriptor < 0 )
+	{
+		std::cerr << "Failed to open session file " << path << std::endl;
+		return false;
+	}
+	struct stat status;
+	fstat(fileDescriptor, &status);
+	mappingSize = status.st_size;
+	if( mappingSize >= sizeof(SessionFileHeader) + sizeof(SessionFileFooter) )
+	{
+		void* view = mmap(NULL, (size_t)mappingSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+		mapping = view == MAP_FAILED ? NULL : (const uint8_t*)view;
+		if( mapping )
+			madvise(view, (size_t)mappingSize, MADV_SEQUENTIAL);
+	}
+#endif
+	if( mapping == NULL )
+	{
+		std::cerr << "Failed to map session file " << path << std::endl;
+		close();
+		return false;
+	}
+
+	// The index has to start aligned between the header and the footer and
+	// fill that space exactly, checked without any sum that could wrap. The
+	// footer is copied out as a truncated file can leave it unaligned.
+	const SessionFileHeader* header = (const SessionFileHeader*)mapping;
+	uint64_t footerOffset = mappingSize - sizeof(SessionFileFooter);
+	SessionFileFooter footer;
+	memcpy(&footer, mapping + footerOffset, sizeof(footer));
+	if( memcmp(header->magic, sessionMagic, sizeof(sessionMagic)) || header->version != SESSION_FILE_VERSION ||
+		memcmp(footer.magic, indexMagic, sizeof(indexMagic)) ||
+		footer.indexOffset < sizeof(SessionFileHeader) || footer.indexOffset > footerOffset ||
+		footer.indexOffset % SESSION_PAYLOAD_ALIGNMENT ||
+		footer.entries > (footerOffset - sizeof(SessionFileHeader)) / sizeof(SessionIndexEntry) ||
+		footer.indexOffset != footerOffset - (uint64_t)footer.entries * sizeof(SessionIndexEntry) )
+	{
+		std::cerr << "Not a complete session file: " << path << std::endl;
+		close();
+		return false;
+	}
+
+	index = (const SessionIndexEntry*)(mapping + footer.indexOffset);
+	entryCount = footer.entries;
+
+	// Check every record fits before handing out pointers into it
+	uint32_t colorRecords = 0;
+	uint32_t depthRecords = 0;
+	for( uint32_t i = 0; i < entryCount; i++ )
+	{
+		const SessionRecordHeader* entry = record(i);
+		if( entry == NULL )
+		{
+			std::cerr << "Corrupt record " << i << " in session file " << path << std::endl;
+			close();
+			return false;
+		}
+		colorRecords += entry->type == SESSION_RECORD_COLOR;
+		depthRecords += entry->type == SESSION_RECORD_DEPTH;
+	}
+
+	frameRecordType = colorRecords ? SESSION_RECORD_COLOR : SESSION_RECORD_DEPTH;
+	frames = colorRecords ? colorRecords : depthRecords;
+	rewind();
+	return true;
+}
+
+const SessionRecordHeader* SessionPlayback::record(uint32_t entry) const
+{
+	// Records sit between the file header and the index, aligned as the
+	// writer puts them so payloads can be handed out as typed pointers
+	uint64_t offset = index[entry].offset;
+	uint64_t indexOffset = (const uint8_t*)index - mapping;
+	if( offset < sizeof(SessionFileHeader) || offset > indexOffset ||
+		indexOffset - offset < sizeof(SessionRecordHeader) || offset % SESSION_PAYLOAD_ALIGNMENT )
+		return NULL;
+
+	const SessionRecordHeader* header = (const SessionRecordHeader*)(mapping + offset);
+	if( header->size > indexOffset - offset - sizeof(SessionRecordHeader) )
+		return NULL;
+	if( header->type != SESSION_RECORD_COLOR && header->type != SESSION_RECORD_DEPTH )
+		return header;
+
+	if( header->width <= 0 || header->height <= 0 || header->width > 0xFFFF || header->height > 0xFFFF )
+		return NULL;
+	if( header->encoding == SESSION_ENCODING_RAW )
+	{
+		int64_t rowBytes = (int64_t)header->width * (header->type == SESSION_RECORD_COLOR ? 4 : sizeof(uint16_t));
+		if( header->pitch < rowBytes || (uint64_t)header->pitch * header->height > header->size )
+			return NULL;
+	}
+	else if( header->encoding != SESSION_ENCODING_DEPTH_CODEC || header->type != SESSION_RECORD_DEPTH )
+	{
+		return NULL;
+	}
+	return header;
+}
+
+bool SessionPlayback::rewind(void)
+{
+	cursor = 0;
+	emitted = 0;
+	depth = NULL;
+	depthWidth = depthHeight = 0;
+	depthTimestamp = 0.0;
+	playbackStart = getTimeSeconds();
+	return mapping != NULL;
+}
+
+bool SessionPlayback::useDepth(const SessionRecordHeader* header)
+{
+	const uint8_t* payload = (const uint8_t*)(header + 1);
+
+	if( header->encoding == SESSION_ENCODING_RAW )
+	{
+		depth = (const uint16_t*)payload;
+	}
+	else if( header->encoding == SESSION_ENCODING_DEPTH_CODEC )
+	{
+		int pixels = header->width * header->height;
+		if( decodedCapacity < pixels )
+		{
+			delete[] decodedDepth;
+			decodedDepth = NULL;
+			decodedCapacity = 0;
+			try
+			{
+				decodedDepth = new uint16_t[pixels];
+			}
+			catch( std::bad_alloc& ba )
+			{
+				std::cerr << "Failed to allocate memory for depth playback: " << ba.what() << std::endl;
+				return false;
+			}
+			decodedCapacity = pixels;
+		}
+		if( !decodeDepthFrame(payload, header->size, decodedDepth, header->width, header->height) )
+		{
+			std::cerr << "Corrupt depth record in session file" << std::endl;
+			return false;
+		}
+		depth = decodedDepth;
+	}
+	else
+	{
+		return false;
+	}
+
+	depthWidth = header->width;
+	depthHeight = header->height;
+	depthTimestamp = header->timestamp;
+	return true;
+}
+
+bool SessionPlayback::nextFrame(Frame* frame)
+{
+	while( cursor < entryCount )
+	{
+		const SessionRecordHeader* header = record(cursor++);
+
+		if( header->type == SESSION_RECORD_DEPTH && !useDepth(header) )
+			return false;
+		if( header->type != frameRecordType )
+			continue;
+
+		if( realTime )
+		{
+			double due = playbackStart + header->timestamp - index[0].timestamp;
+			double wait = due - getTimeSeconds();
+			if( wait > 0.0 )
+				std::this_thread::sleep_for(std::chrono::microseconds((long long)(wait * 1e6)));
+		}
+
+		memset(frame, 0, sizeof(Frame));
+		if( header->type == SESSION_RECORD_COLOR )
+		{
+			frame->color = (const uint8_t*)(header + 1);
+			frame->colorPitch = header->pitch;
+			frame->colorWidth = header->width;
+			frame->colorHeight = header->height;
+			frame->colorTimestamp = header->timestamp;
+		}
+		frame->depth = depth;
+		frame->depthWidth = depthWidth;
+		frame->depthHeight = depthHeight;
+		frame->depthTimestamp = depthTimestamp;
+		frame->index = emitted++;
+		return true;
+	}
+	return false;
+}
+
+double SessionPlayback::duration(void) const
+{
+	if( entryCount < 2 )
+		return 0.0;
+	return index[entryCount - 1].timestamp - index[0].timestamp;
+}
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+#include "FrameSource.h"
+
+// A recorded session is a header, a run of records and an index:
+//
+//   SessionFileHeader
+//   SessionRecordHeader, payload, padding to SESSION_PAYLOAD_ALIGNMENT ...
+//   SessionIndexEntry for every record
+//   SessionFileFooter
+//
+// Payloads start aligned so a memory-mapped file can hand them out in place.
+// All fields are little endian.
+
+#define SESSION_FILE_VERSION 1
+#define SESSION_PAYLOAD_ALIGNMENT 16
+
+#define SESSION_RECORD_COLOR 1
+#define SESSION_RECORD_DEPTH 2
+
+// Payload encodings
+#define SESSION_ENCODING_RAW 0
+#define SESSION_ENCODING_DEPTH_CODEC 1
+
+#pragma pack(push, 4)
+typedef struct
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t reserved[2];
+} SessionFileHeader;
+
+typedef struct
+{
+	uint32_t type;
+	uint32_t encoding;
+	int32_t width;
+	int32_t height;
+	// Bytes per row of a raw payload
+	int32_t pitch;
+	uint32_t size;
+	// Seconds, on whatever clock the writer was given. Playback only uses
+	// differences from the first record.
+	double timestamp;
+} SessionRecordHeader;
+
+typedef struct
+{
+	// File offset of the record header
+	uint64_t offset;
+	uint32_t type;
+	uint32_t reserved;
+	double timestamp;
+} SessionIndexEntry;
+
+typedef struct
+{
+	char magic[4];
+	uint32_t entries;
+	uint64_t indexOffset;
+} SessionFileFooter;
+#pragma pack(pop)
+
+// Writes a session file record by record. The index is kept in memory and
+// written by close(), a session that was never closed cannot be played back.
+class TRACKERCORE_API SessionWriter
+{
+public:
+	SessionWriter(void);
+	~SessionWriter(void);
+
+	bool open(const char* path);
+	bool isOpen(void) const { return file != NULL; }
+
+	// ARGB color frame, pitch in bytes
+	bool writeColor(const uint8_t* color, int width, int height, int pitch, double timestamp);
+	// Raw NUI depth, compressed with the depth codec when asked
+	bool writeDepth(const uint16_t* depth, int width, int height, double timestamp, bool compress = true);
+	// A record whose payload is already encoded
+	bool writeRecord(const SessionRecordHeader& header, const void* payload);
+
+	// Writes the index and footer and closes the file
+	bool close(void);
+
+	uint32_t records(void) const { return entryCount; }
+	uint64_t bytesWritten(void) const { return position; }
+
+private:
+	FILE* file;
+	uint64_t position;
+
+	SessionIndexEntry* entries;
+	uint32_t entryCount;
+	uint32_t entryCapacity;
+
+	// Scratch for compressed depth
+	uint8_t* encoded;
+	size_t encodedCapacity;
+
+	bool write(const void* data, size_t size);
+
+	SessionWriter(const SessionWriter&);
+	SessionWriter& operator=(const SessionWriter&);
+};
+
+// Plays a session file back as a frame source. The file is memory-mapped
+// read-only and raw payloads are handed out in place as const frames, so a
+// frame costs no copy. Every color record produces a
+// frame paired with the latest depth record before it, a session without
+// color produces one frame per depth record.
+class TRACKERCORE_API SessionPlayback : public FrameSource
+{
+public:
+	SessionPlayback(void);
+	~SessionPlayback(void);
+
+	bool open(const char* path);
+	void close(void);
+
+	// In real time frames are held back until their timestamp comes around,
+	// otherwise they are handed out as fast as they are asked for
+	void setRealTime(bool enable) { realTime = enable; }
+
+	bool nextFrame(Frame* frame);
+	bool rewind(void);
+
+	uint32_t frameCount(void) const { return frames; }
+	double duration(void) const;
+
+private:
+	const uint8_t* mapping;
+	uint64_t mappingSize;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+
+	const SessionIndexEntry* index;
+	uint32_t entryCount;
+	uint32_t cursor;
+	uint32_t frames;
+	uint32_t emitted;
+	uint32_t frameRecordType;
+
+	bool realTime;
+	double playbackStart;
+
+	// Latest depth record, decoded here when it was compressed
+	const uint16_t* depth;
+	int depthWidth;
+	int depthHeight;
+	double depthTimestamp;
+	uint16_t* decodedDepth;
+	int decodedCapacity;
+
+	const SessionRecordHeader* record(uint32_t entry) const;
+	bool useDepth(const SessionRecordHeader* header);
+
+	SessionPlayback(const SessionPlayback&);
+	SessionPlayback& operator=(const SessionPlayback&);
+};
@@ -0,0 +1,320 @@
+#include "stdafx.h"
+#include "SyntheticScene.h"
+#include "Registration.h"
+
+#include <string.h>
+#include <math.h>
+
+// Colors a tracker looking for orange has to reject: other hues of similar
+// brightness, and a washed out orange that only fails on saturation
+static const uint32_t distractorColors[] =
+{
+	0x00E02010, // red
+	0x00E0E020, // yellow
+	0x0020C040, // green
+	0x002050E0, // blue
+	0x00A08870, // pale orange
+};
+#define DISTRACTOR_COLOR_COUNT (sizeof(distractorColors) / sizeof(distractorColors[0]))
+
+static inline uint32_t nextRandom(uint32_t* state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static inline uint32_t shadeColor(uint32_t color, int shade)
+{
+	uint32_t red = (((color >> 16) & 0xFF) * shade) >> 8;
+	uint32_t green = (((color >> 8) & 0xFF) * shade) >> 8;
+	uint32_t blue = ((color & 0xFF) * shade) >> 8;
+	return (red << 16) | (green << 8) | blue;
+}
+
+// Folds a position travelling in a straight line back into [low, high] the
+// way a ball bouncing off the walls would move
+static double bounce(double position, double low, double high)
+{
+	double span = high - low;
+	if( span <= 0.0 )
+		return low;
+	double folded = fmod(position - low, 2.0 * span);
+	if( folded < 0.0 )
+		folded += 2.0 * span;
+	return low + (folded > span ? 2.0 * span - folded : folded);
+}
+
+void getDefaultSyntheticSceneConfig(SyntheticSceneConfig* config)
+{
+	config->width = 640;
+	config->height = 480;
+	config->frames = 0;
+	config->frameRate = 30.0;
+	config->targets = 1;
+	config->distractors = 3;
+	config->radius = 24;
+	config->speed = 6.0f;
+	config->targetColor = 0x00FF8C00;
+	config->background = 0x00606060;
+	config->noise = 8;
+	config->gradient = 0.3f;
+	config->sensorHeight = 0.6f;
+	config->sensorPitch = 0.35f;
+	config->seed = 1;
+}
+
+SyntheticScene::SyntheticScene()
+{
+	initialized = false;
+	frameIndex = 0;
+	color = NULL;
+	depth = NULL;
+	floorDepth = NULL;
+	shade = NULL;
+	blobs = 0;
+	targetSumX = targetSumY = 0;
+	targetPixels = 0;
+	return;
+}
+
+SyntheticScene::~SyntheticScene()
+{
+	delete[] color;
+	delete[] depth;
+	delete[] floorDepth;
+	delete[] shade;
+	return;
+}
+
+bool SyntheticScene::initialize(const SyntheticSceneConfig& sceneConfig)
+{
+	delete[] color;
+	delete[] depth;
+	delete[] floorDepth;
+	delete[] shade;
+	color = NULL;
+	depth = NULL;
+	floorDepth = NULL;
+	shade = NULL;
+	initialized = false;
+
+	config = sceneConfig;
+	if( config.width < 1 || config.height < 1 || config.targets < 0 || config.distractors < 0 ||
+		config.targets + config.distractors > SYNTHETIC_MAX_BLOBS )
+		return false;
+
+	int pixels = config.width * config.height;
+	try
+	{
+		color = new uint8_t[pixels * 4];
+		depth = new uint16_t[pixels];
+		floorDepth = new uint16_t[pixels];
+		shade = new int[config.width];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for synthetic scene: " << ba.what() << std::endl;
+		return false;
+	}
+
+	for( int x = 0; x < config.width; x++ )
+	{
+		float fraction = config.width > 1 ? (float)x / (config.width - 1) : 0.0f;
+		shade[x] = (int)(256.0f * (1.0f - config.gradient * fraction));
+		if( shade[x] < 0 )
+			shade[x] = 0;
+	}
+
+	// The floor as the color camera sees it, scaled to the frame size. Past
+	// the range of the sensor it reads as a hole like the real thing.
+	CameraIntrinsics depthIntrinsics, colorIntrinsics;
+	CameraExtrinsics extrinsics;
+	getKinectDefaultCalibration(&depthIntrinsics, &colorIntrinsics, &extrinsics);
+	scaleCameraIntrinsics(&colorIntrinsics, config.width, config.height);
+	float focal = colorIntrinsics.fy;
+	float center = colorIntrinsics.cy;
+	float c = cosf(config.sensorPitch);
+	float s = sinf(config.sensorPitch);
+	for( int y = 0; y < config.height; y++ )
+	{
+		float down = s + (y - center) / focal * c;
+		int mm = 0;
+		if( down > 0.0f && config.sensorHeight / down < 4.0f )
+			mm = (int)(config.sensorHeight / down * 1000.0f);
+		uint16_t value = (uint16_t)(mm << DEPTH_PLAYER_INDEX_SHIFT);
+		for( int x = 0; x < config.width; x++ )
+			floorDepth[y * config.width + x] = value;
+	}
+
+	uint32_t random = config.seed ? config.seed : 1;
+	blobs = config.targets + config.distractors;
+	for( int i = 0; i < blobs; i++ )
+	{
+		BlobMotion& blob = motion[i];
+		blob.x = config.radius + nextRandom(&random) % (uint32_t)(config.width > 2 * config.radius ? config.width - 2 * config.radius : 1);
+		blob.y = config.radius + nextRandom(&random) % (uint32_t)(config.height > 2 * config.radius ? config.height - 2 * config.radius : 1);
+		double angle = (nextRandom(&random) % 3600) * (3.14159265358979 / 1800.0);
+		blob.vx = config.speed * cos(angle);
+		blob.vy = config.speed * sin(angle);
+		blob.color = i < config.targets ? config.targetColor : distractorColors[(i - config.targets) % DISTRACTOR_COLOR_COUNT];
+		blob.range = 1500 + nextRandom(&random) % 2000;
+		truth[i].distractor = i >= config.targets;
+		truth[i].range = blob.range;
+	}
+
+	frameIndex = 0;
+	initialized = true;
+	return true;
+}
+
+bool SyntheticScene::nextFrame(Frame* frame)
+{
+	if( !initialized )
+	{
+		std::cerr << "nextFrame called before initialize" << std::endl;
+		return false;
+	}
+	if( config.frames > 0 && frameIndex >= (uint32_t)config.frames )
+		return false;
+
+	render(frameIndex);
+
+	frame->color = color;
+	frame->colorPitch = config.width * 4;
+	frame->colorWidth = config.width;
+	frame->colorHeight = config.height;
+	frame->colorTimestamp = frameIndex / config.frameRate;
+	frame->depth = depth;
+	frame->depthWidth = config.width;
+	frame->depthHeight = config.height;
+	frame->depthTimestamp = frame->colorTimestamp;
+	frame->index = frameIndex;
+	frameIndex++;
+	return true;
+}
+
+bool SyntheticScene::rewind(void)
+{
+	frameIndex = 0;
+	return initialized;
+}
+
+bool SyntheticScene::targetCentroid(double* x, double* y) const
+{
+	if( !targetPixels )
+		return false;
+	*x = (double)targetSumX / targetPixels;
+	*y = (double)targetSumY / targetPixels;
+	return true;
+}
+
+void SyntheticScene::render(uint32_t index)
+{
+	// Lit background in the first row, copied down to the rest
+	uint32_t* firstRow = (uint32_t*)color;
+	uint32_t background = config.background & 0x00FFFFFF;
+	for( int x = 0; x < config.width; x++ )
+		firstRow[x] = shadeColor(background, shade[x]);
+	for( int y = 1; y < config.height; y++ )
+		memcpy(&color[y * config.width * 4], firstRow, config.width * 4);
+	memcpy(depth, floorDepth, config.width * config.height * sizeof(uint16_t));
+
+	targetSumX = targetSumY = 0;
+	targetPixels = 0;
+
+	// Distractors first so targets are drawn over them
+	for( int pass = 0; pass < 2; pass++ )
+	{
+		for( int i = 0; i < blobs; i++ )
+		{
+			if( truth[i].distractor != (pass == 0) )
+				continue;
+			const BlobMotion& blob = motion[i];
+			double x = bounce(blob.x + blob.vx * index, config.radius, config.width - 1 - config.radius);
+			double y = bounce(blob.y + blob.vy * index, config.radius, config.height - 1 - config.radius);
+			drawBlob(i, x, y);
+		}
+	}
+
+	if( config.noise > 0 )
+		addNoise(index);
+}
+
+void SyntheticScene::drawBlob(int blob, double centerX, double centerY)
+{
+	const BlobMotion& source = motion[blob];
+	SyntheticBlob& result = truth[blob];
+	uint32_t blobColor = source.color & 0x00FFFFFF;
+	uint32_t targetColor = config.targetColor & 0x00FFFFFF;
+	uint16_t blobDepth = (uint16_t)(source.range << DEPTH_PLAYER_INDEX_SHIFT);
+	bool target = !result.distractor;
+
+	int radius = config.radius;
+	int left = (int)floor(centerX - radius), right = (int)ceil(centerX + radius);
+	int top = (int)floor(centerY - radius), bottom = (int)ceil(centerY + radius);
+	left = left < 0 ? 0 : left;
+	top = top < 0 ? 0 : top;
+	right = right >= config.width ? config.width - 1 : right;
+	bottom = bottom >= config.height ? config.height - 1 : bottom;
+
+	int64_t sumX = 0, sumY = 0;
+	int count = 0;
+	for( int y = top; y <= bottom; y++ )
+	{
+		uint32_t* row = (uint32_t*)&color[y * config.width * 4];
+		uint16_t* depthRow = &depth[y * config.width];
+		double dy = y - centerY;
+		for( int x = left; x <= right; x++ )
+		{
+			double dx = x - centerX;
+			if( dx * dx + dy * dy > radius * radius )
+				continue;
+
+			uint32_t value = shadeColor(blobColor, shade[x]);
+			// Overlapping targets leave one target pixel behind, not two
+			if( target && row[x] != shadeColor(targetColor, shade[x]) )
+			{
+				targetSumX += x;
+				targetSumY += y;
+				targetPixels++;
+			}
+			row[x] = value;
+			depthRow[x] = blobDepth;
+			sumX += x;
+			sumY += y;
+			count++;
+		}
+	}
+
+	result.pixels = count;
+	result.x = count ? (double)sumX / count : centerX;
+	result.y = count ? (double)sumY / count : centerY;
+}
+
+// Adds up to config.noise to every channel of every pixel, from a generator
+// seeded by the frame index so the frame comes out the same every time
+void SyntheticScene::addNoise(uint32_t index)
+{
+	uint32_t random = (config.seed ^ (index * 0x9E3779B9u)) | 1;
+	int spread = 2 * config.noise + 1;
+	int pixels = config.width * config.height;
+	uint32_t* pixel = (uint32_t*)color;
+	for( int i = 0; i < pixels; i++ )
+	{
+		uint32_t bits = nextRandom(&random);
+		uint32_t value = pixel[i];
+		uint32_t result = 0;
+		for( int channel = 0; channel < 24; channel += 8 )
+		{
+			int level = (value >> channel) & 0xFF;
+			level += (int)((((bits >> channel) & 0xFF) * spread) >> 8) - config.noise;
+			level = level < 0 ? 0 : (level > 255 ? 255 : level);
+			result |= (uint32_t)level << channel;
+		}
+		pixel[i] = result;
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+#include "FrameSource.h"
+
+#define SYNTHETIC_MAX_BLOBS 16
+
+typedef struct
+{
+	int width, height;
+	// Frames before the stream ends, 0 for an endless stream
+	int frames;
+	double frameRate;
+
+	// Balls in the tracked color and balls in colors the tracker must ignore
+	int targets;
+	int distractors;
+	// Ball radius in pixels
+	int radius;
+	// Ball speed in pixels per frame
+	float speed;
+	// Pixel values as the Kinect delivers them, 0x00RRGGBB
+	uint32_t targetColor;
+	uint32_t background;
+
+	// Peak per channel noise added to every pixel, 0 for none
+	int noise;
+	// Fraction of the brightness lost from the left edge to the right edge
+	float gradient;
+
+	// Sensor mount used to lay the floor into the depth image, meters and radians down from level
+	float sensorHeight;
+	float sensorPitch;
+
+	uint32_t seed;
+} SyntheticSceneConfig;
+
+// Ground truth for one ball of the last frame
+typedef struct
+{
+	// Mean position of the pixels drawn for the ball
+	double x, y;
+	int pixels;
+	// Distance written into the depth image in millimeters
+	int range;
+	bool distractor;
+} SyntheticBlob;
+
+TRACKERCORE_API void getDefaultSyntheticSceneConfig(SyntheticSceneConfig* config);
+
+// Generates color and depth frames of balls bouncing around in front of the
+// camera, with the ground truth of every ball. A frame depends only on the
+// configuration and its index, so a stream is the same on every run and
+// after every rewind.
+//
+// Color frames are in the Kinect BGRX layout with a zero top byte. Depth
+// frames are raw NUI depth already registered to the color image: the floor
+// seen from the configured mount, with every ball a flat disc at its range.
+class TRACKERCORE_API SyntheticScene : public FrameSource
+{
+public:
+	SyntheticScene(void);
+	~SyntheticScene(void);
+
+	bool initialize(const SyntheticSceneConfig& config);
+
+	bool nextFrame(Frame* frame);
+	bool rewind(void);
+
+	// Ground truth of the frame last handed out, targets come first
+	int blobCount(void) const { return blobs; }
+	const SyntheticBlob& blob(int index) const { return truth[index]; }
+
+	// Mean position of all pixels drawn in the target color, which is what a
+	// single color tracker should report. False when no target is in view.
+	bool targetCentroid(double* x, double* y) const;
+
+private:
+	typedef struct
+	{
+		double x, y;
+		double vx, vy;
+		uint32_t color;
+		int range;
+	} BlobMotion;
+
+	SyntheticSceneConfig config;
+	bool initialized;
+	uint32_t frameIndex;
+
+	uint8_t* color;
+	uint16_t* depth;
+	uint16_t* floorDepth;
+	// Brightness of every column out of 256
+	int* shade;
+
+	BlobMotion motion[SYNTHETIC_MAX_BLOBS];
+	SyntheticBlob truth[SYNTHETIC_MAX_BLOBS];
+	int blobs;
+
+	// Target pixels drawn in the last frame, each counted once where targets overlap
+	int64_t targetSumX;
+	int64_t targetSumY;
+	int targetPixels;
+
+	void render(uint32_t index);
+	void drawBlob(int blob, double centerX, double centerY);
+	void addNoise(uint32_t index);
+
+	SyntheticScene(const SyntheticScene&);
+	SyntheticScene& operator=(const SyntheticScene&);
+};
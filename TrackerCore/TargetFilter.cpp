@@ -0,0 +1,221 @@
+#include "stdafx.h"
+#include "TargetFilter.h"
+
+#include <string.h>
+#include <math.h>
+
+void getDefaultTargetFilterConfig(TargetFilterConfig* config)
+{
+	config->constantAcceleration = false;
+	config->processNoise = 20000.0;
+	config->measurementNoise = 1.0;
+	config->initialVelocity = 300.0;
+	config->initialAcceleration = 1000.0;
+	config->gate = 8.0;
+	config->maxCoast = 0.5;
+}
+
+TargetFilter::TargetFilter()
+{
+	TargetFilterConfig defaults;
+	getDefaultTargetFilterConfig(&defaults);
+	initialize(defaults);
+	return;
+}
+
+void TargetFilter::initialize(const TargetFilterConfig& newConfig)
+{
+	config = newConfig;
+	order = config.constantAcceleration ? 3 : 2;
+	reset();
+}
+
+void TargetFilter::reset(void)
+{
+	memset(tracks, 0, sizeof(tracks));
+	memset(axes, 0, sizeof(axes));
+}
+
+void TargetFilter::start(int target, double timestamp, double x, double y)
+{
+	double measurements[2] = { x, y };
+	for( int i = 0; i < 2; i++ )
+	{
+		Axis& axis = axes[target][i];
+		memset(&axis, 0, sizeof(axis));
+		axis.state[0] = measurements[i];
+		axis.covariance[0][0] = config.measurementNoise * config.measurementNoise;
+		axis.covariance[1][1] = config.initialVelocity * config.initialVelocity;
+		axis.covariance[2][2] = config.initialAcceleration * config.initialAcceleration;
+	}
+
+	TargetTrack& track = tracks[target];
+	memset(&track, 0, sizeof(track));
+	track.active = true;
+	track.timestamp = track.lastMeasurement = timestamp;
+	track.updates = 1;
+	publish(target);
+}
+
+// Moves an axis dt seconds ahead, the covariance growing by the process noise
+void TargetFilter::advance(Axis* axis, double dt) const
+{
+	if( dt <= 0.0 )
+		return;
+
+	double dt2 = dt * dt, dt3 = dt2 * dt;
+	double transition[3][3] = { { 1.0, dt, dt2 / 2 }, { 0.0, 1.0, dt }, { 0.0, 0.0, 1.0 } };
+	double noise[3][3];
+	double q = config.processNoise;
+	if( order == 3 )
+	{
+		// White jerk
+		double dt4 = dt3 * dt, dt5 = dt4 * dt;
+		double constantAcceleration[3][3] = { { dt5 / 20, dt4 / 8, dt3 / 6 }, { dt4 / 8, dt3 / 3, dt2 / 2 }, { dt3 / 6, dt2 / 2, dt } };
+		memcpy(noise, constantAcceleration, sizeof(noise));
+	}
+	else
+	{
+		// White acceleration
+		double constantVelocity[3][3] = { { dt3 / 3, dt2 / 2, 0.0 }, { dt2 / 2, dt, 0.0 }, { 0.0, 0.0, 0.0 } };
+		memcpy(noise, constantVelocity, sizeof(noise));
+	}
+
+	double state[3] = { 0.0, 0.0, 0.0 };
+	for( int i = 0; i < order; i++ )
+		for( int j = 0; j < order; j++ )
+			state[i] += transition[i][j] * axis->state[j];
+	memcpy(axis->state, state, sizeof(state));
+
+	// P = F P F' + Q
+	double product[3][3];
+	for( int i = 0; i < order; i++ )
+		for( int j = 0; j < order; j++ )
+		{
+			product[i][j] = 0.0;
+			for( int k = 0; k < order; k++ )
+				product[i][j] += transition[i][k] * axis->covariance[k][j];
+		}
+	for( int i = 0; i < order; i++ )
+		for( int j = 0; j < order; j++ )
+		{
+			double sum = q * noise[i][j];
+			for( int k = 0; k < order; k++ )
+				sum += product[i][k] * transition[j][k];
+			axis->covariance[i][j] = sum;
+		}
+}
+
+// Squared distance of a measurement from the prediction in standard deviations
+double TargetFilter::innovation(const Axis& axis, double measurement) const
+{
+	double residual = measurement - axis.state[0];
+	return residual * residual / (axis.covariance[0][0] + config.measurementNoise * config.measurementNoise);
+}
+
+// Folds a position measurement into an axis
+void TargetFilter::correct(Axis* axis, double measurement) const
+{
+	double variance = axis->covariance[0][0] + config.measurementNoise * config.measurementNoise;
+	double residual = measurement - axis->state[0];
+	double gain[3];
+	double firstRow[3];
+	for( int i = 0; i < order; i++ )
+	{
+		gain[i] = axis->covariance[i][0] / variance;
+		firstRow[i] = axis->covariance[0][i];
+	}
+	for( int i = 0; i < order; i++ )
+	{
+		axis->state[i] += gain[i] * residual;
+		for( int j = 0; j < order; j++ )
+			axis->covariance[i][j] -= gain[i] * firstRow[j];
+	}
+}
+
+void TargetFilter::publish(int target)
+{
+	TargetTrack& track = tracks[target];
+	const Axis& axisX = axes[target][0];
+	const Axis& axisY = axes[target][1];
+	track.x = axisX.state[0];
+	track.y = axisY.state[0];
+	track.vx = axisX.state[1];
+	track.vy = axisY.state[1];
+	track.ax = order == 3 ? axisX.state[2] : 0.0;
+	track.ay = order == 3 ? axisY.state[2] : 0.0;
+	track.sigmaX = sqrt(axisX.covariance[0][0]);
+	track.sigmaY = sqrt(axisY.covariance[0][0]);
+}
+
+void TargetFilter::update(int target, double timestamp, bool found, double x, double y)
+{
+	if( target < 0 || target >= TARGET_FILTER_MAX_TARGETS )
+	{
+		std::cerr << "TargetFilter has no target " << target << std::endl;
+		return;
+	}
+
+	TargetTrack& track = tracks[target];
+	if( !track.active )
+	{
+		if( found )
+			start(target, timestamp, x, y);
+		return;
+	}
+
+	if( timestamp > track.timestamp )
+	{
+		advance(&axes[target][0], timestamp - track.timestamp);
+		advance(&axes[target][1], timestamp - track.timestamp);
+		track.timestamp = timestamp;
+	}
+
+	bool accepted = found;
+	if( found && config.gate > 0.0 &&
+		innovation(axes[target][0], x) + innovation(axes[target][1], y) > config.gate * config.gate )
+	{
+		accepted = false;
+		track.rejected++;
+	}
+
+	if( accepted )
+	{
+		correct(&axes[target][0], x);
+		correct(&axes[target][1], y);
+		track.lastMeasurement = timestamp;
+		track.coasting = false;
+		track.updates++;
+	}
+	else
+	{
+		track.coasting = true;
+		track.misses++;
+		if( timestamp - track.lastMeasurement > config.maxCoast )
+		{
+			// Lost for too long, whatever is measured now starts over
+			track.active = false;
+			if( found )
+				start(target, timestamp, x, y);
+			return;
+		}
+	}
+	publish(target);
+}
+
+void TargetFilter::update(double timestamp, const TrackerCore& tracker)
+{
+	update(0, timestamp, tracker.targetOne.found, tracker.targetOne.x, tracker.targetOne.y);
+}
+
+bool TargetFilter::predict(int target, double timestamp, double* x, double* y) const
+{
+	if( target < 0 || target >= TARGET_FILTER_MAX_TARGETS || !tracks[target].active )
+		return false;
+
+	const TargetTrack& track = tracks[target];
+	double dt = timestamp - track.timestamp;
+	*x = track.x + track.vx * dt + track.ax * dt * dt / 2;
+	*y = track.y + track.vy * dt + track.ay * dt * dt / 2;
+	return true;
+}
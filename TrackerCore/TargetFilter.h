@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+#include "TrackerCore.h"
+
+// centerOne and centerTwo
+#define TARGET_FILTER_MAX_TARGETS 2
+
+typedef struct
+{
+	// Model the target's acceleration as well as its velocity
+	bool constantAcceleration;
+	// Spectral density of the white noise driving the model, acceleration
+	// in px^2/s^3 for constant velocity, jerk in px^2/s^5 for constant acceleration
+	double processNoise;
+	// Standard deviation of a measured centroid in pixels
+	double measurementNoise;
+	// Standard deviation of the velocity and acceleration a new track starts with
+	double initialVelocity;
+	double initialAcceleration;
+	// Measurements further than this many standard deviations from the
+	// prediction are treated as misses, 0 accepts everything
+	double gate;
+	// Seconds a track coasts on its prediction without a measurement before it is dropped
+	double maxCoast;
+} TargetFilterConfig;
+
+TRACKERCORE_API void getDefaultTargetFilterConfig(TargetFilterConfig* config);
+
+// Filtered state of one target
+typedef struct
+{
+	bool active;
+	// The last update brought no usable measurement
+	bool coasting;
+	// Time the state below is for, seconds
+	double timestamp;
+	// Time of the last measurement that was used
+	double lastMeasurement;
+	double x, y;
+	// Pixels per second and per second squared, acceleration stays 0 for constant velocity
+	double vx, vy;
+	double ax, ay;
+	// Standard deviation of the position estimate in pixels
+	double sigmaX, sigmaY;
+	uint32_t updates;
+	uint32_t misses;
+	// Measurements the gate turned away
+	uint32_t rejected;
+} TargetTrack;
+
+// Kalman filter over the centroids TrackerCore reports. Every target keeps
+// its own track; x and y are filtered separately with the same model. A
+// track is started by the first measurement, coasts on its prediction
+// through frames without one, and is dropped after maxCoast seconds.
+// predict() extrapolates to any later time, so a controller can ask for
+// where the target is when its command takes effect instead of where it was
+// when the frame was taken.
+//
+// All state is in the object, nothing is allocated after construction.
+class TRACKERCORE_API TargetFilter
+{
+public:
+	TargetFilter(void);
+
+	void initialize(const TargetFilterConfig& config);
+	// Drops every track
+	void reset(void);
+
+	// One frame for one target, timestamps in seconds and never going back
+	void update(int target, double timestamp, bool found, double x, double y);
+	// One frame of the tracker's result, target 0 is centerOne
+	void update(double timestamp, const TrackerCore& tracker);
+
+	// Where the target will be at timestamp, which may be ahead of the last
+	// update. False when the target has no track.
+	bool predict(int target, double timestamp, double* x, double* y) const;
+
+	const TargetTrack& track(int target) const { return tracks[target]; }
+	const TargetFilterConfig& configuration(void) const { return config; }
+
+private:
+	// Position, velocity and acceleration of one axis and their covariance
+	typedef struct
+	{
+		double state[3];
+		double covariance[3][3];
+	} Axis;
+
+	TargetFilterConfig config;
+	int order;
+	TargetTrack tracks[TARGET_FILTER_MAX_TARGETS];
+	Axis axes[TARGET_FILTER_MAX_TARGETS][2];
+
+	void start(int target, double timestamp, double x, double y);
+	void advance(Axis* axis, double dt) const;
+	double innovation(const Axis& axis, double measurement) const;
+	void correct(Axis* axis, double measurement) const;
+	void publish(int target);
+};
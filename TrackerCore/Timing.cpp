@@ -0,0 +1,45 @@
+#include "stdafx.h"
+#include "Timing.h"
+
+#ifndef _WIN32
+#include <time.h>
+#endif
+
+double getTimeSeconds(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency = { 0 };
+	LARGE_INTEGER counter;
+
+	if( frequency.QuadPart == 0 )
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+#endif
+}
+
+uint64_t getTimeNanoseconds(void)
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency = { 0 };
+	LARGE_INTEGER counter;
+
+	if( frequency.QuadPart == 0 )
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	// Split so the multiply cannot overflow
+	uint64_t seconds = counter.QuadPart / frequency.QuadPart;
+	uint64_t remainder = counter.QuadPart % frequency.QuadPart;
+	return seconds * 1000000000ull + remainder * 1000000000ull / frequency.QuadPart;
+#else
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+#endif
+}
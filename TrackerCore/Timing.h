@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+
+// Monotonic wall clock in seconds, only differences between calls are meaningful
+TRACKERCORE_API double getTimeSeconds(void);
+
+// The same clock in whole nanoseconds, for timestamps that are stored or summed
+TRACKERCORE_API uint64_t getTimeNanoseconds(void);
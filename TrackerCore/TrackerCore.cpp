@@ -1,13 +1,35 @@
 #include "stdafx.h"
 #include "TrackerCore.h"
 
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TRACKER_SSE2 1
+#endif
+
 #define GETRED(x) (x>>16)&0xFF
 #define GETGREEN(x) (x>>8)&0xFF
 #define GETBLUE(x) (x)&0xFF
 
+// The top byte of a pixel is not part of the color
+#define COLOR_BYTES 0x00FFFFFF
+
 TrackerCore::TrackerCore()
 {
 	colorMask = NULL;
+	memset(&targetOne, 0, sizeof(targetOne));
+	computeDescriptors = true;
+	tileCount = tilesSkipped = 0;
+	gateTileSize = gateThreshold = 0;
+	gatePitch = gateSize = 0;
+	gateColumns = gateRows = 0;
+	gateValid = false;
+	gateDescriptors = false;
+	previousImage = NULL;
+	tileSums = NULL;
 	trackingColorOne.hueRangeHigh = trackingColorOne.hueRangeLow = 0;
 	trackingColorOne.satRangeHigh = trackingColorOne.satRangeLow = 0;
 	trackingColorOne.lumRangeHigh = trackingColorOne.lumRangeLow = 0;
@@ -30,8 +52,9 @@ TrackerCore::TrackerCore()
 
 TrackerCore::~TrackerCore()
 { 
-	if( colorMask == NULL )
-		delete colorMask;
+	delete[] colorMask;
+	delete[] previousImage;
+	delete[] tileSums;
 	return;
 }
 
@@ -55,15 +78,175 @@ void TrackerCore::generateColorMask(void)
 	// For every RGB value we find which are in the selected range
 	for (int i = 0; i < NUM_COLOR_VALUES * NUM_COLOR_VALUES * NUM_COLOR_VALUES; i++)
 		colorMask[i] = colorTest(GETRED(i), GETGREEN(i), GETBLUE(i));
+	// Tiles kept from the last frame were classified with the old table
+	resetMotionGating();
 	return;
 }
 
-void TrackerCore::findTarget( void* imageData, int pitch, int size )
+// For every pixel in the block [x0, x1) x [y0, y1) we check its value in the
+// lookup table, if it is there we add the pixel's position to the sums.
+// Positions are summed per row first so y is only multiplied in once a row.
+static void classifyBlock(const int* colorMask, const uint32_t* image, int pitch,
+						  int x0, int y0, int x1, int y1, TargetSums* sums)
+{
+	for( int y = y0; y < y1; y++ )
+	{
+		const uint32_t* row = image + (size_t)y * pitch;
+		int64_t count = 0, sumX = 0;
+		for( int x = x0; x < x1; x++ )
+		{
+			if( colorMask[ row[x] & COLOR_BYTES ] )
+			{
+				sumX += x;
+				count++;
+			}
+		}
+		sums->count += count;
+		sums->sumX += sumX;
+		sums->sumY += count * y;
+	}
+}
+
+// The same as classifyBlock, also summing the second order moments and the
+// bounds. Per row only x is summed, y is multiplied in once the row is done.
+static void describeBlock(const int* colorMask, const uint32_t* image, int pitch,
+						  int x0, int y0, int x1, int y1, TargetSums* sums)
+{
+	for( int y = y0; y < y1; y++ )
+	{
+		const uint32_t* row = image + (size_t)y * pitch;
+		int64_t count = 0, sumX = 0, sumXX = 0;
+		int first = 0, last = 0;
+		for( int x = x0; x < x1; x++ )
+		{
+			if( colorMask[ row[x] & COLOR_BYTES ] )
+			{
+				if( !count )
+					first = x;
+				last = x;
+				sumX += x;
+				sumXX += (int64_t)x * x;
+				count++;
+			}
+		}
+		if( !count )
+			continue;
+		sums->count += count;
+		sums->sumX += sumX;
+		sums->sumY += count * y;
+		sums->sumXX += sumXX;
+		sums->sumYY += count * y * y;
+		sums->sumXY += sumX * y;
+		if( first < sums->left )
+			sums->left = first;
+		if( last > sums->right )
+			sums->right = last;
+		if( y < sums->top )
+			sums->top = y;
+		if( y > sums->bottom )
+			sums->bottom = y;
+	}
+}
+
+static void clearSums(TargetSums* sums)
+{
+	memset(sums, 0, sizeof(*sums));
+	sums->left = sums->top = INT_MAX;
+	sums->right = sums->bottom = -1;
+}
+
+static void addSums(TargetSums* sums, const TargetSums& part)
+{
+	sums->count += part.count;
+	sums->sumX += part.sumX;
+	sums->sumY += part.sumY;
+	sums->sumXX += part.sumXX;
+	sums->sumYY += part.sumYY;
+	sums->sumXY += part.sumXY;
+	if( part.left < sums->left )
+		sums->left = part.left;
+	if( part.right > sums->right )
+		sums->right = part.right;
+	if( part.top < sums->top )
+		sums->top = part.top;
+	if( part.bottom > sums->bottom )
+		sums->bottom = part.bottom;
+}
+
+// Area, centroid and, when the sums have them, shape and bounds
+static void targetFromSums(const TargetSums& sums, bool withShape, TargetDescriptor* target)
+{
+	memset(target, 0, sizeof(*target));
+	if( !sums.count )
+		return;
+	target->found = true;
+	target->area = (int)sums.count;
+	target->x = (float)((double)sums.sumX / sums.count);
+	target->y = (float)((double)sums.sumY / sums.count);
+	if( !withShape )
+		return;
+
+	// Central moments times count squared, exact in 64 bits for images up
+	// to 1600x1600 which covers every Kinect resolution
+	double n2 = (double)sums.count * sums.count;
+	double mu20 = (double)(sums.count * sums.sumXX - sums.sumX * sums.sumX) / n2;
+	double mu02 = (double)(sums.count * sums.sumYY - sums.sumY * sums.sumY) / n2;
+	double mu11 = (double)(sums.count * sums.sumXY - sums.sumX * sums.sumY) / n2;
+
+	// Eigenvalues of the covariance are the variances along the axes
+	double mean = (mu20 + mu02) / 2;
+	double spread = sqrt((mu20 - mu02) * (mu20 - mu02) / 4 + mu11 * mu11);
+	double major = mean + spread;
+	double minor = mean - spread > 0.0 ? mean - spread : 0.0;
+	target->majorAxis = (float)(2.0 * sqrt(major));
+	target->minorAxis = (float)(2.0 * sqrt(minor));
+	target->orientation = (float)(0.5 * atan2(2.0 * mu11, mu20 - mu02));
+	target->eccentricity = major > 0.0 ? (float)sqrt(1.0 - minor / major) : 0.0f;
+	target->left = sums.left;
+	target->top = sums.top;
+	target->right = sums.right;
+	target->bottom = sums.bottom;
+}
+
+// Summed absolute difference of the color bytes of two images over a block.
+// Gives up once the total is past limit, the exact value only matters below it.
+static uint64_t blockDifference(const uint32_t* image, const uint32_t* previous, int pitch,
+								int x0, int y0, int x1, int y1, uint64_t limit)
 {
-	int runningXTotal = 0;
-	int runningYTotal = 0;
-	int totalPoints = 0;
+	uint64_t total = 0;
+	for( int y = y0; y < y1 && total <= limit; y++ )
+	{
+		const uint32_t* a = image + (size_t)y * pitch;
+		const uint32_t* b = previous + (size_t)y * pitch;
+		int x = x0;
+#ifdef TRACKER_SSE2
+		// Four pixels at a time, psadbw sums the byte differences into two 64 bit halves
+		const __m128i colorBytes = _mm_set1_epi32(COLOR_BYTES);
+		__m128i rowTotal = _mm_setzero_si128();
+		for( ; x + 4 <= x1; x += 4 )
+		{
+			__m128i pixelsA = _mm_and_si128(_mm_loadu_si128((const __m128i*)(a + x)), colorBytes);
+			__m128i pixelsB = _mm_and_si128(_mm_loadu_si128((const __m128i*)(b + x)), colorBytes);
+			rowTotal = _mm_add_epi64(rowTotal, _mm_sad_epu8(pixelsA, pixelsB));
+		}
+		uint64_t halves[2];
+		_mm_storeu_si128((__m128i*)halves, rowTotal);
+		total += halves[0] + halves[1];
+#endif
+		for( ; x < x1; x++ )
+		{
+			for( int shift = 0; shift < 24; shift += 8 )
+			{
+				int difference = (int)((a[x] >> shift) & 0xFF) - (int)((b[x] >> shift) & 0xFF);
+				total += difference < 0 ? -difference : difference;
+			}
+		}
+	}
+	return total;
+}
 
+void TrackerCore::findTarget( const void* imageData, int pitch, int size )
+{
 	if( colorMask == NULL )
 	{
 		std::cerr << "findTarget called without a colorMask" << std::endl;
@@ -73,32 +256,150 @@ void TrackerCore::findTarget( void* imageData, int pitch, int size )
 	// size and pitch are in bytes not pixels, so we change them to pixels with 4 bpp
 	pitch /= sizeof(UINT32);
 	size /= sizeof(UINT32);
+	if( pitch <= 0 )
+		return;
 
-	// For every pixel we check its value in the lookup table
-	// if it is there we sum the pixels position
-	for( int i = 0; i < size; i++ )
+	const uint32_t* image = (const uint32_t*)imageData;
+	TargetSums sums;
+	clearSums(&sums);
+	tileCount = tilesSkipped = 0;
+	if( gateTileSize > 0 && prepareMotionGating(pitch, size) )
+		scanGated(image, pitch, size, &sums);
+	else
 	{
-		if( colorMask[ ((UINT32*)imageData)[i] ] )
-		{
-			runningXTotal += i % pitch;
-			runningYTotal += i / pitch;
-			totalPoints++;
-			((UINT8*)imageData)[(i*4)+2] = 0xFF;
-		}
+		// The whole rows, then whatever is left of a last partial one
+		int rows = size / pitch;
+		void (*scan)(const int*, const uint32_t*, int, int, int, int, int, TargetSums*) =
+			computeDescriptors ? describeBlock : classifyBlock;
+		scan(colorMask, image, pitch, 0, 0, pitch, rows, &sums);
+		scan(colorMask, image, pitch, 0, rows, size - rows * pitch, rows + 1, &sums);
 	}
+	targetFromSums(sums, computeDescriptors, &targetOne);
 
 	// then find the average of the tagets pixels, this
 	// could be done better but it needs to be fast and
 	// this blob detector works ok for us
-	if( totalPoints )
+	if( sums.count )
+	{
+		this->centerOne.x = (int)(sums.sumX / sums.count);
+		this->centerOne.y = (int)(sums.sumY / sums.count);
+	}
+
+	return;
+}
+
+void TrackerCore::measureTarget(const void* imageData, int width, int height, int pitch, TargetDescriptor* target) const
+{
+	memset(target, 0, sizeof(*target));
+	if( colorMask == NULL )
 	{
-		this->centerOne.x = runningXTotal / totalPoints;
-		this->centerOne.x = runningYTotal / totalPoints;
+		std::cerr << "measureTarget called without a colorMask" << std::endl;
+		return;
 	}
+	if( width <= 0 || height <= 0 || pitch < width * (int)sizeof(uint32_t) )
+		return;
+
+	TargetSums sums;
+	clearSums(&sums);
+	if( computeDescriptors )
+		describeBlock(colorMask, (const uint32_t*)imageData, pitch / sizeof(uint32_t), 0, 0, width, height, &sums);
+	else
+		classifyBlock(colorMask, (const uint32_t*)imageData, pitch / sizeof(uint32_t), 0, 0, width, height, &sums);
+	targetFromSums(sums, computeDescriptors, target);
+	return;
+}
 
+void TrackerCore::setMotionGating(int tileSize, int threshold)
+{
+	gateTileSize = tileSize > 0 ? tileSize : 0;
+	gateThreshold = threshold > 0 ? threshold : 0;
+	// Tile boundaries move with the size, so everything is classified again
+	gatePitch = gateSize = 0;
+	resetMotionGating();
+	return;
+}
+
+void TrackerCore::resetMotionGating(void)
+{
+	gateValid = false;
 	return;
 }
 
+// Makes sure the previous image and the tile sums fit this image size
+bool TrackerCore::prepareMotionGating(int pitch, int size)
+{
+	if( previousImage && pitch == gatePitch && size == gateSize )
+		return true;
+
+	delete[] previousImage;
+	delete[] tileSums;
+	previousImage = NULL;
+	tileSums = NULL;
+	gateValid = false;
+	gatePitch = gateSize = 0;
+
+	int columns = (pitch + gateTileSize - 1) / gateTileSize;
+	int rows = (size / pitch + gateTileSize - 1) / gateTileSize;
+	try
+	{
+		previousImage = new uint32_t[size];
+		tileSums = new TargetSums[columns * rows + 1];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for motion gating: " << ba.what() << std::endl;
+		delete[] previousImage;
+		previousImage = NULL;
+		return false;
+	}
+	gatePitch = pitch;
+	gateSize = size;
+	gateColumns = columns;
+	gateRows = rows;
+	return true;
+}
+
+// Reclassifies the tiles that changed since they were last classified and
+// adds up the sums of all of them
+void TrackerCore::scanGated(const uint32_t* image, int pitch, int size, TargetSums* sums)
+{
+	int rows = size / pitch;
+	void (*scan)(const int*, const uint32_t*, int, int, int, int, int, TargetSums*) =
+		computeDescriptors ? describeBlock : classifyBlock;
+	// Tiles summed without descriptors cannot stand in for ones with them
+	if( gateDescriptors != computeDescriptors )
+		gateValid = false;
+	gateDescriptors = computeDescriptors;
+
+	tileCount = gateColumns * gateRows;
+	for( int tileRow = 0; tileRow < gateRows; tileRow++ )
+	{
+		int y0 = tileRow * gateTileSize;
+		int y1 = y0 + gateTileSize < rows ? y0 + gateTileSize : rows;
+		for( int tileColumn = 0; tileColumn < gateColumns; tileColumn++ )
+		{
+			int x0 = tileColumn * gateTileSize;
+			int x1 = x0 + gateTileSize < pitch ? x0 + gateTileSize : pitch;
+			TargetSums& tile = tileSums[tileRow * gateColumns + tileColumn];
+
+			if( gateValid && blockDifference(image, previousImage, pitch, x0, y0, x1, y1, gateThreshold) <= (uint64_t)gateThreshold )
+				tilesSkipped++;
+			else
+			{
+				clearSums(&tile);
+				scan(colorMask, image, pitch, x0, y0, x1, y1, &tile);
+				for( int y = y0; y < y1; y++ )
+					memcpy(previousImage + (size_t)y * pitch + x0, image + (size_t)y * pitch + x0, (x1 - x0) * sizeof(uint32_t));
+			}
+			addSums(sums, tile);
+		}
+	}
+
+	// A last partial row is too small to be worth gating
+	scan(colorMask, image, pitch, 0, rows, size - rows * pitch, rows + 1, sums);
+	gateValid = true;
+}
+
 #define MIN(a,b) (((a)<(b))?(a):(b))
 #define MAX(a,b) (((a)>(b))?(a):(b))
 
@@ -1,8 +1,7 @@
-#ifdef TRACKERCORE_EXPORTS
-#define TRACKERCORE_API __declspec(dllexport)
-#else
-#define TRACKERCORE_API __declspec(dllimport)
-#endif
+#pragma once
+
+#include <stdint.h>
+#include "TrackerCoreApi.h"
 
 #define NUM_COLOR_VALUES 256
 
@@ -24,6 +23,37 @@ typedef struct
 	int x, y;
 } Coordinate;
 
+// Sums over the target pixels found in some part of an image. The second
+// order sums and the bounds are only kept when descriptors are computed.
+typedef struct
+{
+	int64_t count;
+	int64_t sumX, sumY;
+	int64_t sumXX, sumYY, sumXY;
+	// Inclusive, left > right when no pixel was found
+	int left, top, right, bottom;
+} TargetSums;
+
+// Size and shape of a target from the moments of its pixels
+typedef struct
+{
+	bool found;
+	// Target pixels
+	int area;
+	// Centroid in pixels, not rounded like centerOne
+	float x, y;
+	// Semi-axes in pixels of the ellipse with the same second moments,
+	// the radius for a disc
+	float majorAxis, minorAxis;
+	// Angle of the major axis from the x axis in radians, y pointing down,
+	// between -pi/2 and pi/2
+	float orientation;
+	// 0 for a disc, approaching 1 as the target gets longer and thinner
+	float eccentricity;
+	// Bounding box, inclusive
+	int left, top, right, bottom;
+} TargetDescriptor;
+
 class TRACKERCORE_API TrackerCore
 {
 public:
@@ -38,15 +68,53 @@ public:
 	Coordinate centerOne;
 	Coordinate centerTwo;
 
+	// Area, shape and extent of the first target from the last findTarget.
+	// Only found, area, x and y are filled in when computeDescriptors is off.
+	TargetDescriptor targetOne;
+	// Accumulate second order moments and bounds in the same pass, on by default
+	bool computeDescriptors;
+
+	// Tiles the last findTarget looked at and how many of those it could
+	// skip, both 0 when motion gating is off
+	int tileCount;
+	int tilesSkipped;
+
 	TrackerCore(void);
 	TrackerCore(int hueRangeHigh, int hueRangeLow, int satRangeHigh,
 				int satRangeLow, int lumRangeHigh, int lumRangeLow);
 	~TrackerCore(void);
 	
 	void generateColorMask(void);
-	// For speed and simplicity we assume 4 byte pixels in ARGB format
-	void findTarget( void* imageData, int pitch, int size );
+	// For speed and simplicity we assume 4 byte pixels in ARGB format,
+	// the image is only read, detections are drawn by whoever displays it
+	void findTarget( const void* imageData, int pitch, int size );
+	// A full scan of a width by height image with rows pitch bytes apart that
+	// only writes the result to target, so any number of threads can measure
+	// frames with one tracker as long as the color mask is left alone
+	void measureTarget(const void* imageData, int width, int height, int pitch, TargetDescriptor* target) const;
+
+	// Splits the image into tileSize square tiles and only reclassifies the
+	// tiles whose color bytes differ from when they were last classified by
+	// more than threshold, summed over the tile. The others reuse the sums
+	// they had. With threshold 0 the result is exactly that of a full scan.
+	// tileSize 0 turns gating off.
+	void setMotionGating(int tileSize, int threshold = 0);
+	// Forgets the previous frame so the next one is classified in full
+	void resetMotionGating(void);
 
 private:
 	int colorTest(int red, int green, int blue);
+
+	// Motion gating state, sized for the pitch and size it was last used with
+	int gateTileSize;
+	int gateThreshold;
+	int gatePitch, gateSize;
+	int gateColumns, gateRows;
+	bool gateValid;
+	bool gateDescriptors;
+	uint32_t* previousImage;
+	TargetSums* tileSums;
+
+	bool prepareMotionGating(int pitch, int size);
+	void scanGated(const uint32_t* image, int pitch, int size, TargetSums* sums);
 };
\ No newline at end of file
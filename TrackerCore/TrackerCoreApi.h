@@ -0,0 +1,12 @@
+#pragma once
+
+// Export macro shared by every public TrackerCore header
+#if defined(_WIN32)
+#ifdef TRACKERCORE_EXPORTS
+#define TRACKERCORE_API __declspec(dllexport)
+#else
+#define TRACKERCORE_API __declspec(dllimport)
+#endif
+#else
+#define TRACKERCORE_API
+#endif
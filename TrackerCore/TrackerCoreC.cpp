@@ -0,0 +1,144 @@
+#include "stdafx.h"
+#include "TrackerCoreC.h"
+#include "TrackerCore.h"
+#include "TargetFilter.h"
+#include "WorkerPool.h"
+
+#include <stddef.h>
+#include <string.h>
+
+// The layout promised in TrackerCoreC.h, whatever the pointer size
+static_assert(sizeof(TrackerCoreFrame) == 32, "TrackerCoreFrame must be 32 bytes");
+static_assert(offsetof(TrackerCoreFrame, stride) == 16 && offsetof(TrackerCoreFrame, pixels) == 24,
+			  "TrackerCoreFrame fields moved");
+static_assert(sizeof(TrackerCoreResult) == 88, "TrackerCoreResult must be 88 bytes");
+static_assert(offsetof(TrackerCoreResult, x) == 20 && offsetof(TrackerCoreResult, reserved) == 84,
+			  "TrackerCoreResult fields moved");
+
+struct TrackerCoreContext
+{
+	TrackerCore tracker;
+	TargetFilter filter;
+	WorkerPool* pool;
+	uint32_t flags;
+
+	// The batch being processed
+	const TrackerCoreFrame* frames;
+	TrackerCoreResult* results;
+};
+
+static void measureFrame(void* context, int index)
+{
+	TrackerCoreContext* tracker = (TrackerCoreContext*)context;
+	const TrackerCoreFrame& frame = tracker->frames[index];
+	TrackerCoreResult& result = tracker->results[index];
+
+	memset(&result, 0, sizeof(result));
+	result.timestamp = frame.timestamp;
+	if( !frame.pixels || frame.width <= 0 || frame.height <= 0 || frame.stride < frame.width * 4 || frame.stride % 4 )
+	{
+		result.status = TRACKERCORE_ERROR_ARGUMENT;
+		return;
+	}
+
+	TargetDescriptor target;
+	tracker->tracker.measureTarget(frame.pixels, frame.width, frame.height, frame.stride, &target);
+	result.status = TRACKERCORE_OK;
+	result.found = target.found;
+	result.area = target.area;
+	result.x = target.x;
+	result.y = target.y;
+	result.majorAxis = target.majorAxis;
+	result.minorAxis = target.minorAxis;
+	result.orientation = target.orientation;
+	result.eccentricity = target.eccentricity;
+	result.left = target.left;
+	result.top = target.top;
+	result.right = target.right;
+	result.bottom = target.bottom;
+}
+
+int32_t TRACKERCORE_CALL trackerCoreVersion(void)
+{
+	return TRACKERCORE_C_VERSION;
+}
+
+TrackerCoreHandle TRACKERCORE_CALL trackerCoreCreate(int32_t threads, uint32_t flags)
+{
+	TrackerCoreContext* tracker = NULL;
+	try
+	{
+		tracker = new TrackerCoreContext();
+		tracker->pool = NULL;
+		tracker->pool = new WorkerPool(threads);
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for tracker: " << ba.what() << std::endl;
+		if( tracker )
+			delete tracker->pool;
+		delete tracker;
+		return NULL;
+	}
+	if( !tracker->tracker.colorMask )
+	{
+		trackerCoreDestroy(tracker);
+		return NULL;
+	}
+
+	tracker->flags = flags;
+	tracker->tracker.computeDescriptors = !(flags & TRACKERCORE_FLAG_NO_SHAPE);
+	tracker->frames = NULL;
+	tracker->results = NULL;
+	return tracker;
+}
+
+void TRACKERCORE_CALL trackerCoreDestroy(TrackerCoreHandle tracker)
+{
+	if( !tracker )
+		return;
+	delete tracker->pool;
+	delete tracker;
+}
+
+void TRACKERCORE_CALL trackerCoreReset(TrackerCoreHandle tracker)
+{
+	if( tracker )
+		tracker->filter.reset();
+}
+
+int32_t TRACKERCORE_CALL trackerCoreProcess(TrackerCoreHandle tracker, const TrackerCoreFrame* frames, TrackerCoreResult* results,
+											  int32_t count)
+{
+	if( !tracker || count < 0 || (count && (!frames || !results)) )
+		return TRACKERCORE_ERROR_ARGUMENT;
+
+	tracker->frames = frames;
+	tracker->results = results;
+	tracker->pool->run(measureFrame, tracker, count);
+
+	// The filter needs the frames one after another, it is cheap next to measuring them
+	int32_t status = TRACKERCORE_OK;
+	for( int32_t i = 0; i < count; i++ )
+	{
+		TrackerCoreResult& result = results[i];
+		if( result.status != TRACKERCORE_OK )
+		{
+			if( status == TRACKERCORE_OK )
+				status = result.status;
+			continue;
+		}
+		if( !(tracker->flags & TRACKERCORE_FLAG_FILTER) )
+			continue;
+
+		tracker->filter.update(0, result.timestamp, result.found != 0, result.x, result.y);
+		const TargetTrack& track = tracker->filter.track(0);
+		result.tracked = track.active;
+		result.coasting = track.coasting;
+		result.filteredX = (float)track.x;
+		result.filteredY = (float)track.y;
+		result.velocityX = (float)track.vx;
+		result.velocityY = (float)track.vy;
+	}
+	return status;
+}
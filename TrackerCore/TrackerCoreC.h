@@ -0,0 +1,112 @@
+#pragma once
+
+/* C interface to the tracking core, for callers that cannot use the C++
+   classes: LabVIEW's Call Library Function node, Python's ctypes and the
+   like. Everything goes through an opaque handle and structs of fixed size
+   types, and a whole batch of frames is handled per call so the language
+   boundary is crossed once per batch instead of once per frame.
+
+   Struct layouts and function meanings only change together with
+   TRACKERCORE_C_VERSION, check trackerCoreVersion() against it. Structs
+   are laid out the same on every ABI with no padding, so callers that pack
+   byte by byte (LabVIEW clusters) see the same offsets and strides: 32 byte
+   frames with the pixel pointer in 8 bytes at offset 24, and 88 byte
+   results. */
+
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+
+#ifdef _WIN32
+#define TRACKERCORE_CALL __cdecl
+#else
+#define TRACKERCORE_CALL
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TRACKERCORE_C_VERSION 1
+
+/* Status codes */
+#define TRACKERCORE_OK 0
+#define TRACKERCORE_ERROR_ARGUMENT -1
+#define TRACKERCORE_ERROR_MEMORY -2
+
+/* Flags for trackerCoreCreate */
+/* Treat the frames of successive batches as one stream and Kalman filter the target over it */
+#define TRACKERCORE_FLAG_FILTER 1
+/* Centroid and area only, skip the moment descriptors */
+#define TRACKERCORE_FLAG_NO_SHAPE 2
+
+typedef struct TrackerCoreContext* TrackerCoreHandle;
+
+typedef struct
+{
+	/* Seconds, only used by the filter */
+	double timestamp;
+	int32_t width;
+	int32_t height;
+	/* Bytes from one row to the next, at least width * 4 */
+	int32_t stride;
+	int32_t reserved;
+	/* 4 bytes per pixel, 0x00RRGGBB as the Kinect delivers it */
+	const void* pixels;
+#if !defined(_WIN64) && !defined(__LP64__)
+	/* Fills out pixels to 8 bytes where pointers are 4, ignored */
+	uint32_t pixelsPad;
+#endif
+} TrackerCoreFrame;
+
+typedef struct
+{
+	double timestamp;
+	/* TRACKERCORE_OK, or why the frame was not processed */
+	int32_t status;
+	int32_t found;
+	int32_t area;
+	/* Centroid in pixels */
+	float x;
+	float y;
+	/* Semi-axes of the ellipse with the target's second moments, angle of the
+	   major axis in radians with y pointing down, 0 for a disc up to 1 for a line */
+	float majorAxis;
+	float minorAxis;
+	float orientation;
+	float eccentricity;
+	/* Bounding box, inclusive */
+	int32_t left;
+	int32_t top;
+	int32_t right;
+	int32_t bottom;
+	/* With TRACKERCORE_FLAG_FILTER: whether there is a track, whether it is
+	   coasting without a measurement, its position and velocity in pixels per second */
+	int32_t tracked;
+	int32_t coasting;
+	float filteredX;
+	float filteredY;
+	float velocityX;
+	float velocityY;
+	int32_t reserved;
+} TrackerCoreResult;
+
+TRACKERCORE_API int32_t TRACKERCORE_CALL trackerCoreVersion(void);
+
+/* threads is how many threads share out a batch, 0 for one per hardware
+   thread. NULL when the tracker cannot be set up. */
+TRACKERCORE_API TrackerCoreHandle TRACKERCORE_CALL trackerCoreCreate(int32_t threads, uint32_t flags);
+TRACKERCORE_API void TRACKERCORE_CALL trackerCoreDestroy(TrackerCoreHandle tracker);
+
+/* Drops the filtered track, for when a new stream starts */
+TRACKERCORE_API void TRACKERCORE_CALL trackerCoreReset(TrackerCoreHandle tracker);
+
+/* Fills results[i] for frames[i], for count frames. Frames are measured in
+   parallel and filtered in order. Returns TRACKERCORE_OK when every frame
+   was processed, otherwise the status of the first one that was not.
+   Not to be called on one handle from two threads at once. */
+TRACKERCORE_API int32_t TRACKERCORE_CALL trackerCoreProcess(TrackerCoreHandle tracker, const TrackerCoreFrame* frames,
+															TrackerCoreResult* results, int32_t count);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,300 @@
+#include "stdafx.h"
+#include "TrackingPipeline.h"
+#include "DepthFilter.h"
+#include "Registration.h"
+#include "Localization.h"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+
+static const char* const pipelineStageNames[TrackingPipeline::STAGE_COUNT] = { "source", "track", "depth", "telemetry" };
+
+struct TrackingPipeline::State
+{
+	TrackingPipelineConfig config;
+	bool initialized;
+	std::atomic<bool> stopping;
+
+	TrackerCore tracker;
+	TargetFilter targetFilter;
+	DepthFilter depthFilter;
+	GroundPlaneEstimator groundPlane;
+	OccupancyGrid grid;
+	DepthRegistration registration;
+	TargetLocalizer localizer;
+	LatencyProfiler profiler;
+
+	int depthWidth, depthHeight;
+	uint16_t* depth;
+	// The depth frame registered to color, when the source's is not already
+	uint16_t* colorDepth;
+	double lastDepthTimestamp;
+	bool haveDepth;
+
+	// Range at the target from the latest depth frame
+	int centerRange;
+	// Held over from the last depth frame for the frames in between
+	bool groundFound;
+	GroundPlane ground;
+	int obstacleCells;
+	int craterCells;
+};
+
+// The nearest reading within PROBE_RADIUS pixels in millimeters, 0 when
+// there is none. Registered depth has holes where no depth pixel landed.
+#define PROBE_RADIUS 2
+
+static int nearestDepth(const uint16_t* depth, int width, int height, Coordinate pixel)
+{
+	int nearest = 0;
+	for( int y = std::max(pixel.y - PROBE_RADIUS, 0); y <= std::min(pixel.y + PROBE_RADIUS, height - 1); y++ )
+		for( int x = std::max(pixel.x - PROBE_RADIUS, 0); x <= std::min(pixel.x + PROBE_RADIUS, width - 1); x++ )
+		{
+			int reading = depth[y * width + x] >> DEPTH_PLAYER_INDEX_SHIFT;
+			if( reading && (!nearest || reading < nearest) )
+				nearest = reading;
+		}
+	return nearest;
+}
+
+void getDefaultTrackingPipelineConfig(TrackingPipelineConfig* config)
+{
+	config->filterDepth = true;
+	config->estimateGround = true;
+	config->buildGrid = true;
+	getDefaultOccupancyGridConfig(&config->grid);
+	// The window CheackDepth in the viewer checks
+	config->alertNear = 750;
+	config->alertFar = 1125;
+	config->gateTileSize = 0;
+	config->gateThreshold = 0;
+	config->filterTarget = true;
+	getDefaultTargetFilterConfig(&config->targetFilter);
+	config->predictAhead = 0.0;
+	config->localizeTarget = true;
+	config->depthRegistered = false;
+	config->sensor = 0;
+}
+
+TrackingPipeline::TrackingPipeline()
+{
+	state = new State();
+	state->initialized = false;
+	state->stopping = false;
+	state->depthWidth = state->depthHeight = 0;
+	state->depth = NULL;
+	state->colorDepth = NULL;
+	state->lastDepthTimestamp = 0.0;
+	state->haveDepth = false;
+	state->centerRange = 0;
+	state->groundFound = false;
+	memset(&state->ground, 0, sizeof(state->ground));
+	state->obstacleCells = state->craterCells = 0;
+	state->profiler.initialize(pipelineStageNames, STAGE_COUNT);
+	return;
+}
+
+TrackingPipeline::~TrackingPipeline()
+{
+	delete[] state->depth;
+	delete[] state->colorDepth;
+	delete state;
+	return;
+}
+
+bool TrackingPipeline::initialize(const TrackingPipelineConfig& config, int depthWidth, int depthHeight, WorkerPool* pool)
+{
+	delete[] state->depth;
+	delete[] state->colorDepth;
+	state->depth = NULL;
+	state->colorDepth = NULL;
+	state->initialized = false;
+	state->stopping = false;
+	state->config = config;
+	state->depthWidth = depthWidth;
+	state->depthHeight = depthHeight;
+	state->haveDepth = false;
+	state->centerRange = 0;
+	state->groundFound = false;
+	state->obstacleCells = state->craterCells = 0;
+
+	try
+	{
+		state->depth = new uint16_t[depthWidth * depthHeight];
+		if( !config.depthRegistered )
+			state->colorDepth = new uint16_t[depthWidth * depthHeight];
+	}
+	catch( std::bad_alloc& ba )
+	{
+		std::cerr << "Failed to allocate memory for pipeline depth: " << ba.what() << std::endl;
+		return false;
+	}
+
+	state->tracker.setMotionGating(config.gateTileSize, config.gateThreshold);
+	state->targetFilter.initialize(config.targetFilter);
+	if( config.filterDepth && !state->depthFilter.initialize(depthWidth, depthHeight) )
+		return false;
+
+	// The calibration is for 640x480, scaled to the frames actually coming
+	// in. Color is taken to come at the depth resolution, as it does from
+	// the Kinect and the synthetic scene.
+	CameraIntrinsics depthIntrinsics, colorIntrinsics;
+	CameraExtrinsics extrinsics;
+	getKinectDefaultCalibration(&depthIntrinsics, &colorIntrinsics, &extrinsics);
+	scaleCameraIntrinsics(&depthIntrinsics, depthWidth, depthHeight);
+	scaleCameraIntrinsics(&colorIntrinsics, depthWidth, depthHeight);
+	if( config.localizeTarget && !state->localizer.initialize(colorIntrinsics) )
+		return false;
+	if( !config.depthRegistered && !state->registration.initialize(depthIntrinsics, colorIntrinsics, extrinsics) )
+		return false;
+
+	// Registered depth is seen through the color camera
+	const CameraIntrinsics& depthCamera = config.depthRegistered ? colorIntrinsics : depthIntrinsics;
+	if( config.estimateGround )
+	{
+		GroundPlaneConfig groundConfig;
+		getDefaultGroundPlaneConfig(&groundConfig);
+		if( !state->groundPlane.initialize(depthCamera, groundConfig, pool) )
+			return false;
+	}
+	if( config.buildGrid && !state->grid.initialize(depthCamera, config.grid, pool) )
+		return false;
+
+	state->initialized = true;
+	return true;
+}
+
+bool TrackingPipeline::process(const Frame& frame, TrackingResult* result)
+{
+	if( !state->initialized )
+	{
+		std::cerr << "process called before initialize" << std::endl;
+		return false;
+	}
+
+	result->sensor = state->config.sensor;
+	result->frame = frame.index;
+	result->timestamp = frame.color ? frame.colorTimestamp : frame.depthTimestamp;
+	result->found = false;
+	result->target.x = result->target.y = -1;
+	memset(&result->shape, 0, sizeof(result->shape));
+	memset(&result->track, 0, sizeof(result->track));
+	result->predictedX = result->predictedY = -1.0;
+	result->located = false;
+	memset(&result->location, 0, sizeof(result->location));
+	if( frame.color )
+	{
+		TrackerCore& tracker = state->tracker;
+		tracker.centerOne.x = tracker.centerOne.y = -1;
+		tracker.findTarget(frame.color, frame.colorPitch, frame.colorPitch * frame.colorHeight);
+		result->found = tracker.centerOne.x >= 0;
+		result->target = tracker.centerOne;
+		result->shape = tracker.targetOne;
+		if( state->config.filterTarget )
+		{
+			state->targetFilter.update(frame.colorTimestamp, tracker);
+			result->track = state->targetFilter.track(0);
+			state->targetFilter.predict(0, frame.colorTimestamp + state->config.predictAhead, &result->predictedX,
+										&result->predictedY);
+		}
+	}
+	LATENCY_MARK(state->profiler, STAGE_TRACK);
+
+	// Sources repeat the latest depth image until a new one comes in, only new ones are worked on
+	result->newDepth = frame.depth && frame.depthWidth == state->depthWidth && frame.depthHeight == state->depthHeight &&
+					   (!state->haveDepth || frame.depthTimestamp != state->lastDepthTimestamp);
+	if( result->newDepth )
+	{
+		if( state->config.filterDepth )
+			state->depthFilter.filter(frame.depth, state->depth);
+		else
+			memcpy(state->depth, frame.depth, state->depthWidth * state->depthHeight * sizeof(uint16_t));
+		state->haveDepth = true;
+		state->lastDepthTimestamp = frame.depthTimestamp;
+
+		if( state->config.estimateGround )
+		{
+			state->groundFound = state->groundPlane.estimate(state->depth);
+			state->ground = state->groundPlane.plane();
+		}
+		if( state->config.buildGrid )
+		{
+			state->grid.build(state->depth);
+			state->obstacleCells = state->grid.obstacleCells();
+			state->craterCells = state->grid.craterCells();
+		}
+		if( state->colorDepth )
+			state->registration.registerDepthToColor(state->depth, state->colorDepth);
+	}
+	// Probed where the target was seen in color, as the viewer does
+	if( state->haveDepth )
+	{
+		const uint16_t* colorDepth = state->colorDepth ? state->colorDepth : state->depth;
+		Coordinate probe;
+		probe.x = state->depthWidth / 2;
+		probe.y = state->depthHeight / 2;
+		if( result->found && frame.colorWidth == state->depthWidth && frame.colorHeight == state->depthHeight )
+			probe = result->target;
+		state->centerRange = nearestDepth(colorDepth, state->depthWidth, state->depthHeight, probe);
+	}
+	result->centerRange = state->centerRange;
+	result->alert = state->haveDepth && state->centerRange > state->config.alertNear &&
+					state->centerRange < state->config.alertFar;
+	result->groundFound = state->groundFound;
+	result->ground = state->ground;
+	result->obstacleCells = state->obstacleCells;
+	result->craterCells = state->craterCells;
+	if( state->config.localizeTarget && result->found && state->haveDepth &&
+		frame.colorWidth == state->depthWidth && frame.colorHeight == state->depthHeight )
+	{
+		const uint16_t* colorDepth = state->colorDepth ? state->colorDepth : state->depth;
+		result->located = state->localizer.localize(colorDepth, result->target, &result->location);
+	}
+	LATENCY_MARK(state->profiler, STAGE_DEPTH);
+	return true;
+}
+
+uint32_t TrackingPipeline::run(FrameSource* source, TelemetrySink* sink, uint32_t maxFrames)
+{
+	uint32_t processed = 0;
+
+	Frame frame;
+	TrackingResult result;
+	while( !state->stopping.load(std::memory_order_relaxed) && (!maxFrames || processed < maxFrames) )
+	{
+		LATENCY_BEGIN(state->profiler);
+		if( !source->nextFrame(&frame) )
+			break;
+		LATENCY_MARK(state->profiler, STAGE_SOURCE);
+
+		if( !process(frame, &result) )
+			break;
+		if( sink )
+			sink->publish(result);
+		LATENCY_MARK(state->profiler, STAGE_TELEMETRY);
+		LATENCY_END(state->profiler);
+		processed++;
+	}
+	return processed;
+}
+
+void TrackingPipeline::stop(void)
+{
+	state->stopping = true;
+}
+
+TrackerCore& TrackingPipeline::tracker(void)
+{
+	return state->tracker;
+}
+
+const LatencyProfiler& TrackingPipeline::latency(void) const
+{
+	return state->profiler;
+}
+
+const OccupancyGrid& TrackingPipeline::grid(void) const
+{
+	return state->grid;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TrackerCoreApi.h"
+#include "TrackerCore.h"
+#include "FrameSource.h"
+#include "GroundPlane.h"
+#include "LatencyProfiler.h"
+#include "TargetFilter.h"
+#include "Localization.h"
+#include "OccupancyGrid.h"
+
+class WorkerPool;
+
+typedef struct
+{
+	// Clean up depth with the temporal and hole filter before using it
+	bool filterDepth;
+	// Fit the ground plane to every new depth frame
+	bool estimateGround;
+	// Bin every new depth frame into a top-down obstacle grid
+	bool buildGrid;
+	OccupancyGridConfig grid;
+	// Range in millimeters at the target, or at the image center when no
+	// target was found, that raises an alert
+	int alertNear;
+	int alertFar;
+	// Motion gating for the tracker, see TrackerCore::setMotionGating, 0 for a full scan
+	int gateTileSize;
+	int gateThreshold;
+	// Run the target through a Kalman filter and predict it predictAhead
+	// seconds past the frame, to make up for the time the result takes to act on
+	bool filterTarget;
+	TargetFilterConfig targetFilter;
+	double predictAhead;
+	// Locate the target in meters from the depth at its centroid. Only
+	// centerOne is located: findTarget looks for one color and never fills
+	// in centerTwo, so there is no pair for TargetLocalizer::localizePair.
+	bool localizeTarget;
+	// The source's depth is already in the color camera, as the synthetic
+	// scene's is. Otherwise it is in the depth camera and gets registered to
+	// color before the range is probed and the target located.
+	bool depthRegistered;
+	// Copied into every result so streams from several sensors can be merged
+	int sensor;
+} TrackingPipelineConfig;
+
+TRACKERCORE_API void getDefaultTrackingPipelineConfig(TrackingPipelineConfig* config);
+
+typedef struct
+{
+	int sensor;
+	uint32_t frame;
+	double timestamp;
+
+	// Target centroid in color pixels, only meaningful when found
+	bool found;
+	Coordinate target;
+	// Area, shape and bounds of the target
+	TargetDescriptor shape;
+	// Filtered track of the target and its predicted position, -1 without a track
+	TargetTrack track;
+	double predictedX, predictedY;
+	// Target in meters in the color camera frame, only meaningful when located
+	bool located;
+	Point3D location;
+
+	// Set when the frame brought a depth image the pipeline had not seen yet
+	bool newDepth;
+	// Nearest range in millimeters within 2 pixels of the target, or of the
+	// image center when no target was found, 0 for a hole
+	int centerRange;
+	bool alert;
+	bool groundFound;
+	GroundPlane ground;
+	// Obstacle and crater cells in the grid, see TrackingPipeline::grid
+	int obstacleCells;
+	int craterCells;
+} TrackingResult;
+
+// Receives the result of every frame, from the thread running the pipeline
+class TRACKERCORE_API TelemetrySink
+{
+public:
+	virtual ~TelemetrySink(void) {}
+	virtual void publish(const TrackingResult& result) = 0;
+};
+
+// Capture, tracking, depth checks and telemetry with nothing to show on
+// screen. Color is tracked in place in the source's frame, so apart from
+// depth filtering no frame is copied.
+class TRACKERCORE_API TrackingPipeline
+{
+public:
+	enum
+	{
+		STAGE_SOURCE,
+		STAGE_TRACK,
+		STAGE_DEPTH,
+		STAGE_TELEMETRY,
+		STAGE_COUNT
+	};
+
+	TrackingPipeline(void);
+	~TrackingPipeline(void);
+
+	// The pool is optional and not owned
+	bool initialize(const TrackingPipelineConfig& config, int depthWidth = 640, int depthHeight = 480,
+					WorkerPool* pool = NULL);
+
+	// Runs one frame through tracking and the depth checks
+	bool process(const Frame& frame, TrackingResult* result);
+
+	// Pulls frames from the source until it runs dry, stop() is called or
+	// maxFrames (0 for no limit) went through, returns how many did
+	uint32_t run(FrameSource* source, TelemetrySink* sink, uint32_t maxFrames = 0);
+
+	// Safe from any thread, run() returns after the frame in flight and
+	// returns straight away from then on until initialize() is called again
+	void stop(void);
+
+	TrackerCore& tracker(void);
+	const LatencyProfiler& latency(void) const;
+	// Built from the latest depth frame when the config asks for it
+	const OccupancyGrid& grid(void) const;
+
+private:
+	struct State;
+	State* state;
+
+	TrackingPipeline(const TrackingPipeline&);
+	TrackingPipeline& operator=(const TrackingPipeline&);
+};
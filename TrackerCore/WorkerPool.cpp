@@ -0,0 +1,142 @@
+#include "stdafx.h"
+#include "WorkerPool.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+struct WorkerPool::State
+{
+	std::vector<std::thread> threads;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable finished;
+
+	// The current job, replaced under lock each time the generation changes
+	WorkerTask task;
+	void* context;
+	int count;
+	unsigned generation;
+	bool stopping;
+
+	std::atomic<int> next;
+	// Workers that have not yet checked out of the current job
+	int pending;
+};
+
+// Pulls indices until the current job runs dry
+static void drainJob(WorkerTask task, void* context, int count, std::atomic<int>& next)
+{
+	for( ;; )
+	{
+		int index = next.fetch_add(1);
+		if( index >= count )
+			break;
+		task(context, index);
+	}
+}
+
+WorkerPool::WorkerPool(int threads)
+{
+	state = new State();
+	state->task = NULL;
+	state->context = NULL;
+	state->count = 0;
+	state->generation = 0;
+	state->stopping = false;
+	state->next = 0;
+	state->pending = 0;
+
+	if( threads <= 0 )
+		threads = (int)std::thread::hardware_concurrency();
+	if( threads <= 0 )
+		threads = 1;
+
+	// The caller counts as one of the threads
+	for( int i = 1; i < threads; i++ )
+		state->threads.push_back(std::thread(workerMain, state));
+	return;
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(state->lock);
+		state->stopping = true;
+	}
+	state->wake.notify_all();
+	for( size_t i = 0; i < state->threads.size(); i++ )
+		state->threads[i].join();
+	delete state;
+	return;
+}
+
+int WorkerPool::size(void) const
+{
+	return (int)state->threads.size() + 1;
+}
+
+void WorkerPool::workerMain(State* state)
+{
+	unsigned seen = 0;
+
+	for( ;; )
+	{
+		WorkerTask task;
+		void* context;
+		int count;
+		{
+			std::unique_lock<std::mutex> guard(state->lock);
+			while( !state->stopping && state->generation == seen )
+				state->wake.wait(guard);
+			if( state->stopping )
+				return;
+			seen = state->generation;
+			task = state->task;
+			context = state->context;
+			count = state->count;
+		}
+
+		drainJob(task, context, count, state->next);
+
+		{
+			std::lock_guard<std::mutex> guard(state->lock);
+			if( --state->pending == 0 )
+				state->finished.notify_all();
+		}
+	}
+}
+
+void WorkerPool::run(WorkerTask task, void* context, int count)
+{
+	if( count <= 0 )
+		return;
+
+	if( state->threads.empty() || count == 1 )
+	{
+		for( int i = 0; i < count; i++ )
+			task(context, i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(state->lock);
+		state->task = task;
+		state->context = context;
+		state->count = count;
+		state->next = 0;
+		state->pending = (int)state->threads.size();
+		state->generation++;
+	}
+	state->wake.notify_all();
+
+	drainJob(task, context, count, state->next);
+
+	// Every worker checks out of every job, so none can still be
+	// holding this one when the next job resets the index
+	std::unique_lock<std::mutex> guard(state->lock);
+	while( state->pending > 0 )
+		state->finished.wait(guard);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "TrackerCoreApi.h"
+
+// Work item for WorkerPool::run, called once per index
+typedef void (*WorkerTask)(void* context, int index);
+
+// A fixed set of threads that are kept around between frames so splitting
+// per-frame work into bands does not pay for thread creation every time.
+// The calling thread takes part in the work, so a pool of one thread runs
+// everything inline.
+class TRACKERCORE_API WorkerPool
+{
+public:
+	// Zero threads means one per hardware thread
+	WorkerPool(int threads = 0);
+	~WorkerPool(void);
+
+	// Number of threads taking part in run, including the caller
+	int size(void) const;
+
+	// Runs task(context, i) for every i in [0, count) and returns when all are done
+	void run(WorkerTask task, void* context, int count);
+
+private:
+	struct State;
+	State* state;
+
+	static void workerMain(State* state);
+
+	WorkerPool(const WorkerPool&);
+	WorkerPool& operator=(const WorkerPool&);
+};
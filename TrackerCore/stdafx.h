@@ -1,9 +1,19 @@
 #pragma once
 
+#ifdef _WIN32
 #include "targetver.h"
 
 #define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
 #include <windows.h>
+#else
+// Outside of Windows we only need the fixed width types the core uses
+#include <stdint.h>
+#include <stddef.h>
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+#endif
 
 #include <iostream>
 #include <exception>
\ No newline at end of file
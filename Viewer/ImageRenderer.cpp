@@ -17,7 +17,8 @@ ImageRenderer::ImageRenderer() :
     m_sourceStride(0),
     m_pD2DFactory(NULL), 
     m_pRenderTarget(NULL),
-    m_pBitmap(0)
+    m_pBitmap(0),
+    m_pOverlayBrush(NULL)
 {
 }
 
@@ -70,6 +71,16 @@ HRESULT ImageRenderer::EnsureResources()
             SafeRelease(m_pRenderTarget);
             return hr;
         }
+
+        // Brush for the target overlay
+        hr = m_pRenderTarget->CreateSolidColorBrush(D2D1::ColorF(D2D1::ColorF::Red), &m_pOverlayBrush);
+
+        if ( FAILED(hr) )
+        {
+            SafeRelease(m_pBitmap);
+            SafeRelease(m_pRenderTarget);
+            return hr;
+        }
     }
 
     return hr;
@@ -82,6 +93,7 @@ void ImageRenderer::DiscardResources()
 {
     SafeRelease(m_pRenderTarget);
     SafeRelease(m_pBitmap);
+    SafeRelease(m_pOverlayBrush);
 }
 
 /// <summary>
@@ -123,6 +135,18 @@ HRESULT ImageRenderer::Initialize(HWND hWnd, ID2D1Factory* pD2DFactory, int sour
 /// <param name="cbImage">size of image data in bytes</param>
 /// <returns>indicates success or failure</returns>
 HRESULT ImageRenderer::Draw(BYTE* pImage, unsigned long cbImage)
+{
+    return Draw(pImage, cbImage, NULL);
+}
+
+/// <summary>
+/// Draws an image with the tracked targets marked over it, the image itself is left untouched
+/// </summary>
+/// <param name="pImage">image data in RGBX format</param>
+/// <param name="cbImage">size of image data in bytes</param>
+/// <param name="pOverlay">targets to mark, in image pixels</param>
+/// <returns>indicates success or failure</returns>
+HRESULT ImageRenderer::Draw(const BYTE* pImage, unsigned long cbImage, const DisplayOverlay* pOverlay)
 {
     // incorrectly sized image data passed in
     if ( cbImage < ((m_sourceHeight - 1) * m_sourceStride) + (m_sourceWidth * 4) )
@@ -151,6 +175,42 @@ HRESULT ImageRenderer::Draw(BYTE* pImage, unsigned long cbImage)
 
     // Draw the bitmap stretched to the size of the window
     m_pRenderTarget->DrawBitmap(m_pBitmap);
+
+    if (pOverlay)
+    {
+        // Overlay coordinates are image pixels, stretch them the same way
+        D2D1_SIZE_F targetSize = m_pRenderTarget->GetSize();
+        m_pRenderTarget->SetTransform(D2D1::Matrix3x2F::Scale(
+            targetSize.width / m_sourceWidth, targetSize.height / m_sourceHeight));
+
+        for (int i = 0; i < pOverlay->targetCount && i < DISPLAY_MAX_TARGETS; ++i)
+        {
+            const DisplayTarget& target = pOverlay->targets[i];
+            if (!target.found)
+            {
+                continue;
+            }
+
+            if (target.hasBox)
+            {
+                m_pRenderTarget->DrawRectangle(
+                    D2D1::RectF((FLOAT)target.left, (FLOAT)target.top, (FLOAT)target.right + 1, (FLOAT)target.bottom + 1),
+                    m_pOverlayBrush, 1.5f);
+            }
+            if (target.radius > 0)
+            {
+                m_pRenderTarget->DrawEllipse(
+                    D2D1::Ellipse(D2D1::Point2F(target.x, target.y), target.radius, target.radius),
+                    m_pOverlayBrush, 1.5f);
+            }
+
+            // Cross hair on the centroid
+            m_pRenderTarget->DrawLine(D2D1::Point2F(target.x - 8, target.y), D2D1::Point2F(target.x + 8, target.y), m_pOverlayBrush, 2.0f);
+            m_pRenderTarget->DrawLine(D2D1::Point2F(target.x, target.y - 8), D2D1::Point2F(target.x, target.y + 8), m_pOverlayBrush, 2.0f);
+        }
+
+        m_pRenderTarget->SetTransform(D2D1::Matrix3x2F::Identity());
+    }
             
     hr = m_pRenderTarget->EndDraw();
 
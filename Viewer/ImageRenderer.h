@@ -9,6 +9,7 @@
 #pragma once
 
 #include <d2d1.h>
+#include "DisplayMailbox.h"
 
 class ImageRenderer
 {
@@ -43,6 +44,15 @@ public:
     /// <returns>indicates success or failure</returns>
     HRESULT Draw(BYTE* pImage, unsigned long cbImage);
 
+    /// <summary>
+    /// Draws an image with the tracked targets marked over it, the image itself is left untouched
+    /// </summary>
+    /// <param name="pImage">image data in RGBX format</param>
+    /// <param name="cbImage">size of image data in bytes</param>
+    /// <param name="pOverlay">targets to mark, in image pixels</param>
+    /// <returns>indicates success or failure</returns>
+    HRESULT Draw(const BYTE* pImage, unsigned long cbImage, const DisplayOverlay* pOverlay);
+
 private:
     HWND                     m_hWnd;
 
@@ -55,6 +65,7 @@ private:
     ID2D1Factory*            m_pD2DFactory;
     ID2D1HwndRenderTarget*   m_pRenderTarget;
     ID2D1Bitmap*             m_pBitmap;
+    ID2D1SolidColorBrush*    m_pOverlayBrush;
 
     /// <summary>
     /// Ensure necessary Direct2d resources are created
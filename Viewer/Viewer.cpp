@@ -3,6 +3,12 @@
 #include "Viewer.h"
 #include "resource.h"
 
+// Seconds between latency snapshots written to LATENCY_SNAPSHOT_PATH
+#define LATENCY_SNAPSHOT_INTERVAL 5.0
+#define LATENCY_SNAPSHOT_PATH "latency.json"
+
+static const char* const latencyStageNames[] = { "wait", "copy", "track", "publish", "depth", "send" };
+
 /// <summary>
 /// Entry point for the application
 /// </summary>
@@ -14,6 +20,10 @@
 int APIENTRY wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdLine, int nCmdShow)
 {
     Viewer application;
+    if (lpCmdLine && lpCmdLine[0])
+    {
+        application.StartRecording(lpCmdLine);
+    }
     application.Run(hInstance, nCmdShow);
 }
 
@@ -25,10 +35,34 @@ Viewer::Viewer() :
     m_pDrawColor(NULL),
     m_hNextColorFrameEvent(INVALID_HANDLE_VALUE),
     m_pColorStreamHandle(INVALID_HANDLE_VALUE),
-    m_pNuiSensor(NULL)
+    m_pNuiSensor(NULL),
+    m_hTrackingThread(NULL)
 {
 	m_depthD16 = new USHORT[640*480];
-    m_colorRGBX = new BYTE[640*480*4];
+    m_colorRGBX = NULL;
+    m_registeredD16 = new USHORT[640*480];
+
+    m_display.initialize(cColorWidth, cColorHeight);
+    m_displayLimiter.setRate(cDisplayRate);
+    m_hDisplayFrameEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+    m_hStopTracking = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    m_bFilterDepth = m_depthFilter.initialize(640, 480);
+
+    m_latency.initialize(latencyStageNames, LatencyStageCount);
+    m_lastLatencySnapshot = getTimeSeconds();
+    m_lastColorFrameNumber = 0;
+    m_bColorFrameNumberValid = false;
+
+    // Build the depth to color tables once from the nominal calibration
+    CameraIntrinsics depthIntrinsics, colorIntrinsics;
+    CameraExtrinsics extrinsics;
+    getKinectDefaultCalibration(&depthIntrinsics, &colorIntrinsics, &extrinsics);
+    m_registration.initialize(depthIntrinsics, colorIntrinsics, extrinsics);
+
+    GroundPlaneConfig groundConfig;
+    getDefaultGroundPlaneConfig(&groundConfig);
+    m_groundPlane.initialize(depthIntrinsics, groundConfig, &m_workers);
 }
 
 /// <summary>
@@ -36,6 +70,10 @@ Viewer::Viewer() :
 /// </summary>
 Viewer::~Viewer()
 {
+    StopTracking();
+    CloseHandle(m_hStopTracking);
+    CloseHandle(m_hDisplayFrameEvent);
+
     if (m_pNuiSensor)
     {
         m_pNuiSensor->NuiShutdown();
@@ -54,6 +92,25 @@ Viewer::~Viewer()
     SafeRelease(m_pD2DFactory);
 
     SafeRelease(m_pNuiSensor);
+
+    delete[] m_depthD16;
+    delete[] m_registeredD16;
+}
+
+/// <summary>
+/// Records raw color and depth frames to a session file in the background
+/// </summary>
+/// <param name="path">session file to create</param>
+/// <returns>true if recording started</returns>
+bool Viewer::StartRecording(LPCWSTR path)
+{
+    char narrowPath[MAX_PATH];
+    if (!WideCharToMultiByte(CP_ACP, 0, path, -1, narrowPath, MAX_PATH, NULL, NULL))
+    {
+        return false;
+    }
+
+    return m_recorder.start(narrowPath);
 }
 
 /// <summary>
@@ -92,27 +149,40 @@ int Viewer::Run(HINSTANCE hInstance, int nCmdShow)
     // Show window
     ShowWindow(hWndApp, nCmdShow);
 
-    const int eventCount = 1;
-    HANDLE hEvents[eventCount];
-
-    // Main message loop
+    // Main message loop, the Kinect is handled on the tracking thread so
+    // this one only keeps the window going and redraws it
     while (WM_QUIT != msg.message)
     {
-        hEvents[0] = m_hNextColorFrameEvent;
+        // Sleep until the next redraw is allowed, then until a new frame comes in,
+        // waking up for window messages either way
+        double delay = m_displayLimiter.wait(getTimeSeconds());
+        if (delay > 0)
+        {
+            MsgWaitForMultipleObjects(0, NULL, FALSE, static_cast<DWORD>(delay * 1000) + 1, QS_ALLINPUT);
+        }
+        else
+        {
+            MsgWaitForMultipleObjects(1, &m_hDisplayFrameEvent, FALSE, INFINITE, QS_ALLINPUT);
+        }
 
-        // Check to see if we have either a message (by passing in QS_ALLINPUT)
-        // Or a Kinect event (hEvents)
-        // Update() will check for Kinect events individually, in case more than one are signalled
-        DWORD dwEvent = MsgWaitForMultipleObjects(eventCount, hEvents, FALSE, INFINITE, QS_ALLINPUT);
+        DrawLatestFrame();
 
-        // Check if this is an event we're waiting on and not a timeout or message
-        if (WAIT_OBJECT_0 == dwEvent)
+#if LATENCY_PROFILING
+        // Written from here so the file system never holds up tracking
+        if (getTimeSeconds() - m_lastLatencySnapshot > LATENCY_SNAPSHOT_INTERVAL)
         {
-            Update();
+            m_latency.saveJson(LATENCY_SNAPSHOT_PATH);
+            m_lastLatencySnapshot = getTimeSeconds();
         }
+#endif
 
-        if (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE))
+        while (PeekMessageW(&msg, NULL, 0, 0, PM_REMOVE))
         {
+            if (WM_QUIT == msg.message)
+            {
+                break;
+            }
+
             // If a dialog message will be taken care of by the dialog proc
             if ((hWndApp != NULL) && IsDialogMessageW(hWndApp, &msg))
             {
@@ -143,8 +213,88 @@ void Viewer::Update()
     }
 	if ( WAIT_OBJECT_0 == WaitForSingleObject(m_hNextDepthFrameEvent, 0) )
     {
-        ProcessDepth();
+        if ( SUCCEEDED(ProcessDepth()) )
+        {
+            m_groundPlane.estimate(m_depthD16);
+        }
+        LATENCY_MARK(m_latency, LatencyDepth);
 		CheackDepth();
+        LATENCY_MARK(m_latency, LatencySend);
+    }
+}
+
+/// <summary>
+/// Starts the thread that waits on the sensor and runs Update for every frame
+/// </summary>
+void Viewer::StartTracking()
+{
+    if (NULL == m_hTrackingThread)
+    {
+        ResetEvent(m_hStopTracking);
+        m_hTrackingThread = CreateThread(NULL, 0, Viewer::TrackingThread, this, 0, NULL);
+    }
+}
+
+/// <summary>
+/// Stops the tracking thread and waits for it to finish
+/// </summary>
+void Viewer::StopTracking()
+{
+    if (NULL != m_hTrackingThread)
+    {
+        SetEvent(m_hStopTracking);
+        WaitForSingleObject(m_hTrackingThread, INFINITE);
+        CloseHandle(m_hTrackingThread);
+        m_hTrackingThread = NULL;
+    }
+}
+
+/// <summary>
+/// Tracking thread entry point
+/// </summary>
+/// <param name="lpParam">the Viewer</param>
+/// <returns>always 0</returns>
+DWORD WINAPI Viewer::TrackingThread(LPVOID lpParam)
+{
+    Viewer* pThis = static_cast<Viewer*>(lpParam);
+
+    // Stop comes first so it wins when both are signalled
+    HANDLE hEvents[2] = { pThis->m_hStopTracking, pThis->m_hNextColorFrameEvent };
+
+    for (;;)
+    {
+        LATENCY_BEGIN(pThis->m_latency);
+        DWORD dwEvent = WaitForMultipleObjects(2, hEvents, FALSE, INFINITE);
+        if (WAIT_OBJECT_0 + 1 != dwEvent)
+        {
+            break;
+        }
+
+        LATENCY_MARK(pThis->m_latency, LatencyWait);
+        pThis->Update();
+        LATENCY_END(pThis->m_latency);
+    }
+
+    return 0;
+}
+
+/// <summary>
+/// Draws the newest tracked frame if the display rate allows
+/// </summary>
+void Viewer::DrawLatestFrame()
+{
+    double now = getTimeSeconds();
+    if (NULL == m_pDrawColor || m_displayLimiter.wait(now) > 0)
+    {
+        return;
+    }
+
+    const uint8_t* pPixels;
+    const DisplayOverlay* pOverlay;
+    if (m_display.acquire(&pPixels, &pOverlay))
+    {
+        m_displayLimiter.ready(now);
+        m_pDrawColor->Draw(pPixels, m_display.pitch() * m_display.height(), pOverlay);
     }
 }
 
@@ -206,8 +356,11 @@ LRESULT CALLBACK Viewer::DlgProc(HWND hWnd, UINT message, WPARAM wParam, LPARAM
 			// Create and initialize a new TrackerCore
 			m_pTrackerCore = new TrackerCore();
 
-            // Look for a connected Kinect, and create it if found
-            CreateFirstConnected();
+            // Look for a connected Kinect, and start tracking it if found
+            if (SUCCEEDED(CreateFirstConnected()))
+            {
+                StartTracking();
+            }
         }
         break;
 
@@ -318,6 +471,12 @@ HRESULT Viewer::ProcessDepth()
     if ( FAILED(hr) ) { return hr; }
 
     memcpy(m_depthD16, LockedRect.pBits, LockedRect.size);
+    m_recorder.recordDepth(m_depthD16, 640, 480, getTimeSeconds());
+    if (m_bFilterDepth)
+    {
+        m_depthFilter.filter(m_depthD16, m_depthD16);
+    }
+    m_registration.registerDepthToColor(m_depthD16, m_registeredD16);
     m_bDepthReceived = true;
 
     hr = imageFrame.pFrameTexture->UnlockRect(0);
@@ -343,14 +502,52 @@ HRESULT Viewer::ProcessColor()
     hr = imageFrame.pFrameTexture->LockRect(0, &LockedRect, NULL, 0);
     if ( FAILED(hr) ) { return hr; }
 
+    // Frames the sensor numbered but we never picked up
+    if (m_bColorFrameNumberValid && imageFrame.dwFrameNumber > m_lastColorFrameNumber + 1)
+    {
+        LATENCY_DROPPED(m_latency, imageFrame.dwFrameNumber - m_lastColorFrameNumber - 1);
+    }
+    m_lastColorFrameNumber = imageFrame.dwFrameNumber;
+    m_bColorFrameNumberValid = true;
+
+    // Copied straight into the display back buffer, which is the frame we track
+    m_colorRGBX = m_display.backBuffer();
     memcpy(m_colorRGBX, LockedRect.pBits, LockedRect.size);
+    m_recorder.recordColor(m_colorRGBX, 640, 480, LockedRect.Pitch, getTimeSeconds());
     m_bColorReceived = true;
 
     hr = imageFrame.pFrameTexture->UnlockRect(0);
     if ( FAILED(hr) ) { return hr; };
 
     hr = m_pNuiSensor->NuiImageStreamReleaseFrame(m_pColorStreamHandle, &imageFrame);
-    
+    LATENCY_MARK(m_latency, LatencyCopy);
+
+    // Track our own copy so the sensor buffer goes back right away
+    m_pTrackerCore->centerOne.x = m_pTrackerCore->centerOne.y = -1;
+    m_pTrackerCore->findTarget(m_colorRGBX, LockedRect.Pitch, LockedRect.size);
+    LATENCY_MARK(m_latency, LatencyTrack);
+
+    // Hand the frame and what was found in it to the window, which draws it
+    // whenever its rate allows; frames it never gets to are simply replaced
+    DisplayOverlay* pOverlay = m_display.backOverlay();
+    pOverlay->frame = imageFrame.dwFrameNumber;
+    pOverlay->timestamp = getTimeSeconds();
+    pOverlay->targetCount = 1;
+    DisplayTarget& target = pOverlay->targets[0];
+    const TargetDescriptor& shape = m_pTrackerCore->targetOne;
+    target.found = shape.found;
+    target.x = shape.x;
+    target.y = shape.y;
+    target.radius = shape.majorAxis;
+    target.hasBox = shape.found && m_pTrackerCore->computeDescriptors;
+    target.left = shape.left;
+    target.top = shape.top;
+    target.right = shape.right;
+    target.bottom = shape.bottom;
+    m_display.publish();
+    SetEvent(m_hDisplayFrameEvent);
+    LATENCY_MARK(m_latency, LatencyPublish);
+
     return hr;
 }
 
@@ -417,8 +614,31 @@ int Viewer::SendMessager()
 
 void Viewer::CheackDepth()
 {
-	if (m_depthD16[((480 / 2) * 640) + (640 / 2)] < 9000 &&
-		m_depthD16[((480 / 2) * 640) + (640 / 2)] > 6000)
+	// Probe where the target was seen, or straight ahead when it was not.
+	// The registered frame has holes where no depth pixel landed, so take
+	// the nearest reading close by.
+	int probeX = 640 / 2;
+	int probeY = 480 / 2;
+	if (m_pTrackerCore->targetOne.found)
+	{
+		probeX = static_cast<int>(m_pTrackerCore->targetOne.x + 0.5f);
+		probeY = static_cast<int>(m_pTrackerCore->targetOne.y + 0.5f);
+	}
+
+	USHORT depth = 0;
+	for (int y = max(probeY - 2, 0); y <= min(probeY + 2, 480 - 1); y++)
+	{
+		for (int x = max(probeX - 2, 0); x <= min(probeX + 2, 640 - 1); x++)
+		{
+			USHORT reading = m_registeredD16[y * 640 + x];
+			if (reading && (!depth || reading < depth))
+			{
+				depth = reading;
+			}
+		}
+	}
+
+	if (depth < 9000 && depth > 6000)
 	{
 		SendMessager();
 	}
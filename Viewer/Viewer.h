@@ -10,12 +10,23 @@
 #include "NuiApi.h"
 #include "ImageRenderer.h"
 #include "TrackerCore.h"
+#include "Registration.h"
+#include "WorkerPool.h"
+#include "GroundPlane.h"
+#include "DepthFilter.h"
+#include "AsyncRecorder.h"
+#include "LatencyProfiler.h"
+#include "DisplayMailbox.h"
+#include "Timing.h"
 
 class Viewer
 {
     static const int        cColorWidth  = 640;
     static const int        cColorHeight = 480;
 
+    // Most frames a second the window is redrawn, tracking runs at the sensor rate regardless
+    static const int        cDisplayRate = 15;
+
     static const int        cStatusMessageMaxLen = MAX_PATH*2;
 
 public:
@@ -56,6 +67,13 @@ public:
     /// <param name="nCmdShow"></param>
     int                     Run(HINSTANCE hInstance, int nCmdShow);
 
+    /// <summary>
+    /// Records raw color and depth frames to a session file in the background
+    /// </summary>
+    /// <param name="path">session file to create</param>
+    /// <returns>true if recording started</returns>
+    bool                    StartRecording(LPCWSTR path);
+
 private:
     HWND                    m_hWnd;
 
@@ -68,15 +86,52 @@ private:
 
 	// Local Tracker Core
 	TrackerCore*			m_pTrackerCore;
+
+	// Tracking runs on its own thread and leaves frames here for the window
+	HANDLE					m_hTrackingThread;
+	HANDLE					m_hStopTracking;
+	DisplayMailbox			m_display;
+	RateLimiter				m_displayLimiter;
+	HANDLE					m_hDisplayFrameEvent;
+
     HANDLE                  m_hNextDepthFrameEvent;
     HANDLE                  m_pDepthStreamHandle;
     HANDLE                  m_pColorStreamHandle;
     HANDLE                  m_hNextColorFrameEvent;
 
-	// for mapping depth to color
+	// for mapping depth to color, the color frame is the display back buffer
     USHORT*					m_depthD16;
     BYTE*					m_colorRGBX;
-    LONG*					m_colorCoordinates;
+	// depth resampled onto the color pixels, so it can be read where the target was found
+    USHORT*					m_registeredD16;
+	DepthRegistration		m_registration;
+
+	// Threads shared by the per-frame depth processing
+	WorkerPool				m_workers;
+	GroundPlaneEstimator	m_groundPlane;
+
+	// Optional hole filling and despeckling of m_depthD16
+	DepthFilter				m_depthFilter;
+	bool					m_bFilterDepth;
+
+	// Session recording, only running when a path was given on the command line
+	AsyncRecorder			m_recorder;
+
+	// Where the time goes from the sensor event to the telemetry send
+	enum LatencyStage
+	{
+		LatencyWait,
+		LatencyCopy,
+		LatencyTrack,
+		LatencyPublish,
+		LatencyDepth,
+		LatencySend,
+		LatencyStageCount
+	};
+	LatencyProfiler			m_latency;
+	double					m_lastLatencySnapshot;
+	DWORD					m_lastColorFrameNumber;
+	bool					m_bColorFrameNumberValid;
 
     // to prevent use until we have data for both streams
     bool					m_bDepthReceived;
@@ -87,6 +142,28 @@ private:
     /// </summary>
     void                    Update();
 
+    /// <summary>
+    /// Starts the thread that waits on the sensor and runs Update for every frame
+    /// </summary>
+    void                    StartTracking();
+
+    /// <summary>
+    /// Stops the tracking thread and waits for it to finish
+    /// </summary>
+    void                    StopTracking();
+
+    /// <summary>
+    /// Tracking thread entry point
+    /// </summary>
+    /// <param name="lpParam">the Viewer</param>
+    /// <returns>always 0</returns>
+    static DWORD WINAPI     TrackingThread(LPVOID lpParam);
+
+    /// <summary>
+    /// Draws the newest tracked frame if the display rate allows
+    /// </summary>
+    void                    DrawLatestFrame();
+
     /// <summary>
     /// Create the first connected Kinect found 
     /// </summary>